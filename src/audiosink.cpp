@@ -0,0 +1,58 @@
+#include "audiosink.h"
+
+namespace {
+	void put16(uint8_t* p, uint16_t value) {
+		p[0] = value & 0xFF;
+		p[1] = value >> 8;
+	}
+
+	void put32(uint8_t* p, uint32_t value) {
+		put16(p, value & 0xFFFF);
+		put16(p + 2, value >> 16);
+	}
+}
+
+WavSink::WavSink(const std::string& filename, int sampleRate) : _sampleRate(sampleRate), _dataBytes(0) {
+	_file = fopen(filename.c_str(), "wb");
+	if (_file != nullptr) {
+		writeHeader();
+	}
+}
+
+WavSink::~WavSink() {
+	if (_file == nullptr) {
+		return;
+	}
+	fseek(_file, 0, SEEK_SET);
+	writeHeader();
+	fclose(_file);
+}
+
+// canonical 44 byte header: RIFF chunk, fmt chunk for 16 bit mono PCM, data chunk
+void WavSink::writeHeader() {
+	uint8_t header[44] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' '};
+	put32(&header[4], 36 + _dataBytes);
+	put32(&header[16], 16);
+	put16(&header[20], 1);
+	put16(&header[22], 1);
+	put32(&header[24], _sampleRate);
+	put32(&header[28], _sampleRate * 2);
+	put16(&header[32], 2);
+	put16(&header[34], 16);
+	header[36] = 'd';
+	header[37] = 'a';
+	header[38] = 't';
+	header[39] = 'a';
+	put32(&header[40], _dataBytes);
+	fwrite(header, sizeof(header), 1, _file);
+}
+
+void WavSink::write(const int16_t* samples, size_t count) {
+	// WAV samples are little endian
+	for (size_t i = 0; i < count; ++i) {
+		uint8_t bytes[2];
+		put16(bytes, static_cast<uint16_t>(samples[i]));
+		fwrite(bytes, 2, 1, _file);
+	}
+	_dataBytes += count * 2;
+}
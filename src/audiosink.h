@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// the default sample rate
+inline const int SAMPLE_RATE = 44100;
+
+// Where the SID output goes: 16 bit signed mono samples, handed over in blocks from the audio thread.
+// The SID is resampled to the rate the sink asks for.
+class AudioSink {
+public:
+	virtual ~AudioSink() = default;
+	virtual int getSampleRate() const = 0;
+	virtual void write(const int16_t* samples, size_t count) = 0;
+};
+
+// Writes a WAV file. The header is completed with the data size when the sink is destroyed.
+class WavSink : public AudioSink {
+public:
+	WavSink(const std::string& filename, int sampleRate);
+	~WavSink() override;
+	bool isOpen() const;
+	int getSampleRate() const override;
+	void write(const int16_t* samples, size_t count) override;
+private:
+	void writeHeader();
+	FILE* _file;
+	int _sampleRate;
+	uint32_t _dataBytes;
+};
+
+inline bool WavSink::isOpen() const {
+	return _file != nullptr;
+}
+
+inline int WavSink::getSampleRate() const {
+	return _sampleRate;
+}
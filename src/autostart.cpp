@@ -0,0 +1,97 @@
+#include "autostart.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include "c64.h"
+#include "d64parse.h"
+
+namespace {
+	// the KERNAL reaches the prompt in about 2.5 seconds, give up after 10
+	const int BOOT_FRAMES = 500;
+	// at the speed of the KERNAL serial routines, a disk full of program takes a few minutes
+	const int LOAD_FRAMES = 30000;
+
+	bool hasExtension(const std::string& filename, const std::string& extension) {
+		if (filename.size() < extension.size()) {
+			return false;
+		}
+		return std::equal(extension.rbegin(), extension.rend(), filename.rbegin(),
+			[] (char a, char b) { return a == std::tolower(static_cast<unsigned char>(b)); });
+	}
+
+	bool readProgram(const std::string& filename, std::vector<uint8_t>& program) {
+		if (hasExtension(filename, ".d64")) {
+			// the parser holds the whole image
+			auto parser = std::make_unique<D64Parser>();
+			if (!parser->parse(filename)) {
+				return false;
+			}
+			const auto& entries = parser->getEntries();
+			for (size_t i = 0; i < entries.size(); ++i) {
+				if (entries[i].file_type == "PRG") {
+					program = parser->getData(i);
+					return true;
+				}
+			}
+			std::cerr << "No PRG file in " << filename << "\n";
+			return false;
+		}
+		std::ifstream is(filename, std::ios::binary);
+		if (!is) {
+			std::cerr << "Can't find file: " << filename << "\n";
+			return false;
+		}
+		program.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+		return true;
+	}
+}
+
+bool bootToPrompt(C64& computer) {
+	for (int frame = 0; !computer.waitingForKeyboard(); ++frame) {
+		if (frame == BOOT_FRAMES) {
+			std::cerr << "The machine didn't reach the BASIC prompt\n";
+			return false;
+		}
+		computer.runFrame();
+	}
+	return true;
+}
+
+bool autostart(C64& computer, const std::string& filename) {
+	std::vector<uint8_t> program;
+	if (!readProgram(filename, program)) {
+		return false;
+	}
+	if (!bootToPrompt(computer)) {
+		return false;
+	}
+	if (!computer.loadProgram(program)) {
+		std::cerr << "Not a program: " << filename << "\n";
+		return false;
+	}
+	computer.typeText("RUN\r");
+	return true;
+}
+
+bool loadFromDrive(C64& computer, const std::string& filename) {
+	if (!computer.insertDisk(filename) || !bootToPrompt(computer)) {
+		return false;
+	}
+	// the buffer holds 10 characters: LOAD abbreviated as L and shifted O
+	computer.typeText("L\xCF\"*\",8,1\r");
+	// the prompt goes away while the command runs and comes back when it is done
+	bool started = false;
+	for (int frame = 0; !started || !computer.waitingForKeyboard(); ++frame) {
+		if (frame == LOAD_FRAMES) {
+			std::cerr << "The drive didn't load the program from " << filename << "\n";
+			return false;
+		}
+		computer.runFrame();
+		started = started || !computer.waitingForKeyboard();
+	}
+	computer.typeText("RUN\r");
+	return true;
+}
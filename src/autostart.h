@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+class C64;
+
+// Lets the KERNAL boot until the BASIC prompt waits for a key, at once if it is there already. Returns
+// false, with a message on stderr, if it doesn't get there.
+bool bootToPrompt(C64& computer);
+
+// Starts a program without emulating the serial transfer from the 1541: lets the KERNAL boot to the
+// BASIC prompt, copies the program into memory as LOAD would and types RUN. The file is either a PRG
+// or a D64 image, of which the first PRG is started. Returns false, with a message on stderr, if the
+// file has no program or the machine doesn't reach the prompt.
+bool autostart(C64& computer, const std::string& filename);
+
+// Starts the first program of a D64 image the slow way: inserts the image in the emulated 1541, lets the
+// KERNAL boot and types LOAD"*",8,1, then RUN once the drive has delivered the program over the serial
+// bus. Needs the 1541 ROM; returns false, with a message on stderr, if the load doesn't complete.
+bool loadFromDrive(C64& computer, const std::string& filename);
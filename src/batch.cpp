@@ -0,0 +1,115 @@
+#include "batch.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include "c64.h"
+#include "autostart.h"
+#include "screenshot.h"
+
+namespace {
+	bool parseAddress(const std::string& text, uint16_t& address) {
+		char* end;
+		auto value = std::strtoul(text.c_str(), &end, 16);
+		if (text.empty() || *end != 0 || value > 0xFFFF) {
+			return false;
+		}
+		address = static_cast<uint16_t>(value);
+		return true;
+	}
+
+	bool parseJob(const std::string& text, BatchJob& job) {
+		std::istringstream is(text);
+		std::string cycles;
+		if (!(is >> job.program >> cycles)) {
+			return false;
+		}
+		char* end;
+		job.cycles = std::strtol(cycles.c_str(), &end, 10);
+		if (*end != 0 || job.cycles <= 0) {
+			return false;
+		}
+		std::string output;
+		while (is >> output) {
+			auto dash = output.find('-');
+			std::pair<uint16_t, uint16_t> range;
+			if (output.compare(0, 11, "screenshot=") == 0 && output.size() > 11) {
+				job.screenshot = output.substr(11);
+			} else if (dash != std::string::npos && parseAddress(output.substr(0, dash), range.first) &&
+				parseAddress(output.substr(dash + 1), range.second) && range.first <= range.second) {
+				job.ranges.push_back(range);
+			} else {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+bool readJobs(const std::string& filename, std::vector<BatchJob>& jobs) {
+	std::ifstream is(filename);
+	if (!is) {
+		std::cerr << "Can't find file: " << filename << "\n";
+		return false;
+	}
+	std::string text;
+	for (int line = 1; std::getline(is, text); ++line) {
+		auto start = text.find_first_not_of(" \t\r");
+		if (start == std::string::npos || text[start] == '#') {
+			continue;
+		}
+		BatchJob job;
+		job.line = line;
+		if (!parseJob(text, job)) {
+			std::cerr << "Not a job, line " << line << " of " << filename << ": " << text << "\n";
+			return false;
+		}
+		jobs.push_back(std::move(job));
+	}
+	return true;
+}
+
+void runJobs(const std::vector<BatchJob>& jobs, Mode mode, std::shared_ptr<const Roms> roms, Dispatch dispatch, WorkPool& pool,
+	const std::function<void(const BatchJob&, const BatchResult&)>& done) {
+	C64 booted(mode, std::move(roms));
+	if (!bootToPrompt(booted)) {
+		return;
+	}
+	// forking touches the original, and results are reported one at a time
+	std::mutex forkMutex;
+	std::mutex doneMutex;
+	auto m = static_cast<int>(mode);
+	long frame = NUMBER_OF_LINES[m] * CYCLES_PER_LINE[m];
+	pool.run(jobs.size(), [&] (size_t i) {
+		const auto& job = jobs[i];
+		std::unique_ptr<C64> computer;
+		{
+			std::lock_guard<std::mutex> lock(forkMutex);
+			computer = booted.fork();
+		}
+		computer->setDispatch(dispatch);
+		BatchResult result;
+		result.ok = autostart(*computer, job.program);
+		long start = computer->getClockCycle();
+		for (long cycles = 0; result.ok && cycles < job.cycles; cycles += frame) {
+			computer->runFrame();
+		}
+		result.cycles = computer->getClockCycle() - start;
+		for (const auto& range : job.ranges) {
+			std::vector<uint8_t> memory;
+			for (int address = range.first; address <= range.second; ++address) {
+				memory.push_back(computer->peek(static_cast<uint16_t>(address)));
+			}
+			result.memory.push_back(std::move(memory));
+		}
+		if (result.ok && !job.screenshot.empty() && !saveScreenshot(job.screenshot, *computer)) {
+			std::cerr << "Can't write file: " << job.screenshot << "\n";
+			result.ok = false;
+		}
+		// the machine goes before the report, so that a slow consumer doesn't hold its memory
+		computer.reset();
+		std::lock_guard<std::mutex> lock(doneMutex);
+		done(job, result);
+	});
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "settings.h"
+#include "workpool.h"
+
+struct Roms;
+enum class Dispatch;
+
+// A program to run headless and what to report once it has run.
+struct BatchJob {
+	int line;                   // in the job list
+	std::string program;        // PRG or D64, started as by autostart
+	long cycles;                // to run once the program has been started, rounded up to whole frames
+	std::vector<std::pair<uint16_t, uint16_t>> ranges;     // RAM to report, first and last address
+	std::string screenshot;     // PPM written at the end, none if empty
+};
+
+struct BatchResult {
+	bool ok;                    // the program started and the screenshot was written
+	long cycles;                // run since the program was started
+	std::vector<std::vector<uint8_t>> memory;      // the contents of each range
+};
+
+// Reads a job list: one job per line, as "program cycles [first-last ...] [screenshot=file.ppm]" with the
+// addresses in hex. Blank lines and lines starting with # are skipped. Returns false, with a message on
+// stderr, at the first line that isn't a job.
+bool readJobs(const std::string& filename, std::vector<BatchJob>& jobs);
+
+// Runs the jobs on the pool. The machine is booted to the BASIC prompt once, then every job runs on a
+// fork of it, so the jobs share the ROMs and the boot. done is called as each job finishes, on the
+// thread that ran it, one call at a time. The jobs run with the given dispatch, see C64::setDispatch.
+void runJobs(const std::vector<BatchJob>& jobs, Mode mode, std::shared_ptr<const Roms> roms, Dispatch dispatch, WorkPool& pool,
+	const std::function<void(const BatchJob&, const BatchResult&)>& done);
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include "batch.h"
+#include "c64.h"
+
+// Runs a list of programs on many headless machines at once, and reports what each left in memory.
+
+namespace {
+
+	void usage() {
+		std::cerr << "usage: c64-batch [--threads n] [--ntsc] [--roms directory] [--jit] jobs.txt\n";
+	}
+
+}
+
+int main(int argc, char* argv[]) {
+	unsigned threads = 0;
+	Mode mode = Mode::PAL;
+	std::string romDirectory = C64::DEFAULT_ROM_DIRECTORY;
+	std::string filename;
+	Dispatch dispatch = Dispatch::BLOCK;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg(argv[i]);
+		if (arg == "--threads" && i + 1 < argc) {
+			threads = static_cast<unsigned>(std::stoul(argv[++i]));
+		} else if (arg == "--ntsc") {
+			mode = Mode::NTSC;
+		} else if (arg == "--roms" && i + 1 < argc) {
+			romDirectory = argv[++i];
+		} else if (arg == "--jit") {
+			dispatch = Dispatch::JIT;
+		} else if (filename.empty() && arg.compare(0, 2, "--") != 0) {
+			filename = arg;
+		} else {
+			usage();
+			return 1;
+		}
+	}
+	if (filename.empty()) {
+		usage();
+		return 1;
+	}
+
+	std::vector<BatchJob> jobs;
+	if (!readJobs(filename, jobs)) {
+		return 1;
+	}
+	auto roms = C64::loadRoms(romDirectory);
+	if (!roms) {
+		return 1;
+	}
+	auto start = std::chrono::steady_clock::now();
+	WorkPool pool(threads);
+	size_t finished = 0, failed = 0;
+	// a line per job as it finishes: line of the job, program, ok or failed, cycles run, then each range
+	// as first-last=bytes in hex
+	runJobs(jobs, mode, roms, dispatch, pool, [&] (const BatchJob& job, const BatchResult& result) {
+		++finished;
+		failed += result.ok ? 0 : 1;
+		std::cout << std::dec << job.line << " " << job.program << " " << (result.ok ? "ok" : "failed") << " "
+			<< result.cycles;
+		for (size_t i = 0; i < job.ranges.size(); ++i) {
+			std::cout << " " << std::hex << std::uppercase << std::setfill('0') << std::setw(4) << job.ranges[i].first
+				<< "-" << std::setw(4) << job.ranges[i].second << "=";
+			for (uint8_t byte : result.memory[i]) {
+				std::cout << std::setw(2) << static_cast<int>(byte);
+			}
+		}
+		// flushed so that the results can be followed while the batch runs
+		std::cout << std::endl;
+	});
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	std::cerr << std::dec << finished << " jobs in " << elapsed.count() << " s on " << pool.getThreads() << " threads";
+	if (failed > 0) {
+		std::cerr << ", " << failed << " failed";
+	}
+	std::cerr << "\n";
+	return finished == jobs.size() && failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+#include "bcd.h"
+#include <memory>
+
+namespace {
+
+	uint16_t entry(int result, bool negative, bool overflow, bool zero, bool carry) {
+		int flags = (negative ? 0x80 : 0) | (overflow ? 0x40 : 0) | (zero ? 0x02 : 0) | (carry ? 0x01 : 0);
+		return static_cast<uint16_t>((flags << 8) | (result & 0xFF));
+	}
+
+	uint16_t decimalAdd(int a, int value, int carry) {
+		int low = (a & 0x0F) + (value & 0x0F) + carry;
+		if (low > 0x09) {
+			low += 0x06;
+		}
+		int high = (a >> 4) + (value >> 4) + (low > 0x0F ? 1 : 0);
+		// N and V see the high digit before it is adjusted
+		int unadjusted = high << 4;
+		bool overflow = (~(a ^ value) & (a ^ unadjusted) & 0x80) != 0;
+		if (high > 0x09) {
+			high += 0x06;
+		}
+		bool zero = ((a + value + carry) & 0xFF) == 0;
+		return entry((high << 4) | (low & 0x0F), (unadjusted & 0x80) != 0, overflow, zero, high > 0x0F);
+	}
+
+	uint16_t decimalSubtract(int a, int value, int carry) {
+		int borrow = 1 - carry;
+		int low = (a & 0x0F) - (value & 0x0F) - borrow;
+		int high = (a >> 4) - (value >> 4) - (low < 0 ? 1 : 0);
+		if (low < 0) {
+			low -= 0x06;
+		}
+		if (high < 0) {
+			high -= 0x06;
+		}
+		// the flags are those of the binary subtraction
+		int binary = a - value - borrow;
+		bool overflow = ((a ^ value) & (a ^ binary) & 0x80) != 0;
+		// the digits wrap around below zero
+		return entry(((high & 0x0F) << 4) | (low & 0x0F), (binary & 0x80) != 0, overflow, (binary & 0xFF) == 0, binary >= 0);
+	}
+
+	std::unique_ptr<DecimalTables> build() {
+		auto tables = std::make_unique<DecimalTables>();
+		for (int carry = 0; carry < 2; ++carry) {
+			for (int a = 0; a < 256; ++a) {
+				for (int value = 0; value < 256; ++value) {
+					int index = (carry << 16) | (a << 8) | value;
+					tables->adc[index] = decimalAdd(a, value, carry);
+					tables->sbc[index] = decimalSubtract(a, value, carry);
+				}
+			}
+		}
+		return tables;
+	}
+
+}
+
+const DecimalTables& decimalTables() {
+	static const std::unique_ptr<DecimalTables> tables = build();
+	return *tables;
+}
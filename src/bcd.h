@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+// ADC and SBC in decimal mode, looked up instead of worked out a nibble at a time. Entries are indexed by
+// carry << 16 | A << 8 | operand and hold the accumulator in the low byte and N, V, Z and C in the high
+// byte, at their places in the status register. They follow the NMOS 6502, invalid BCD digits included:
+// after ADC, Z is that of the binary sum and N and V are taken before the high digit is adjusted; after
+// SBC the flags are all those of the binary subtraction.
+struct DecimalTables {
+	static constexpr int SIZE = 2 * 256 * 256;
+	uint16_t adc[SIZE];
+	uint16_t sbc[SIZE];
+};
+
+// built on first use, then shared by every CPU on any thread
+const DecimalTables& decimalTables();
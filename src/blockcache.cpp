@@ -0,0 +1,57 @@
+#include "blockcache.h"
+#include <algorithm>
+#include <cstring>
+
+BlockCache::BlockCache() {
+	std::fill(std::begin(_generation), std::end(_generation), 0);
+	memset(_writes, 0, sizeof(_writes));
+}
+
+Block& BlockCache::insert(uint16_t address, const uint8_t* source) {
+	auto& page = _pages[address >> 8];
+	if (!page) {
+		page = std::make_unique<Page>();
+		std::fill(std::begin(page->index), std::end(page->index), -1);
+	}
+	int16_t& index = page->index[address & 0xFF];
+	if (index < 0) {
+		index = static_cast<int16_t>(page->blocks.size());
+		page->blocks.emplace_back();
+	}
+	Block& block = page->blocks[index];
+	block.source = source;
+	block.generation = _generation[address >> 8];
+	block.count = 0;
+	block.runs = 0;
+	block.native = nullptr;
+	return block;
+}
+
+void BlockCache::invalidate(int page) {
+	++_generation[page];
+	if (_writes[page] < VOLATILE_WRITES) {
+		++_writes[page];
+	}
+}
+
+void BlockCache::endFrame() {
+	memset(_writes, 0, sizeof(_writes));
+}
+
+void BlockCache::clear() {
+	for (auto& page : _pages) {
+		page.reset();
+	}
+	memset(_writes, 0, sizeof(_writes));
+}
+
+void BlockCache::dropNative() {
+	for (auto& page : _pages) {
+		if (page) {
+			for (auto& block : page->blocks) {
+				block.runs = 0;
+				block.native = nullptr;
+			}
+		}
+	}
+}
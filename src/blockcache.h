@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "jit.h"
+
+// An instruction as it was found in memory: running it again doesn't fetch and decode it again.
+struct DecodedInstruction {
+	uint16_t operand;           // the bytes after the opcode
+	uint8_t opcode;
+	uint8_t cycles;             // without the page crossing and branch penalties, which the handlers add
+};
+
+// Straight-line code within one page: the instructions from the start address up to the first one
+// that may not continue with the next, or to the end of the page.
+struct Block {
+	static constexpr int CAPACITY = 32;
+	const uint8_t* source;      // the memory the page showed when decoded, RAM or a ROM
+	uint32_t generation;        // of the page when decoded
+	int count;                  // 0 if the first instruction runs into the next page
+	uint32_t runs;              // counted up to Jit::HOT_RUNS
+	Jit::Code native;           // the block compiled by the Jit, if it has been
+	DecodedInstruction instructions[CAPACITY];
+};
+
+// Decoded blocks by start address. Writing to a page makes all of its blocks stale at once, by moving
+// the page to the next generation; a stale block is decoded again in place the next time it runs.
+// Pages rewritten many times in a frame, as self-modifying code does, are better left to the interpreter.
+class BlockCache {
+public:
+	// a page invalidated this many times in a frame is not decoded for the rest of it
+	static constexpr int VOLATILE_WRITES = 16;
+	BlockCache();
+	// the block starting at address, nullptr unless it was decoded from this source and the page
+	// hasn't been written to since
+	Block* find(uint16_t address, const uint8_t* source);
+	// the block to decode the code at address into
+	Block& insert(uint16_t address, const uint8_t* source);
+	// the page has been written to
+	void invalidate(int page);
+	bool isVolatile(int page) const;
+	void endFrame();
+	// forget every block, for when memory is replaced as a whole
+	void clear();
+	// forget the compiled code of every block
+	void dropNative();
+private:
+	struct Page {
+		int16_t index[256];         // of the block starting at each address in blocks, -1 for none
+		std::vector<Block> blocks;
+	};
+	// allocated when the first block of the page is decoded
+	std::unique_ptr<Page> _pages[256];
+	uint32_t _generation[256];
+	uint8_t _writes[256];       // invalidations in this frame
+};
+
+inline Block* BlockCache::find(uint16_t address, const uint8_t* source) {
+	Page* page = _pages[address >> 8].get();
+	if (page == nullptr) {
+		return nullptr;
+	}
+	int index = page->index[address & 0xFF];
+	if (index < 0) {
+		return nullptr;
+	}
+	Block* block = &page->blocks[index];
+	if (block->source != source || block->generation != _generation[address >> 8]) {
+		return nullptr;
+	}
+	return block;
+}
+
+inline bool BlockCache::isVolatile(int page) const {
+	return _writes[page] >= VOLATILE_WRITES;
+}
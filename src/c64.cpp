@@ -1,17 +1,16 @@
 #include "c64.h"
+#include "d64parse.h"
+#include <algorithm>
 #include <iostream>
 #include <iomanip>      // std::setw
 #include <fstream>
+#include <iterator>
+#include <atomic>
 #include <sstream>
 #include <cstring>
+#include <climits>
 #include <chrono>
 #include <thread>
-// Include GLEW
-#include <GL/glew.h>
-// Include GLFW
-#include <GLFW/glfw3.h>
-#include "shader.h"
-#include "shaders.h"
 
 
 using namespace std;
@@ -19,58 +18,76 @@ using namespace std::chrono;
 
 
 
-GLFWwindow* window;
+const char* const C64::DEFAULT_ROM_DIRECTORY = C64_ROM_DIRECTORY;
 
-
-void WindowResizeCallback(GLFWwindow* win, int width, int height) {
-	// notify cameras
-	if (height == 0) height = 1;
-	settings::window_width = width;
-	settings::window_height = height;
-	//glViewport(0, 0, width, height);
+C64::C64(Mode mode) : C64(mode, loadRoms(DEFAULT_ROM_DIRECTORY)) {
 }
 
-C64::C64(Mode mode) : _mode(mode), _clockCycle(0) {
-	settings::mode = mode;
-	if (mode == Mode::PAL) {
-		settings::width = settings::PAL_SCREEN_WIDTH;
-		settings::height = settings::PAL_SCREEN_HEIGHT;
-		settings::visible_width = settings::PAL_VISIBLE_WIDTH;
-		settings::visible_height = settings::PAL_VISIBLE_HEIGHT;
-	} else {
-		settings::width = settings::NTSC_SCREEN_WIDTH;
-		settings::height = settings::NTSC_SCREEN_HEIGHT;
+std::shared_ptr<const Roms> C64::loadRoms(const std::string& directory) {
+	auto roms = std::make_shared<Roms>();
+	roms->directory = directory;
+	if (!readFile(directory + "/kernal", roms->kernal, sizeof(roms->kernal)) ||
+		!readFile(directory + "/basic", roms->basic, sizeof(roms->basic)) ||
+		!readFile(directory + "/chargen", roms->charRom, sizeof(roms->charRom))) {
+		return nullptr;
 	}
+	// the drive ROM is only needed once a disk is inserted
+	std::ifstream is(directory + "/1541", std::ios::binary);
+	roms->drive.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+	roms->hashes[0] = snapshotHash(roms->kernal, sizeof(roms->kernal));
+	roms->hashes[1] = snapshotHash(roms->basic, sizeof(roms->basic));
+	roms->hashes[2] = snapshotHash(roms->charRom, sizeof(roms->charRom));
+	return roms;
+}
 
-	initializeGL();
-
-    _kernal = new uint8_t[8192];
-    _basic = new uint8_t[8192];
-    _charRom = new uint8_t[4096];
-    _ram = new uint8_t[65536];
-
-    initOpcodes();
-    readFile ("/home/fabrizio/c64/rom/kernal", &_kernal[0]);
-    readFile ("/home/fabrizio/c64/rom/basic", &_basic[0]);
-    readFile ("/home/fabrizio/c64/rom/chargen", &_charRom[0]);
-    memset(_ram, 0x00, 65536);
+C64::C64(Mode mode, std::shared_ptr<const Roms> roms) : _frameEnd(0), _sidBus(0), _iecLines(0), _frameDone(false),
+	_irqSources(0), _nmiLine(false), _nmiPending(false), _roms(std::move(roms)), _dispatch(Dispatch::BLOCK),
+	_leaveBlock(false), _mode(mode) {
+	if (!_roms) {
+		// the ROMs couldn't be read: the machine runs, into empty sockets
+		_roms = std::make_shared<Roms>();
+	}
+	_vic = std::make_unique<VICII>(mode);
+
+	_kernal = _roms->kernal;
+	_basic = _roms->basic;
+	_charRom = _roms->charRom;
+	for (int page = 0; page < 256; ++page) {
+		_ram[page] = std::make_shared<RamPage>();
+		_ramPage[page] = _ram[page]->bytes;
+		_shared[page] = false;
+		_code[page] = false;
+	}
+	_io = std::make_unique<uint8_t[]>(4096);
+	// color RAM sits at $D800 in the I/O area
+	_vic->setMemory(_ramPage, _charRom, &_io[0x800]);
+	_vic->setScheduler(&_scheduler);
+	// the time of day clocks count power line cycles
+	auto m = static_cast<int>(mode);
+	long powerLineCycle = static_cast<long>(CLOCK_FREQUENCY[m] / (mode == Mode::PAL ? 50 : 60));
+	_cia1 = std::make_unique<CIA>(&_scheduler, Event::CIA1_TIMER_A, Event::CIA1_TIMER_B, Event::CIA1_TOD, powerLineCycle);
+	_cia2 = std::make_unique<CIA>(&_scheduler, Event::CIA2_TIMER_A, Event::CIA2_TIMER_B, Event::CIA2_TOD, powerLineCycle);
+	_sid = std::make_unique<SidThread>(SidModel::MOS6581, CLOCK_FREQUENCY[m], SAMPLE_RATE);
 
     // init reg
+    _a = _x = _y = 0;
     _sp = 0xFF;
+    setStatus(0x24);
+    _stack = _ramPage[0x01];
 	// initialize RAM
 	//
-	_ram[0x0000] = 0x2F;				// processor port data direction register
-    _ram[0x0001] = 0x37;				// processor port
+	writableRam(0x0000) = 0x2F;				// processor port data direction register
+    writableRam(0x0001) = 0x37;				// processor port
     writeVec(0x0003, 0xB1AA);		// execution address of routine converting floating point to integer.
     writeVec(0x0005, 0xB391);		// execution address of routine converting integer to floating point.
-	_ram[0x0016] = 0x19;				// Pointer to next expression in string stack
+	writableRam(0x0016) = 0x19;				// Pointer to next expression in string stack
 	writeVec(0x002B, 0x0801);		// Pointer to beginning of BASIC area.
 	writeVec(0x0037, 0xA000);		// Pointer to end of BASIC area.
-	_ram[0x009A] = 0x03;						// Current output device number. (default = screen)
+	writableRam(0x009A) = 0x03;						// Current output device number. (default = screen)
 	writeVec(0x00B2, 0x033C);					// Pointer to datasette buffer.
 	writeVec(0x0281, 0x0800);					// Pointer to beginning of BASIC area after memory test.
 	writeVec(0x0283, 0xA000);					// Pointer to end of BASIC area after memory test.
-	_ram[0x0288] = 0x04;									// High byte of pointer to screen memory for screen input/output.
+	writableRam(0x0288) = 0x04;									// High byte of pointer to screen memory for screen input/output.
 	writeVec(0x028F, 0xEB48);					// Execution address of routine that, based on the status of
 															// shift keys, sets the pointer at memory address $00F5-$00F6
 															// to the appropriate conversion table for converting keyboard matrix codes to PETSCII codes.
@@ -82,379 +99,448 @@ C64::C64(Mode mode) : _mode(mode), _clockCycle(0) {
 	writeVec(0xFFFE, 0xFF48);					// Execution address of interrupt service routine.
 
 
-	// create the shader
-	_mainShader = std::make_unique<MainShader>(vshader, fshader, _mode);
-	_mainShader->init();
-
-	_blitShader = std::make_unique<BlitShader>(bvshader, bfshader);
-	_blitShader->init();
+	// chips in the I/O area, every other page of it is plain memory
+	for (auto& handler : _ioHandler) {
+		handler = {nullptr, nullptr};
+	}
+	for (int page = 0xD0; page < 0xD4; ++page) {
+		_ioHandler[page] = {&C64::readVIC, &C64::writeVIC};
+	}
+	for (int page = 0xD4; page < 0xD8; ++page) {
+		_ioHandler[page] = {&C64::readSID, &C64::writeSID};
+	}
+	_ioHandler[0xDC] = {&C64::readCIA1, &C64::writeCIA1};
+	_ioHandler[0xDD] = {&C64::readCIA2, &C64::writeCIA2};
+	// I/O 1 and I/O 2 belong to the expansion port, nothing is plugged in
+	_ioHandler[0xDE] = {&C64::readOpenBus, &C64::writeNothing};
+	_ioHandler[0xDF] = {&C64::readOpenBus, &C64::writeNothing};
+
+	// reset
+	updateMemoryMap();
+	_pc = readVec(0xFFFC);
+}
 
+const std::vector<OpcodeInfo> C64::_opcodes = C64::initOpcodes();
 
+const OpcodeInfo& C64::getOpcodeInfo(uint8_t opcode) {
+	return _opcodes[opcode];
 }
 
-std::string C64::disassemble(const OpcodeInfo& opcode, uint16_t address) {
+std::string C64::disassemble(const uint8_t* bytes, uint16_t address) {
+	const auto& opcode = _opcodes[bytes[0]];
+	if (opcode.text.empty()) {
+		return "???";
+	}
+	uint16_t vec = bytes[1] | (bytes[2] << 8);
 	std::stringstream stream;
-	stream << opcode.text << " ";
+	stream << opcode.text << " " << std::hex << std::setfill('0');
 	switch (opcode.addressMode) {
 		case AddressMode::IMPLIED:
 			break;
+		case AddressMode::ACCUMULATOR:
+			stream << "A";
+			break;
 		case AddressMode::IMMEDIATE:
-			stream << "#$" << std::hex << std::setw(2) <<std::setfill('0')<< (int) readByte(address+1);
+			stream << "#$" << std::setw(2) << (int) bytes[1];
+			break;
+		case AddressMode::ABSOLUTE:
+			stream << "$" << std::setw(4) << (int) vec;
 			break;
 		case AddressMode::ABSOLUTE_X:
-			stream << "$" << std::hex << std::setw(4) <<std::setfill('0')<< (int) readVec(address+1) << ",X";
+			stream << "$" << std::setw(4) << (int) vec << ",X";
+			break;
+		case AddressMode::ABSOLUTE_Y:
+			stream << "$" << std::setw(4) << (int) vec << ",Y";
+			break;
+		case AddressMode::ZEROPAGE:
+			stream << "$" << std::setw(2) << (int) bytes[1];
+			break;
+		case AddressMode::ZEROPAGE_INDEXED:
+			stream << "$" << std::setw(2) << (int) bytes[1] << ",X";
+			break;
+		case AddressMode::ZEROPAGE_Y:
+			stream << "$" << std::setw(2) << (int) bytes[1] << ",Y";
+			break;
+		case AddressMode::INDIRECT:
+			stream << "($" << std::setw(4) << (int) vec << ")";
+			break;
+		case AddressMode::RELATIVE:
+			stream << "$" << std::setw(4) << (int) (uint16_t) (address + 2 + (int8_t) bytes[1]);
+			break;
+		case AddressMode::INDEXED_INDIRECT:
+			stream << "($" << std::setw(2) << (int) bytes[1] << ",X)";
+			break;
+		case AddressMode::INDIRECT_INDEXED:
+			stream << "($" << std::setw(2) << (int) bytes[1] << "),Y";
 			break;
-
 	}
 	return stream.str();
 }
 
-void C64::run() {
-	bool shutdown{false};
-	// main loop
-	int row = 0;
-	int col = 0;
-
-	_pc = readVec(0xFFFC);
-
-	while (!shutdown) {
-
-
-
-
-		// VIC II
-		for (int i = col; i < col+8; ++i) {
-			_mainShader->setPixel(row, col, 0);
+template<bool tracing>
+int C64::step() {
+	// read instruction
+	auto opcode = readByte(_pc);
+	const auto& op = _opcodes[opcode];
+	if constexpr (tracing) {
+		TraceRecord record{};
+		record.cycle = _clockCycle;
+		record.pc = _pc;
+		for (int i = 0; i < op.bytes && i < 3; ++i) {
+			record.bytes[i] = readByte(_pc + i);
 		}
-
-		// 6510
-
-		// read instruction
-		auto opcode = readByte(_pc);
-		const auto& op = _opcodes[opcode];
-		if (op.methodPtrOne == NULL) {
-			std::cout << "opcode $" << std::hex << (int)opcode << " not supported!\n";
-			exit(1);
-		}
-		//std::cout
-
-		// debug code
-		std::cout << std::hex << (int) _pc << " ";
-		for (size_t i = 0; i < 4; ++i) {
-			if (i < op.bytes) {
-				std::cout << std::hex << std::setfill('0') << std::setw(2) << (int) readByte(_pc+i) << " ";
-			} else {
-				std::cout << "   ";
-			}
-
-
-		}
-		std::cout << disassemble(op, _pc) << std::endl;
-		(*this.*(op.methodPtrOne))();
-		// increment pc
-		//_pc += op.bytes;
-
-
-
-
-
-		// draw
-		_blitShader->start();
-
-		_mainShader->draw();
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glDisable(GL_DEPTH_TEST); // enable depth testing (is disabled for rendering screen-space quad)
-		glClear(GL_COLOR_BUFFER_BIT);
-
-
-		glViewport(0, 0, settings::window_width, settings::window_height);
-		_blitShader->draw();
-
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-
-		shutdown = (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS || glfwWindowShouldClose(window));
-		_clockCycle++;
+		record.a = _a;
+		record.x = _x;
+		record.y = _y;
+		record.sp = _sp;
+		record.status = getStatus();
+		_trace->push(record);
 	}
+	switch (opcode) {
+#define OPCODE(code, text, mode, bytes, cycles, ...) case code: fetchOperand(bytes); __VA_ARGS__(); break;
+#include "opcodes.inl"
+#undef OPCODE
+	}
+	return op.cycles;
 }
 
-void C64::initOpcodes() {
-	_opcodes.resize(256);
-
-	_opcodes[0xA2] = {"ldx", AddressMode::IMMEDIATE, 2, 2, &C64::ldx<2, &C64::getOperandImm>};
-	_opcodes[0x78] = {"sei", AddressMode::IMPLIED, 1, 2, &C64::sei};
-	_opcodes[0x9A] = {"txs", AddressMode::IMPLIED, 1, 2, &C64::txs};
-	_opcodes[0xD8] = {"cld", AddressMode::IMPLIED, 1, 2, &C64::cld};
-    _opcodes[0x20] = {"jsr", AddressMode::ABSOLUTE, 3, 6, &C64::jsr};
-	_opcodes[0xBD] = {"lda", AddressMode::ABSOLUTE_X, 3, 4, &C64::lda<3, &C64::getOperandAbx>};
-	_opcodes[0xDD] = {"cmp", AddressMode::ABSOLUTE_X, 3, 4, &C64::cmp<3, &C64::getOperandAbx>};
-	//    _opcodes[0x00] = {"brk", AddressMode::IMPLIED, 1, 7, &C64::brk};
-	//_opcodes[0x01] = {"ora", AddressMode::INDEXED_INDIRECT, 2, 6, &C64::ora<2, &C64::getOperandInx>};
-//    _opcodes[0x05] = {"ora", AddressMode::ZEROPAGE, 2, 3, &C64::ora<2, &C64::getOperandZP>};
-//    _opcodes[0x06] = {"asl", AddressMode::ZEROPAGE, 2, 5, &C64::asl<2, &C64::getRefZP>};
-//    _opcodes[0x08] = {"php", AddressMode::IMPLIED, 1, 3, &C64::php};
-//    _opcodes[0x09] = {"ora", AddressMode::IMMEDIATE, 2, 2, &C64::ora<2, &C64::getOperandImm>};
-//    _opcodes[0x0A] = {"asl", AddressMode::ACCUMULATOR, 1, 2, &C64::asl<2, &C64::getRefAcc>};
-//    _opcodes[0x0D] = {"ora", AddressMode::ABSOLUTE, 3, 4, &C64::ora<3, &C64::getOperandAbs>};
-//    _opcodes[0x0E] = {"asl", AddressMode::ABSOLUTE, 3, 6, &C64::asl<3, &C64::getRefAbs>};
+int C64::stepTable() {
+	const auto& op = _opcodes[readByte(_pc)];
+	fetchOperand(op.bytes);
+	(*this.*(op.methodPtrOne))();
+	return op.cycles;
 }
 
-
-void C64::initializeGL() {
-	if( !glfwInit() )
-	{
-		fprintf( stderr, "Failed to initialize GLFW\n" );
-		getchar();
-		exit(1);
+void C64::execute(uint8_t opcode) {
+	switch (opcode) {
+#define OPCODE(code, text, mode, bytes, cycles, ...) case code: __VA_ARGS__(); break;
+#include "opcodes.inl"
+#undef OPCODE
 	}
+}
 
-
-	glfwWindowHint(GLFW_SAMPLES, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	// Open a window and create its OpenGL context
-	window = glfwCreateWindow(settings::visible_width, settings::visible_height, "EM", NULL, NULL);
-
-	if( window == NULL ){
-		fprintf( stderr, "Failed to open GLFW window. If you have an Intel GPU, they are not 3.3 compatible. Try the 2.1 version of the tutorials.\n" );
-		getchar();
-		glfwTerminate();
-		exit(1);
+long C64::runBlock(long limit, bool jit) {
+	Block* block = _blocks.find(_pc, _readPage[_pc >> 8]);
+	if (block == nullptr) {
+		block = decodeBlock(_pc);
 	}
-	glfwMakeContextCurrent(window);
-	// note: we are setting a callback for the frame buffer resize event,
-	// so the dimensions we will get will be in pixels and NOT screen coordinates!
-	glfwSetFramebufferSizeCallback(window, WindowResizeCallback);
-
-	// Initialize GLEW
-	if (glewInit() != GLEW_OK) {
-		fprintf(stderr, "Failed to initialize GLEW\n");
-		getchar();
-		glfwTerminate();
-		exit(1);
+	if (block == nullptr || block->count == 0) {
+		_clockCycle += step<false>();
+		return 1;
 	}
-
-	// Ensure we can capture the escape key being pressed below
-	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
-	WindowResizeCallback(window, settings::visible_width, settings::visible_height);
-}
-
-void C64::readFile(const std::string &filename, uint8_t *ptr) {
-    ifstream is;
-    is.open (filename.c_str(), ios::binary);
-    is.seekg (0, ios::end);
-    auto length = is.tellg();
-    is.seekg (0, ios::beg);
-    is.read ((char*)ptr, length);
-    is.close();
-}
-
-C64::~C64() {
-    delete[] _kernal;
-    delete[] _basic;
-    delete[] _charRom;
-    delete[] _ram;
-
-}
-
-void C64::setCarryFlag(const uint16_t & value) {
-	if ((value & 0xFF00) == 0) {
-		// no carry
-		_status &= 0xFE;
-	} else {
-		_status |= 0x01;
+	_leaveBlock = false;
+	long count = std::min<long>(block->count, limit);
+	long i = 0;
+	if (jit && block->native != nullptr && count == block->count) {
+		// the compiled code stops where the interpreter would, or before what it doesn't handle
+		i = block->native(this, _scheduler.next());
+		if (i == count || _leaveBlock || _clockCycle >= _scheduler.next()) {
+			return i;
+		}
+	} else if (jit && ++block->runs == Jit::HOT_RUNS) {
+		compileBlock(*block);
 	}
+	while (i < count) {
+		const auto& instruction = block->instructions[i++];
+		_operand = instruction.operand;
+		execute(instruction.opcode);
+		_clockCycle += instruction.cycles;
+		if (_leaveBlock || _clockCycle >= _scheduler.next()) {
+			return i;
+		}
+	}
+	return count;
 }
 
-void C64::setNegFlag(const uint8_t& value) {
-    if (value & 0x80) {
-        _status |= 0x80;
-    } else {
-        _status &= 0x7F;
-    }
-}
-
-void C64::setZeroFlag(const uint8_t & value) {
-    if (value == 0u) {
-        _status |= 0x02;
-    } else {
-        _status &= 0xFD;
-    }
-}
-
-uint8_t C64::getBit(uint8_t value, uint8_t bit) {
-    return ((value & (1 << bit)) == 0 ? 0 : 1);
+Block* C64::decodeBlock(uint16_t address) {
+	int page = address >> 8;
+	const uint8_t* source = _readPage[page];
+	bool ram = source == _ramPage[page];
+	// the zero page and the stack are written all the time, the stack bypassing the page tables; code
+	// in I/O and color RAM is rare
+	if (page < 0x02 || _blocks.isVolatile(page) || !(ram || isRom(source))) {
+		return nullptr;
+	}
+	Block& block = _blocks.insert(address, source);
+	for (int offset = address & 0xFF; block.count < Block::CAPACITY; ) {
+		uint8_t opcode = source[offset];
+		const auto& op = _opcodes[opcode];
+		// an instruction reaching into the next page is left out, the page there may be mapped differently
+		if (offset + op.bytes > 256) {
+			break;
+		}
+		uint16_t operand = 0;
+		if (op.bytes > 1) {
+			operand = source[offset + 1];
+		}
+		if (op.bytes > 2) {
+			operand |= source[offset + 2] << 8;
+		}
+		block.instructions[block.count++] = {operand, opcode, op.cycles};
+		offset += op.bytes;
+		if (op.endsBlock || offset == 256) {
+			break;
+		}
+	}
+	if (ram && !_code[page]) {
+		_code[page] = true;
+		_writePage[page] = nullptr;
+	}
+	return &block;
 }
 
-void C64::setBit(uint8_t &ref, uint8_t value, uint8_t bit) {
-    if (value == 0) {
-        ref &= ~(1 << bit);
-    } else {
-        // set bit
-        ref |= 1 << bit;
-    }
+void C64::compileBlock(Block& block) {
+	if (!_jit) {
+		if (!Jit::isAvailable()) {
+			return;
+		}
+		auto offset = [this] (const void* member) {
+			return static_cast<int32_t>(static_cast<const char*>(member) - reinterpret_cast<const char*>(this));
+		};
+		Jit::Layout layout;
+		layout.a = offset(&_a);
+		layout.x = offset(&_x);
+		layout.y = offset(&_y);
+		layout.sp = offset(&_sp);
+		layout.status = offset(&_status);
+		layout.negative = offset(&_negative);
+		layout.zero = offset(&_zero);
+		layout.carry = offset(&_carry);
+		layout.overflow = offset(&_overflow);
+		layout.pc = offset(&_pc);
+		layout.clockCycle = offset(&_clockCycle);
+		layout.stack = offset(&_stack);
+		layout.readPage = offset(_readPage);
+		layout.writePage = offset(_writePage);
+		layout.read = &C64::jitRead;
+		layout.write = &C64::jitWrite;
+		_jit = std::make_unique<Jit>(layout);
+	}
+	if (!_jit->hasRoom()) {
+		// start over: the blocks still hot are compiled again
+		_blocks.dropNative();
+		_jit->clear();
+	}
+	block.native = _jit->compile(block, _pc);
 }
 
-
-
-uint8_t C64::getOperandAbx() {
-    return readByte(readVec(_pc + 1) + _x);
-}
-uint8_t C64::getOperandAby() {
-    return readByte(readVec(_pc+1) + _y);
+uint8_t C64::jitRead(void* machine, uint16_t address) {
+	return static_cast<C64*>(machine)->readIO(address);
 }
 
-uint8_t C64::getOperandZP() {
-    return readByte(readByte(_pc+1));
+void C64::jitWrite(void* machine, uint16_t address, uint8_t value) {
+	static_cast<C64*>(machine)->writeIO(address, value);
 }
 
-uint8_t C64::getOperandZPx() {
-    return readByte(readByte(_pc+1) + _x);
+bool C64::isRom(const uint8_t* page) const {
+	return (page >= _kernal && page < _kernal + 8192) || (page >= _basic && page < _basic + 8192) ||
+		(page >= _charRom && page < _charRom + 4096);
 }
 
-void C64::push(uint8_t byte) {
-    _ram[0x0100 + _sp] = byte;
-    _sp--;
+template<bool tracing>
+void C64::runUntil(long cycle) {
+	_scheduler.schedule(cycle, Event::FRAME_END);
+	_frameDone = false;
+	while (!_frameDone) {
+		// the only check made per instruction: whether an event is due
+		while (_clockCycle < _scheduler.next()) {
+			if constexpr (tracing) {
+				_clockCycle += step<true>();
+			} else if (_dispatch == Dispatch::BLOCK || _dispatch == Dispatch::JIT) {
+				runBlock(LONG_MAX, _dispatch == Dispatch::JIT);
+			} else if (_dispatch == Dispatch::TABLE) {
+				_clockCycle += stepTable();
+			} else {
+				_clockCycle += step<false>();
+			}
+		}
+		dispatchEvents();
+	}
 }
 
-void C64::pushVec(uint16_t value) {
-    auto hiByte = static_cast<uint8_t>((value & 0xFF00) >> 8);
-    auto loByte = static_cast<uint8_t>(value & 0x00FF);
-    push(hiByte);
-    push(loByte);
+void C64::dispatchEvents() {
+	Event event;
+	while (_scheduler.pop(_clockCycle, event)) {
+		switch (event) {
+			case Event::FRAME_END:
+				_frameDone = true;
+				break;
+			case Event::INTERRUPT:
+				// an NMI wins over an IRQ, and sets I so the IRQ waits for its RTI
+				if (_nmiPending) {
+					_nmiPending = false;
+					interrupt(0xFFFA);
+				} else if (_irqSources != 0 && (_status & 0x04) == 0) {
+					interrupt(0xFFFE);
+				}
+				break;
+			case Event::RASTER_IRQ:
+				syncChips();
+				_vic->rasterIrq();
+				setIrq(IRQ_VIC, _vic->irq());
+				break;
+			case Event::BADLINE:
+				syncChips();
+				_clockCycle += _vic->badline();
+				break;
+			case Event::CIA1_TIMER_A:
+				_cia1->underflow(CIA::TIMER_A);
+				setIrq(IRQ_CIA1, _cia1->irq());
+				break;
+			case Event::CIA1_TIMER_B:
+				_cia1->underflow(CIA::TIMER_B);
+				setIrq(IRQ_CIA1, _cia1->irq());
+				break;
+			case Event::CIA2_TIMER_A:
+				_cia2->underflow(CIA::TIMER_A);
+				setNmi(_cia2->irq());
+				break;
+			case Event::CIA2_TIMER_B:
+				_cia2->underflow(CIA::TIMER_B);
+				setNmi(_cia2->irq());
+				break;
+			case Event::CIA1_TOD:
+				_cia1->todTick();
+				setIrq(IRQ_CIA1, _cia1->irq());
+				break;
+			case Event::CIA2_TOD:
+				_cia2->todTick();
+				setNmi(_cia2->irq());
+				break;
+			case Event::DRIVE_SYNC:
+				_drive->sync(_clockCycle);
+				_scheduler.schedule(_clockCycle + DriveThread::SYNC_CYCLES, Event::DRIVE_SYNC);
+				break;
+			// the drive's own events, on its scheduler
+			case Event::VIA1_TIMER_1:
+			case Event::VIA1_TIMER_2:
+			case Event::VIA2_TIMER_1:
+			case Event::VIA2_TIMER_2:
+			case Event::DISK_BYTE:
+			case Event::COUNT:
+				break;
+		}
+	}
 }
 
-
-uint8_t C64::pop() {
-    _sp++;
-    auto byte = _ram[_sp];
-    return byte;
+void C64::setIrq(IrqSource source, bool active) {
+	if (active) {
+		_irqSources |= source;
+		pollInterrupt(0);
+	} else {
+		_irqSources &= ~source;
+	}
 }
 
-uint16_t C64::popVec() {
-    uint16_t loByte = pop();
-    uint16_t hiByte = pop();
-    return (hiByte << 8) | loByte;
-
+void C64::setNmi(bool active) {
+	if (active && !_nmiLine) {
+		_nmiPending = true;
+		_scheduler.schedule(_clockCycle, Event::INTERRUPT);
+	}
+	_nmiLine = active;
 }
 
-void C64::brk() {
-    // sets the break and interrupt disable flag
-    _status |= 0x14;
-    _pc += 2;
-    pushVec(_pc);
-    push(_status);
-    // raise interrupt event
-    _pc = readVec(0xFF48);
+void C64::pollInterrupt(int delay) {
+	if (_irqSources != 0 && (_status & 0x04) == 0) {
+		_scheduler.schedule(_clockCycle + delay, Event::INTERRUPT);
+	}
 }
 
-void C64::php() {
-    push(_status);
-    _pc += 1;
+void C64::interrupt(uint16_t vector) {
+	pushVec(_pc);
+	push((getStatus() & 0xEF) | 0x20);
+	_status |= 0x04;
+	_pc = readVec(vector);
+	_clockCycle += 7;
 }
 
-void C64::pha() {
-    push(_a);
-    _pc += 1;
+void C64::runFrame() {
+	// a frame is NUMBER_OF_LINES raster lines of CYCLES_PER_LINE cycles each. The target is
+	// kept absolute so that the cycles an instruction overshoots by are paid back next frame.
+	auto m = static_cast<int>(_mode);
+	_frameEnd += NUMBER_OF_LINES[m] * CYCLES_PER_LINE[m];
+	// the trace check is made once per frame: the untraced instantiation has no tracing code at all
+	if (_trace) {
+		runUntil<true>(_frameEnd);
+	} else {
+		runUntil<false>(_frameEnd);
+	}
+	syncChips();
+	_sid->sync(_clockCycle);
+	_blocks.endFrame();
 }
 
-void C64::clc() {
-    _status &= 0xFE;
-    _pc += 1;
+void C64::runInstructions(long count, Dispatch dispatch) {
+	if (dispatch == Dispatch::TABLE) {
+		for (long i = 0; i < count; ++i) {
+			if (_clockCycle >= _scheduler.next()) {
+				dispatchEvents();
+			}
+			_clockCycle += stepTable();
+		}
+	} else if (dispatch == Dispatch::BLOCK || dispatch == Dispatch::JIT) {
+		for (long i = 0; i < count; dispatchEvents()) {
+			while (i < count && _clockCycle < _scheduler.next()) {
+				i += runBlock(count - i, dispatch == Dispatch::JIT);
+			}
+		}
+	} else {
+		for (long i = 0; i < count; dispatchEvents()) {
+			for (; i < count && _clockCycle < _scheduler.next(); ++i) {
+				_clockCycle += step<false>();
+			}
+		}
+	}
 }
 
-void C64::jmp_abs() {
-    _pc = readVec(_pc+1);
+bool C64::startTrace(const std::string& filename) {
+	auto trace = std::make_unique<TraceWriter>(filename);
+	if (!trace->isOpen()) {
+		return false;
+	}
+	_trace = std::move(trace);
+	return true;
 }
 
-void C64::jmp_ind() {
-    _pc = readVec(readVec(_pc+1));
+void C64::stopTrace() {
+	// joins the writer thread once everything has been written
+	_trace.reset();
 }
 
-void C64::sec() {
-    _status |= 0x01;
-    _pc += 1;
+std::vector<OpcodeInfo> C64::initOpcodes() {
+	std::vector<OpcodeInfo> opcodes(256);
+#define OPCODE(code, text, mode, bytes, cycles, ...) opcodes[code] = {text, AddressMode::mode, bytes, cycles, &C64::__VA_ARGS__};
+#include "opcodes.inl"
+#undef OPCODE
+	for (auto& opcode : opcodes) {
+		opcode.endsBlock = opcode.addressMode == AddressMode::RELATIVE || opcode.text == "jmp" || opcode.text == "jsr" ||
+			opcode.text == "rts" || opcode.text == "rti" || opcode.text == "brk" || opcode.text == "jam";
+	}
+	return opcodes;
 }
 
-void C64::plp() {
-    _status = pop();
-    _pc += 1;
-}
 
-void C64::branch(bool value) {
-    if (value) {
-        uint8_t offset = readByte(_pc+1);
-        int8_t signedOffset = offset;
-        _pc = _pc + 2 + signedOffset;
-    } else {
-        _pc += 2;
+bool C64::readFile(const std::string &filename, uint8_t *ptr, size_t size) {
+    ifstream is;
+    is.open (filename.c_str(), ios::binary);
+    if (!is) {
+        std::cerr << "Can't find file: " << filename << "\n";
+        return false;
     }
+    is.seekg (0, ios::end);
+    auto length = is.tellg();
+    if (length != static_cast<std::streamoff>(size)) {
+        std::cerr << "Not a " << size << " byte ROM: " << filename << "\n";
+        return false;
+    }
+    is.seekg (0, ios::beg);
+    is.read ((char*)ptr, length);
+    return static_cast<bool>(is);
 }
 
-void C64::bpl() {
-    branch((_status & 0x80) == 0);
-}
-
-
-void C64::bmi() {
-    branch((_status & 0x80) != 0);
-}
-
-void C64::bvc() {
-    branch((_status & 0x40) == 0);
-}
-
-void C64::bvs() {
-    branch((_status & 0x40) != 0);
-}
-
-void C64::cli() {
-    _status &= 0xFB;
-    _pc += 1;
-}
-
-// JSR (short for "Jump to SubRoutine") is the mnemonic for a machine language instruction which calls a subroutine;
-void C64::jsr() {
-    uint16_t jmpAddress = readVec(_pc+1);
-    pushVec(_pc + 2);
-    _pc = jmpAddress;
-}
-
-void C64::rti() {
-    _status = pop();
-    _pc = popVec();
-}
-
-void C64::rts() {
-    _pc = popVec();
-    _pc += 1;
-}
-
-void C64::pla() {
-    // pull accumulator
-    _a = pop();
-    _pc += 1;
-}
-
-void C64::sei() {
-    _status |= 0x04;
-    _pc ++;
-}
-
-void C64::txs() {
-	// TXS (short for "Transfer X to Stack pointer") is the mnemonic for a machine language instruction which transfers
-	// ("copies") the contents of the X index register into the stack pointer.
-	push(_x);
-	_pc ++;
+C64::~C64() {
 }
 
-void C64::cld() {
-	_status &= 0xF7;
-	_pc++;
-}
 //C64::C64(Mode mode) : _mode(mode), _clockCycle(0) {
 //    _kernal = new uint8_t[8192];
 //    _basic = new uint8_t[8192];
@@ -564,108 +650,488 @@ void C64::cld() {
 //
 //}
 
-uint8_t & C64::getRefAbs() {
-    return _ram[readVec(_pc+1)];
+
+
+
+uint16_t C64::strToVec(const std::string & s) {
+    if (s[0] == '$') {
+        return std::stoul(s.substr(1).c_str(), nullptr, 16);
+    }
+    return std::stoul(s.c_str(), nullptr, 10);
 }
-uint8_t & C64::getRefAbx() {
-    return _ram[readVec(_pc+1) + _x];
+
+
+void C64::updateMemoryMap() {
+	// Configuration for memory areas $A000-$BFFF, $D000-$DFFF and $E000-$FFFF depends
+	// on the 3 LSB of processor port (0x0001). Lines configured as inputs read as 1.
+	uint8_t port = (_ramPage[0x00][0x01] | ~_ramPage[0x00][0x00]) & 0x07;
+	bool loram = port & 0x01;
+	bool hiram = port & 0x02;
+	bool charen = port & 0x04;
+	for (int page = 0; page < 256; ++page) {
+		_readPage[page] = _ramPage[page];
+		_writePage[page] = _shared[page] || _code[page] ? nullptr : _ramPage[page];
+	}
+	// writes to ROM go to the RAM underneath, so only the read table changes for ROMs
+	if (loram && hiram) {
+		for (int page = 0xA0; page < 0xC0; ++page) {
+			_readPage[page] = &_basic[(page - 0xA0) << 8];
+		}
+	}
+	if (hiram) {
+		for (int page = 0xE0; page < 0x100; ++page) {
+			_readPage[page] = &_kernal[(page - 0xE0) << 8];
+		}
+	}
+	if (loram || hiram) {
+		for (int page = 0xD0; page < 0xE0; ++page) {
+			if (charen) {
+				// I/O area: chips go through their handlers, the rest stays plain memory
+				if (_ioHandler[page].read != nullptr) {
+					_readPage[page] = nullptr;
+					_writePage[page] = nullptr;
+				} else {
+					_readPage[page] = &_io[(page - 0xD0) << 8];
+					_writePage[page] = &_io[(page - 0xD0) << 8];
+				}
+			} else {
+				// character ROM
+				_readPage[page] = &_charRom[(page - 0xD0) << 8];
+			}
+		}
+	}
 }
 
-uint8_t & C64::getRefZP() {
-    return _ram[readByte(_pc+1)];
+void C64::syncChips() {
+	_vic->run(_clockCycle);
+	// sprite collisions found while catching up can raise an interrupt
+	setIrq(IRQ_VIC, _vic->irq());
 }
-uint8_t & C64::getRefZPx() {
-    return _ram[readByte(_pc+1)+_x];
+
+// chips see the bus as it is at the start of the current instruction
+uint8_t C64::readIO(uint16_t address) {
+	syncChips();
+	return (this->*_ioHandler[address >> 8].read)(address);
 }
-uint8_t C64::getOperandImm() {
-    return readByte(_pc+1);
+
+void C64::writeIO(uint16_t address, uint8_t value) {
+	_leaveBlock = true;
+	if (address < 0x0002) {
+		_ramPage[0x00][address] = value;
+		updateMemoryMap();
+		return;
+	}
+	if (_readPage[address >> 8] != nullptr) {
+		// not chip registers: RAM shared with a fork, or code
+		writableRam(address) = value;
+		return;
+	}
+	syncChips();
+	(this->*_ioHandler[address >> 8].write)(address, value);
 }
 
-uint8_t C64::getOperandAbs() {
-    return readByte(readVec(_pc+1));
+uint8_t C64::readVIC(uint16_t address) {
+	return _vic->read(address & 0x3F);
 }
 
-uint8_t C64::getOperandInx() {
-    return readByte(readByte(_pc+1) + _x);
+void C64::writeVIC(uint16_t address, uint8_t value) {
+	_vic->write(address & 0x3F, value);
+	setIrq(IRQ_VIC, _vic->irq());
 }
 
-uint8_t & C64::getRefInx() {
-    return _ram[readVec(readByte(_pc+1) + _x)];
+// the SID decodes the low 5 address bits
+uint8_t C64::readSID(uint16_t address) {
+	uint8_t reg = address & 0x1F;
+	switch (reg) {
+		case 0x19:
+		case 0x1A:
+			// no paddles connected
+			return 0xFF;
+		case 0x1B:
+		case 0x1C:
+			return _sid->read(_clockCycle, reg);
+		default:
+			return _sidBus;
+	}
 }
 
-uint8_t & C64::getRefIny() {
+void C64::writeSID(uint16_t address, uint8_t value) {
+	_sidBus = value;
+	_sid->write(_clockCycle, address & 0x1F, value);
+}
 
+void C64::setAudioSink(std::unique_ptr<AudioSink> sink) {
+	_sid->setSink(std::move(sink));
 }
-uint8_t C64::getOperandIny() {
-    return readByte(readVec(readByte(_pc+1)) + _y);
+
+void C64::setSidModel(SidModel model) {
+	_sid->setModel(_clockCycle, model);
 }
 
+// the CIAs only decode the low 4 address bits, their registers repeat across the page
+uint8_t C64::readCIA1(uint16_t address) {
+	uint8_t value = _cia1->read(address & 0x0F, _clockCycle);
+	setIrq(IRQ_CIA1, _cia1->irq());
+	return value;
+}
 
+void C64::writeCIA1(uint16_t address, uint8_t value) {
+	_cia1->write(address & 0x0F, value, _clockCycle);
+	setIrq(IRQ_CIA1, _cia1->irq());
+}
 
-uint16_t C64::strToVec(const std::string & s) {
-    if (s[0] == '$') {
-        return std::stoul(s.substr(1).c_str(), nullptr, 16);
-    }
-    return std::stoul(s.c_str(), nullptr, 10);
+uint8_t C64::readCIA2(uint16_t address) {
+	if ((address & 0x0F) == 0x00) {
+		// the drive's side of the bus, as it is at this cycle
+		uint8_t low = iecLines(_iecLines, _drive ? _drive->read(_clockCycle) : 0);
+		_cia2->setInputA((low & IEC_CLK ? 0x00 : 0x40) | (low & IEC_DATA ? 0x00 : 0x80) | 0x3F);
+	}
+	uint8_t value = _cia2->read(address & 0x0F, _clockCycle);
+	setNmi(_cia2->irq());
+	return value;
 }
 
+void C64::writeCIA2(uint16_t address, uint8_t value) {
+	_cia2->write(address & 0x0F, value, _clockCycle);
+	setNmi(_cia2->irq());
+	// port A bits 0-1 select the VIC-II bank, inverted
+	_vic->setBank(3 - (_cia2->getPortA() & 0x03));
+	updateSerialBus();
+}
 
-uint8_t * C64::getPtr(uint16_t address) const {
-	// Configuration for memory areas $A000-$BFFF, $D000-$DFFF and $E000-$FFFF depends
-	// on the 3 LSB of processor port (0x0001)
-	// 0xA0000-0xBFFFF
-    if (address >= 0xA000 && address <= 0xBFFF) {
-        if (_ram[0x1] & 0x03) {
-            // basic
-            return &(_basic[address - 0xA0000]);
-        }
-        return &(_ram[address]);
-    }
+void C64::updateSerialBus() {
+	// the outputs pull the lines low through inverters
+	uint8_t port = _cia2->getPortA();
+	uint8_t lines = (port & 0x08 ? IEC_ATN : 0) | (port & 0x10 ? IEC_CLK : 0) | (port & 0x20 ? IEC_DATA : 0);
+	if (lines != _iecLines) {
+		_iecLines = lines;
+		if (_drive) {
+			_drive->write(_clockCycle, lines);
+		}
+	}
+}
 
-    // 0xD000-0xDFFF
-    if (address >= 0xD000 && address <= 0xDFFF) {
-    	if ((_ram[0x0001] & 0x03u) == 0u) {
-    		return &_ram[address];
-    	} else {
-    		if ((_ram[0x0001] & 0x04) == 0) {
-    			// character ROM
-    			return &(_charRom[address - 0xD000]);
-    		} else {
-    			// I/O registers
-    			if (address < 0xD400) {
-    				// VIC-II video display
-    				uint16_t a = (address - 0xD000) / 64;
-    				return _vic->getPtr(a);
-    			} else {
-    				// SID
-    			}
-    		}
-    	}
-    }
+bool C64::insertDisk(const std::string& filename) {
+	D64Parser image;
+	if (!image.parse(filename)) {
+		return false;
+	}
+	if (!_drive) {
+		if (_roms->drive.size() != 0x4000) {
+			std::cerr << "Can't find the 1541 ROM: " << _roms->directory << "/1541\n";
+			return false;
+		}
+		_drive = std::make_unique<DriveThread>(_roms->drive, CLOCK_FREQUENCY[static_cast<int>(_mode)], _clockCycle);
+		_drive->write(_clockCycle, _iecLines);
+		_scheduler.schedule(_clockCycle + DriveThread::SYNC_CYCLES, Event::DRIVE_SYNC);
+	}
+	_drive->insert(std::make_unique<GcrDisk>(image));
+	return true;
+}
 
-    if (address >= 0xE000 && address <= 0xFFFF) {
-        if (_ram[0x1] & (1<<1)) {
-            return &_kernal[address - 0xE000];
-        }
-        return &_ram[address];
-    }
+bool C64::saveSnapshot(std::vector<uint8_t>& out) {
+	if (_drive) {
+		std::cerr << "Snapshots don't include the 1541, remove the disk first\n";
+		return false;
+	}
+	syncChips();
+	SnapshotWriter snapshot;
+	saveState(snapshot, true);
+	snapshot.finish();
+	out = std::move(snapshot.getData());
+	return true;
+}
 
-    return &_ram[address];
+bool C64::saveSnapshot(const std::string& filename) {
+	std::vector<uint8_t> data;
+	if (!saveSnapshot(data)) {
+		return false;
+	}
+	std::ofstream os(filename, std::ios::binary);
+	os.write(reinterpret_cast<const char*>(data.data()), data.size());
+	if (!os) {
+		std::cerr << "Can't write file: " << filename << "\n";
+		return false;
+	}
+	return true;
+}
 
+bool C64::loadSnapshot(const std::string& filename) {
+	std::ifstream is(filename, std::ios::binary);
+	if (!is) {
+		std::cerr << "Can't find file: " << filename << "\n";
+		return false;
+	}
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+	return loadSnapshot(data.data(), data.size());
 }
 
-uint8_t C64::readByte(uint16_t address) const {
-    return *(getPtr(address));
+bool C64::loadSnapshot(const uint8_t* data, size_t size) {
+	if (_drive) {
+		std::cerr << "Snapshots don't include the 1541, can't load one with a disk inserted\n";
+		return false;
+	}
+	SnapshotReader in(data, size);
+	if (!in.isValid()) {
+		std::cerr << "Not a snapshot, of another version or damaged\n";
+		return false;
+	}
+	// every chunk this machine writes has to be there with the same length, so that nothing can go
+	// wrong once the machine starts being overwritten
+	SnapshotWriter layout;
+	saveState(layout, false);
+	SnapshotReader expected(layout.getData().data(), layout.getData().size());
+	for (const auto& chunk : expected.getChunks()) {
+		auto found = in.findChunk(chunk.tag);
+		if (found == nullptr || found->size != chunk.size) {
+			std::cerr << "Incomplete snapshot\n";
+			return false;
+		}
+	}
+	// RAM: a bitmap of the pages stored, then the pages
+	auto ram = in.findChunk("RAM ");
+	size_t pages = 0;
+	for (size_t i = 0; ram != nullptr && i < 32 && i < ram->size; ++i) {
+		for (uint8_t bits = data[ram->offset + i]; bits != 0; bits &= bits - 1) {
+			++pages;
+		}
+	}
+	if (ram == nullptr || ram->size != 32 + pages * 256) {
+		std::cerr << "Incomplete snapshot\n";
+		return false;
+	}
+	in.openChunk("MACH");
+	if (in.get8() != static_cast<uint8_t>(_mode)) {
+		std::cerr << "The snapshot is of a machine with another video standard\n";
+		return false;
+	}
+	in.openChunk("ROMS");
+	const char* names[3] = {"KERNAL", "BASIC", "character"};
+	for (int i = 0; i < 3; ++i) {
+		if (in.get64() != _roms->hashes[i]) {
+			std::cerr << "The snapshot was taken with another " << names[i] << " ROM\n";
+			return false;
+		}
+	}
+	loadState(in);
+	return true;
 }
 
-void C64::writeVec(uint16_t address, uint16_t value) {
-	_ram[address] = (value & 0x00FF);
-	_ram[address+1] = (value >> 8);
+void C64::saveState(SnapshotWriter& out, bool ram) {
+	out.beginChunk("MACH");
+	out.put8(static_cast<uint8_t>(_mode));
+	out.put64(_frameEnd);
+	for (uint8_t value : {_sidBus, _iecLines, _irqSources}) {
+		out.put8(value);
+	}
+	out.put8(_nmiLine);
+	out.put8(_nmiPending);
+	out.endChunk();
+	out.beginChunk("ROMS");
+	for (uint64_t hash : _roms->hashes) {
+		out.put64(hash);
+	}
+	out.endChunk();
+	out.beginChunk("CPU ");
+	out.put16(_pc);
+	for (uint8_t value : {_a, _x, _y, _sp, getStatus()}) {
+		out.put8(value);
+	}
+	out.put64(_clockCycle);
+	out.endChunk();
+	out.beginChunk("SCHD");
+	_scheduler.save(out);
+	out.endChunk();
+	out.beginChunk("VIC ");
+	_vic->save(out);
+	out.endChunk();
+	out.beginChunk("CIA1");
+	_cia1->save(out);
+	out.endChunk();
+	out.beginChunk("CIA2");
+	_cia2->save(out);
+	out.endChunk();
+	out.beginChunk("SID ");
+	_sid->save(_clockCycle, out);
+	out.endChunk();
+	out.beginChunk("IO  ");
+	out.putBytes(_io.get(), 4096);
+	out.endChunk();
+	if (ram) {
+		// pages of zeros are left out
+		uint8_t present[32] = {};
+		for (int page = 0; page < 256; ++page) {
+			if (std::any_of(_ramPage[page], _ramPage[page] + 256, [] (uint8_t b) { return b != 0; })) {
+				present[page >> 3] |= 1 << (page & 7);
+			}
+		}
+		out.beginChunk("RAM ");
+		out.putBytes(present, sizeof(present));
+		for (int page = 0; page < 256; ++page) {
+			if (present[page >> 3] & (1 << (page & 7))) {
+				out.putBytes(_ramPage[page], 256);
+			}
+		}
+		out.endChunk();
+	}
 }
 
-uint16_t C64::readVec(uint16_t address) const {
-    auto* ptr = getPtr(address);
-    return 256 * *(ptr+1) + *ptr;
+void C64::loadState(SnapshotReader& in) {
+	in.openChunk("MACH");
+	in.get8();
+	_frameEnd = static_cast<long>(in.get64());
+	for (uint8_t* value : {&_sidBus, &_iecLines, &_irqSources}) {
+		*value = in.get8();
+	}
+	_nmiLine = in.get8();
+	_nmiPending = in.get8();
+	in.openChunk("CPU ");
+	_pc = in.get16();
+	for (uint8_t* value : {&_a, &_x, &_y, &_sp}) {
+		*value = in.get8();
+	}
+	setStatus(in.get8());
+	_clockCycle = static_cast<long>(in.get64());
+	in.openChunk("IO  ");
+	in.getBytes(_io.get(), 4096);
+	if (in.openChunk("RAM ")) {
+		uint8_t present[32];
+		in.getBytes(present, sizeof(present));
+		for (int page = 0; page < 256; ++page) {
+			if (_shared[page]) {
+				// not a byte of it is kept, don't copy it
+				_ram[page] = std::make_shared<RamPage>();
+				_ramPage[page] = _ram[page]->bytes;
+				_shared[page] = false;
+			}
+			if (present[page >> 3] & (1 << (page & 7))) {
+				in.getBytes(_ramPage[page], 256);
+			} else {
+				memset(_ramPage[page], 0, 256);
+			}
+		}
+	}
+	_stack = _ramPage[0x01];
+	// RAM may have been replaced under the blocks
+	_blocks.clear();
+	std::fill(std::begin(_code), std::end(_code), false);
+	updateMemoryMap();
+	_vic->setMemory(_ramPage, _charRom, &_io[0x800]);
+	in.openChunk("VIC ");
+	_vic->load(in);
+	in.openChunk("CIA1");
+	_cia1->load(in);
+	in.openChunk("CIA2");
+	_cia2->load(in);
+	in.openChunk("SID ");
+	_sid->load(_clockCycle, in);
+	// last: loading the chips may have scheduled their events
+	in.openChunk("SCHD");
+	_scheduler.load(in);
+}
+
+std::unique_ptr<C64> C64::fork() {
+	if (_drive) {
+		std::cerr << "Can't fork a machine with a disk inserted\n";
+		return nullptr;
+	}
+	syncChips();
+	std::unique_ptr<C64> copy(new C64(_mode, _roms));
+	for (int page = 0; page < 256; ++page) {
+		if (page < 2) {
+			memcpy(copy->_ramPage[page], _ramPage[page], 256);
+		} else {
+			copy->_ram[page] = _ram[page];
+			copy->_ramPage[page] = _ramPage[page];
+			copy->_shared[page] = _shared[page] = true;
+		}
+	}
+	updateMemoryMap();
+	SnapshotWriter state;
+	saveState(state, false);
+	SnapshotReader in(state.getData().data(), state.getData().size());
+	copy->loadState(in);
+	return copy;
+}
+
+void C64::makeWritable(int page) {
+	if (_shared[page]) {
+		if (_ram[page].use_count() > 1) {
+			_ram[page] = std::make_shared<RamPage>(*_ram[page]);
+			_ramPage[page] = _ram[page]->bytes;
+			_vic->setMemory(_ramPage, _charRom, &_io[0x800]);
+		} else {
+			// the others have made their copies: see their last reads done before writing over the page
+			std::atomic_thread_fence(std::memory_order_acquire);
+		}
+		_shared[page] = false;
+	}
+	if (_code[page]) {
+		_code[page] = false;
+		_blocks.invalidate(page);
+	}
+	updateMemoryMap();
+}
+
+uint8_t C64::readOpenBus(uint16_t) {
+	// nothing drives the data bus, approximate the floating value with $FF
+	return 0xFF;
+}
+
+void C64::writeNothing(uint16_t, uint8_t) {
+}
+
+bool C64::loadProgram(const std::vector<uint8_t>& program) {
+	if (program.size() < 3) {
+		return false;
+	}
+	uint16_t start = program[0] | (program[1] << 8);
+	size_t length = program.size() - 2;
+	if (start + length > 0x10000 || start < 0x0002) {
+		return false;
+	}
+	for (size_t i = 0; i < length; ++i) {
+		writableRam(start + i) = program[2 + i];
+	}
+	uint16_t end = start + length;
+	// start of variables, of arrays and end of arrays: BASIC's LOAD sets them all to the end of the program
+	writeVec(0x002D, end);
+	writeVec(0x002F, end);
+	writeVec(0x0031, end);
+	// end address of the last LOAD
+	writeVec(0x00AE, end);
+	return true;
+}
+
+void C64::typeText(const std::string& text) {
+	// the KERNAL keyboard buffer at $0277, with its length in $C6
+	const size_t capacity = 10;
+	size_t count = std::min(text.size(), capacity);
+	for (size_t i = 0; i < count; ++i) {
+		writableRam(0x0277 + i) = text[i];
+	}
+	writableRam(0x00C6) = count;
+}
+
+bool C64::waitingForKeyboard() const {
+	// the loop at $E5CD waits for the keyboard buffer to fill
+	return _pc >= 0xE5CD && _pc <= 0xE5D4 && _readPage[0xE5] == &_kernal[0x0500];
+}
+
+void C64::poke(uint16_t address, uint8_t value) {
+	writableRam(address) = value;
+	if (address < 2) {
+		updateMemoryMap();
+	}
+}
+
+void C64::setProgramCounter(uint16_t address) {
+	_pc = address;
+}
+
+void C64::writeVec(uint16_t address, uint16_t value) {
+	writableRam(address) = (value & 0x00FF);
+	writableRam(address + 1) = (value >> 8);
 }
 
 //void C64::run() {
@@ -6,16 +6,20 @@
 #include <functional>
 #include <memory>
 #include "vicii.h"
+#include "cia.h"
+#include "sidthread.h"
+#include "drivethread.h"
 #include "settings.h"
-
-enum Flag {
-    CARRY = 0,
-    ZERO = 1,
-    INTERRUPT_DISABLE = 2,
-    DECIMAL_MODE = 3,
-    BREAK = 4,
-    OVERFLOW = 6,
-    NEGATIVE = 7
+#include "trace.h"
+#include "scheduler.h"
+#include "cpu6502.h"
+#include "snapshot.h"
+#include "blockcache.h"
+
+// sources of the IRQ line, which is asserted while any of them is
+enum IrqSource : uint8_t {
+    IRQ_VIC = 0x01,
+    IRQ_CIA1 = 0x02
 };
 
 enum AddressMode {
@@ -27,7 +31,9 @@ enum AddressMode {
     ABSOLUTE_Y,
     ZEROPAGE,
     ZEROPAGE_INDEXED,
+    ZEROPAGE_Y,
     RELATIVE,
+    INDIRECT,
     INDEXED_INDIRECT,
     INDIRECT_INDEXED
 };
@@ -39,12 +45,6 @@ enum AddressMode {
 inline int const COLOR_COUNT = 16;
 
 
-inline const int NUMBER_OF_LINES[2] = {312, 263};
-inline const int CYCLES_PER_LINE[2] = {63, 65};
-
-inline const double CLOCK_FREQUENCY[2] = {0.9852486e6, 1.0227273e6};
-
-
 
 
 
@@ -59,8 +59,13 @@ struct Vector {
 };
 
 class C64;
-class Shader;
-class MainShader;
+
+enum class Dispatch {
+	SWITCH,                     // the switch in C64::step, where the handlers get inlined
+	TABLE,                      // a call through OpcodeInfo::methodPtrOne
+	BLOCK,                      // instructions decoded a block at a time and kept, see BlockCache
+	JIT                         // BLOCK, with the hot blocks compiled to native code where Jit::isAvailable()
+};
 
 struct OpcodeInfo {
 
@@ -69,289 +74,268 @@ struct OpcodeInfo {
     uint8_t bytes;
     uint8_t cycles;
     void (C64::*methodPtrOne)();
+    // jumps, branches, returns, BRK and JAM: the next instruction may not be the one after
+    bool endsBlock = false;
 
 
 };
 
-class C64 {
+// the contents of the ROMs, read once and shared by any number of machines, on any thread
+struct Roms {
+	uint8_t kernal[8192];
+	uint8_t basic[8192];
+	uint8_t charRom[4096];
+	uint64_t hashes[3];         // of each, to match snapshots with them
+	std::vector<uint8_t> drive; // the 1541 DOS ROM, empty if there is none
+	std::string directory;      // where they were read from
+};
+
+struct RamPage {
+	uint8_t bytes[256];
+};
+
+class C64;
+
+// memory mapped chip registers: the page tables hold nullptr for these pages and
+// accesses are dispatched to the handlers of the page instead
+struct IOHandler {
+	uint8_t (C64::*read)(uint16_t address);
+	void (C64::*write)(uint16_t address, uint8_t value);
+};
+
+class C64 : public Cpu6502<C64> {
 public:
+    // reads the ROMs from the directory given to CMake as C64_ROM_DIRECTORY
     explicit C64(Mode mode);
+    C64(Mode mode, std::shared_ptr<const Roms> roms);
     ~C64();
-    uint8_t readByte(uint16_t address) const;
-    uint16_t readVec(uint16_t address) const;
+    // kernal, basic, chargen and, if there, 1541 from the directory. nullptr, with a message on
+    // stderr, if one of the first three is missing or has the wrong size.
+    static std::shared_ptr<const Roms> loadRoms(const std::string& directory);
+    static const char* const DEFAULT_ROM_DIRECTORY;
+    uint8_t readByte(uint16_t address);
+    using Cpu6502::readVec;
+    void writeByte(uint16_t address, uint8_t value);
     void writeVec(uint16_t address, uint16_t value);
+    void poke(uint16_t address, uint8_t value);
+    // a byte of RAM, whatever is banked in over it
+    uint8_t peek(uint16_t address) const;
+    void setProgramCounter(uint16_t address);
+    // copy a PRG (load address, then the data) into RAM and set the pointers at $2D-$32 and $AE
+    // to its end, as LOAD does. Returns false if there is no data or it doesn't fit.
+    bool loadProgram(const std::vector<uint8_t>& program);
+    // put PETSCII characters into the keyboard buffer, as many as it holds
+    void typeText(const std::string& text);
+    // the screen editor is waiting for a key, as at the BASIC prompt
+    bool waitingForKeyboard() const;
+    // execute count instructions, regardless of frames
+    [[gnu::flatten]] void runInstructions(long count, Dispatch dispatch = Dispatch::SWITCH);
+    // how runFrame executes instructions, BLOCK unless set otherwise. Every dispatch gives the same results.
+    void setDispatch(Dispatch dispatch);
     void test();
-    void run();
+    // run the CPU until a whole frame worth of cycles has been consumed
+    void runFrame();
+    // palette indices of the visible area, getFrameWidth() x getFrameHeight()
+    const uint8_t* getFrameBuffer() const;
+    int getFrameWidth() const;
+    int getFrameHeight() const;
+    long getClockCycle() const;
+    // record every executed instruction to a binary trace file, see TraceWriter
+    bool startTrace(const std::string& filename);
+    void stopTrace();
+    // SID samples go to the sink, at its sample rate. Without one the SID is still emulated.
+    void setAudioSink(std::unique_ptr<AudioSink> sink);
+    void setSidModel(SidModel model);
+    // put a D64 image in a 1541 on the serial bus as device 8, which is emulated on its own thread.
+    // The drive is connected on the first call; false if the image or the drive ROM can't be read.
+    bool insertDisk(const std::string& filename);
+    // The whole machine between two instructions, in the format of SnapshotWriter: CPU, RAM, chips and
+    // the hashes of the ROMs it runs. Loading one puts this machine in that state, it must have the same
+    // video standard and ROMs. The 1541 is not included, so neither works with a disk inserted; both
+    // return false, with a message on stderr, if they fail. A load that fails leaves the machine as it was.
+    bool saveSnapshot(std::vector<uint8_t>& out);
+    bool loadSnapshot(const uint8_t* data, size_t size);
+    bool saveSnapshot(const std::string& filename);
+    bool loadSnapshot(const std::string& filename);
+    // A copy of the machine, which goes on independently from here. RAM pages are shared copy-on-write
+    // with the original and the ROMs are shared for good. A fork takes about 40 KB for the chips and the
+    // page tables; the SID thread starts when the copy first uses the SID, and its 113 KB frame buffer is
+    // allocated with the first frame it draws. The copy has no audio sink, trace or drive; nullptr if a
+    // disk is inserted.
+    std::unique_ptr<C64> fork();
+    static const OpcodeInfo& getOpcodeInfo(uint8_t opcode);
+    // disassemble the instruction made of the given bytes, located at address
+    static std::string disassemble(const uint8_t* bytes, uint16_t address);
 private:
-
-	std::string disassemble(const OpcodeInfo& opcode, uint16_t address);
+	friend class Cpu6502<C64>;
+	void saveState(SnapshotWriter& out, bool ram);
+	// restore what the snapshot has been checked to contain
+	void loadState(SnapshotReader& in);
+	// a byte of RAM to write to, the page is copied first if it is shared and its blocks are
+	// dropped if code was decoded from it
+	uint8_t& writableRam(uint16_t address);
+	void makeWritable(int page);
 	std::unique_ptr<VICII> _vic;
-	long _clockCycle;
-	uint8_t* _kernal;
-	uint8_t* _basic;
-	uint8_t* _charRom;
-	uint8_t* _ram;
-
-	std::unique_ptr<Shader> _blitShader;
-	std::unique_ptr<MainShader> _mainShader;
-	void initializeGL();
-	void initOpcodes();
-    uint8_t getBit(uint8_t value, uint8_t bit);
-    void setBit(uint8_t& ref, uint8_t value, uint8_t bit);
-    // stack operations
-    void push(uint8_t);
-    void pushVec(uint16_t);
-    uint8_t pop();
-    uint16_t popVec();
-    void setNegFlag(const uint8_t&);
-    void setZeroFlag(const uint8_t&);
-    void setCarryFlag(const uint16_t&);
-    void branch(bool);
-    void brk();
-    void php();
-    void clc();
-    void bpl();
-    void jsr();
-    void plp();
-    void bmi();
-    void sec();
-    void rti();
-    void pha();
-    void jmp_abs();
-    void jmp_ind();
-    void bvc();
-    void cli();
-    void rts();
-    void pla();
-    void bvs();
-    void sei();
-    void txs();
-    void cld();
-
-
-
-    template<int length, uint8_t (C64::*addr)()>
-    void ora() {
-        auto value = (*this.*addr)();
-        _a |= value;
-        // The negative status flag is set if the result is negative, i.e. has its most significant bit set.
-        setNegFlag(_a);
-        // The zero flag is set if the result is zero, or cleared if it is non-zero.
-        setZeroFlag(_a);
-        _pc += length;
-    }
-
-    template<int length, uint8_t (C64::*addr)()>
-    void _and() {
-        auto value = (*this.*addr)();
-        _a &= value;
-        // The negative status flag is set if the result is negative, i.e. has its most significant bit set.
-        setNegFlag(_a);
-        // The zero flag is set if the result is zero, or cleared if it is non-zero.
-        setZeroFlag(_a);
-        _pc += length;
-    }
-
-    template<int length, uint8_t (C64::*addr)()>
-    void eor() {
-        auto value = (*this.*addr)();
-        _a ^= value;
-        // The negative status flag is set if the result is negative, i.e. has its most significant bit set.
-        setNegFlag(_a);
-        // The zero flag is set if the result is zero, or cleared if it is non-zero.
-        setZeroFlag(_a);
-        _pc += length;
-    }
-
-    // ADd with Carry
-    template<int length, uint8_t (C64::*addr)()>
-    void adc() {
-        auto value = (*this.*addr)();
-        auto msb = _a & 0x80;
-        bool sameSign = (msb == (value & 0x80));
-        uint16_t result = _a + value;
-        uint8_t carry = ((result & 0xFF00) != 0 ? 1 : 0);
-        setBit(_status, carry, 0);
-        setZeroFlag(_a);
-        auto msb_after = _a & 0x80;
-        // The overflow flag is thus set when the most significant bit (here considered the sign bit) is changed by
-        // adding two numbers with the same sign (or subtracting two numbers with opposite signs).
-        setBit(_status, (sameSign && (msb != msb_after) ? 1 : 0), Flag::OVERFLOW);
-
-    }
-
-
-    template<int length, uint8_t(C64::*addr)()>
-    void bit() {
-        auto value = (*this.*addr)();
-        if ((value & 0x80) == 0) {
-            _status &= 0x7F;
-        } else {
-            _status |= 0x80;
-        }
-        if ((value & 0x40) == 0) {
-            _status &= 0xBF;
-        } else {
-            _status |= 0x40;
-        }
-        auto result = _a | value;
-        setZeroFlag(result);
-        _pc += length;
-    }
-
-    // STore Accumulator
-    template<int length, uint8_t& (C64::*addr)()>
-    void sta() {
-        auto& value = (*this.*addr)();
-        value = _a;
-        _pc += length;
-    }
-
-    template<int length, uint8_t& (C64::*addr)()>
-    void stx() {
-        auto& value = (*this.*addr)();
-        value = _x;
-        _pc += length;
-    }
-
-    template<int length, uint8_t& (C64::*addr)()>
-    void sty() {
-        auto& value = (*this.*addr)();
-        value = _y;
-        _pc += length;
-    }
-
-    // arithmetic shift left
-    template<int length, uint8_t& (C64::*addr)()>
-    void asl() {
-        auto& value = (*this.*addr)();
-        bool set_carry = (value & 0x80) != 0;
-        if (set_carry) {
-            _status |= 0x01;
-        } else {
-            _status &= 0xFE;
-        }
-        value <<= 1;
-        setNegFlag(value);
-        setZeroFlag(value);
-    }
-
-    // rotate left
-    template<int length, uint8_t& (C64::*addr)()>
-    void rol() {
-        auto& value = (*this.*addr)();
-        // get current carry
-        uint8_t carry = getBit(_status, 0);
-        uint8_t msb = getBit(value, 7);
-        setBit(_status, msb, 0);
-        value <<= 1;
-        setBit(value, carry, 0);
-        setNegFlag(value);
-        setZeroFlag(value);
-    }
-
-    // rotate right
-    template<int length, uint8_t& (C64::*addr)()>
-    void ror() {
-        auto& value = (*this.*addr)();
-        // get current carry
-        uint8_t carry = getBit(_status, 0);
-        uint8_t lsb = getBit(value, 0);
-        setBit(_status, lsb, Flag::CARRY);
-        value >>= 1;
-        setBit(value, carry, 7);
-        setNegFlag(value);
-        setZeroFlag(value);
-    }
-
-
-    // logic shift right
-    template<int length, uint8_t& (C64::*addr)()>
-    void lsr() {
-        auto& value = (*this.*addr)();
-        uint8_t carry = getBit(value, 0);
-        setBit(_status, carry, 0);
-        value >>= 1;
-        setNegFlag(value);
-        setZeroFlag(value);
-    }
-
-    template<int length, uint8_t (C64::*addr)()>
-    void ldx() {
-    	auto value = (*this.*addr)();
-    	_x = value;
-    	_pc += length;
-    }
-
-	template<int length, uint8_t (C64::*addr)()>
-	void lda() {
-		auto value = (*this.*addr)();
-		_a = value;
-		_pc += length;
-
-		// The negative status flag is set if the result is negative, i.e. has it's most significant bit set.
-		setNegFlag(_a);
-
-		// The zero flag is set if the result is zero, or cleared if it is non-zero.
-		setZeroFlag(_a);
-	}
+	long _frameEnd;             // clock cycle at which the current frame ends
+	Scheduler _scheduler;
+	std::unique_ptr<CIA> _cia1;
+	std::unique_ptr<CIA> _cia2;
+	std::unique_ptr<SidThread> _sid;
+	uint8_t _sidBus;            // last value written to the SID, what its write-only registers read as
+	std::unique_ptr<DriveThread> _drive;
+	uint8_t _iecLines;          // IecLine bits pulled by CIA 2
+	bool _frameDone;
+	uint8_t _irqSources;        // IrqSource bits currently asserting the IRQ line
+	bool _nmiLine;              // CIA 2 asserting the NMI line
+	bool _nmiPending;           // the NMI is edge triggered: set on the transition, cleared when taken
+	std::shared_ptr<const Roms> _roms;
+	const uint8_t* _kernal;
+	const uint8_t* _basic;
+	const uint8_t* _charRom;
+	// RAM by pages. After a fork both machines share all but the zero page and the stack, which they
+	// write all the time: shared pages are mapped read only and copied by the first write to them.
+	std::shared_ptr<RamPage> _ram[256];
+	uint8_t* _ramPage[256];     // the bytes of each page
+	bool _shared[256];
+	// blocks have been decoded from the page, which is mapped read only so that writes drop them
+	bool _code[256];
+	std::unique_ptr<uint8_t[]> _io;     // I/O registers and color RAM at $D000-$DFFF
+
+	// memory map: one pointer per 256 byte page, so an access is a shift, a load and an add.
+	// Reads see the ROMs banked in by the processor port, writes always go to RAM or I/O.
+	// A nullptr entry marks a page of chip registers, served by _ioHandler.
+	const uint8_t* _readPage[256];
+	uint8_t* _writePage[256];
+	IOHandler _ioHandler[256];
+	// bring every chip up to _clockCycle. Chips are run lazily: only before the CPU
+	// touches their registers and at the end of each frame.
+	void syncChips();
+	// slow paths for pages without a plain memory mapping
+	__attribute__((noinline)) uint8_t readIO(uint16_t address);
+	__attribute__((noinline)) void writeIO(uint16_t address, uint8_t value);
+	uint8_t readVIC(uint16_t address);
+	void writeVIC(uint16_t address, uint8_t value);
+	uint8_t readSID(uint16_t address);
+	void writeSID(uint16_t address, uint8_t value);
+	uint8_t readCIA1(uint16_t address);
+	void writeCIA1(uint16_t address, uint8_t value);
+	uint8_t readCIA2(uint16_t address);
+	void writeCIA2(uint16_t address, uint8_t value);
+	// the serial bus lines on CIA 2 port A: ATN, CLK and DATA out on PA3-5, CLK and DATA in on PA6-7
+	void updateSerialBus();
+	uint8_t readOpenBus(uint16_t address);
+	void writeNothing(uint16_t address, uint8_t value);
+
+	// handle every event due by the current clock cycle
+	__attribute__((noinline)) void dispatchEvents();
+	void setIrq(IrqSource source, bool active);
+	void setNmi(bool active);
+	// schedule an interrupt check delay cycles from the start of the current instruction,
+	// if the IRQ line is asserted and interrupts are enabled
+	void pollInterrupt(int delay);
+	// push the program counter and the status and jump through the vector
+	void interrupt(uint16_t vector);
+
+	// execute a single instruction, returns the number of cycles it took
+	template<bool tracing>
+	int step();
+	int stepTable();
+	// the handler of the opcode, with _operand already set
+	void execute(uint8_t opcode);
+	// run the block at _pc, or a single instruction where there is none, until an event is due, a write
+	// goes through writeIO or limit instructions have run. Returns the number of instructions run.
+	long runBlock(long limit, bool jit);
+	// nullptr for code that is left to the interpreter
+	__attribute__((noinline)) Block* decodeBlock(uint16_t address);
+	bool isRom(const uint8_t* page) const;
+	__attribute__((noinline)) void compileBlock(Block& block);
+	// the slow paths, for the compiled code
+	static uint8_t jitRead(void* machine, uint16_t address);
+	static void jitWrite(void* machine, uint16_t address, uint8_t value);
+	Dispatch _dispatch;
+	BlockCache _blocks;
+	std::unique_ptr<Jit> _jit;  // made when the first block gets hot
+	bool _leaveBlock;           // set by writeIO: the running block may have been written over or banked out
+	// flattened so step, its opcode handlers and the memory fast paths are all
+	// inlined into the loop, the slow I/O paths are kept out of line
+	template<bool tracing>
+	[[gnu::flatten]] void runUntil(long cycle);
+	std::unique_ptr<TraceWriter> _trace;
+	static std::vector<OpcodeInfo> initOpcodes();
+    // the read of a read-modify-write instruction. The 6510 writes the unmodified value back before
+    // the result, and chips see that extra write: ASL $D019 acknowledges interrupts this way.
+    uint8_t readModify(uint16_t address);
+
+
+
+
+    // rebuild the page tables from the processor port at $0000/$0001
+    void updateMemoryMap();
+    uint16_t strToVec(const std::string&);
+    // false, with a message on stderr, unless the file is there and has exactly size bytes
+    static bool readFile(const std::string& filename, uint8_t* ptr, size_t size);
 
-	template<int length, uint8_t (C64::*addr)()>
-	void cmp() {
-		auto operand = (*this.*addr)();
-		uint16_t result = _a - operand;
-		uint8_t lb = (uint8_t) result & 0xFF;
-		setCarryFlag(result);
-		setNegFlag(lb);
-		setZeroFlag(lb);
-		_pc += length;
 
-	}
+    static const std::vector<OpcodeInfo> _opcodes;
+    Mode _mode;
 
 
-    uint8_t& getRefAcc() {
-        return _a;
-    }
-    uint8_t& getRefAbs();
-    uint8_t& getRefAbx();
-    uint8_t& getRefZP();
-    uint8_t& getRefZPx();
-    uint8_t& getRefInx();
-    uint8_t& getRefIny();
-    uint8_t getOperandImm();
-    uint8_t getOperandAbs();
-    uint8_t getOperandAbx();
-    uint8_t getOperandAby();
-    uint8_t getOperandInx();
-    uint8_t getOperandIny();
-    uint8_t getOperandZP();
-    uint8_t getOperandZPx();
 
+};
 
+inline const uint8_t* C64::getFrameBuffer() const {
+	return _vic->getFrameBuffer();
+}
 
+inline uint8_t C64::peek(uint16_t address) const {
+	return _ramPage[address >> 8][address & 0xFF];
+}
 
-    uint8_t* getPtr(uint16_t address) const;
-    uint16_t strToVec(const std::string&);
-    void readFile(const std::string& filename, uint8_t* ptr);
-
-
-    uint16_t _pc;               // program counter (16 bits)
-    uint8_t _a, _x, _y;
-    uint8_t _sp;
-
-    // Bit  Flag
-    // 0    Carry
-    // 1    Zero
-    // 2    Interrupt disable
-    // 3    Decimal mode
-    // 4    Break
-    // 5    Unused
-    // 6    Overflow
-    // 7    Negative
-    uint8_t _status;
-    std::vector<OpcodeInfo> _opcodes;
-    Mode _mode;
+inline int C64::getFrameWidth() const {
+	return _vic->getVisibleWidth();
+}
 
+inline int C64::getFrameHeight() const {
+	return _vic->getVisibleHeight();
+}
 
+inline long C64::getClockCycle() const {
+	return _clockCycle;
+}
+
+inline uint8_t C64::readByte(uint16_t address) {
+	const uint8_t* page = _readPage[address >> 8];
+	if (page != nullptr) {
+		return page[address & 0xFF];
+	}
+	return readIO(address);
+}
+
+inline uint8_t C64::readModify(uint16_t address) {
+	uint8_t value = readByte(address);
+	if (_writePage[address >> 8] == nullptr) {
+		writeIO(address, value);
+	}
+	return value;
+}
+
+inline void C64::writeByte(uint16_t address, uint8_t value) {
+	uint8_t* page = _writePage[address >> 8];
+	// $0000/$0001 is the processor port, which remaps memory when written
+	if (page != nullptr && address > 0x0001) {
+		page[address & 0xFF] = value;
+	} else {
+		writeIO(address, value);
+	}
+}
+
+inline uint8_t& C64::writableRam(uint16_t address) {
+	if (_shared[address >> 8] || _code[address >> 8]) {
+		makeWritable(address >> 8);
+	}
+	return _ramPage[address >> 8][address & 0xFF];
+}
 
-};
\ No newline at end of file
+inline void C64::setDispatch(Dispatch dispatch) {
+	_dispatch = dispatch;
+}
@@ -0,0 +1,217 @@
+#include "catalog.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "d64parse.h"
+
+namespace {
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t recordSize;
+		uint64_t imageCount;
+		uint64_t recordCount;
+		uint64_t pathBytes;
+	};
+
+	const char* TYPE_NAMES[] = {"DEL", "SEQ", "PRG", "USR", "REL"};
+
+	uint8_t typeByte(const std::string& name) {
+		for (uint8_t i = 0; i < 5; ++i) {
+			if (name == TYPE_NAMES[i]) {
+				return 0x80 | i;
+			}
+		}
+		return 0;
+	}
+
+	// letters come out lowercase whichever character set they are in, graphics as dots
+	char toAscii(uint8_t c) {
+		if ((c >= 0x41 && c <= 0x5A) || (c >= 0x61 && c <= 0x7A) || (c >= 0xC1 && c <= 0xDA)) {
+			return static_cast<char>('a' + (c & 0x1F) - 1);
+		}
+		if (c >= 0x20 && c <= 0x40) {
+			return static_cast<char>(c);
+		}
+		return '.';
+	}
+
+	uint64_t fnv1a(uint64_t hash, const uint8_t* data, size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ data[i]) * 0x100000001B3ull;
+		}
+		return hash;
+	}
+}
+
+const char* catalogTypeName(uint8_t type) {
+	return (type & 0x80) && (type & 0x7F) < 5 ? TYPE_NAMES[type & 0x7F] : "???";
+}
+
+std::vector<std::string> findImages(const std::string& directory) {
+	namespace fs = std::filesystem;
+	std::vector<std::string> images;
+	std::error_code error;
+	fs::recursive_directory_iterator it(directory, fs::directory_options::skip_permission_denied, error);
+	for (; !error && it != fs::recursive_directory_iterator(); it.increment(error)) {
+		auto extension = it->path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension == ".d64" && it->is_regular_file(error)) {
+			images.push_back(it->path().string());
+		}
+	}
+	std::sort(images.begin(), images.end());
+	return images;
+}
+
+Catalog indexImages(const std::vector<std::string>& images, WorkPool& pool, size_t& failed) {
+	// every image fills its own slot, so the index comes out in the same order however the jobs ran
+	std::vector<std::vector<CatalogRecord>> found(images.size());
+	std::vector<char> ok(images.size());
+	pool.run(images.size(), [&](size_t i) {
+		D64Parser parser;
+		if (!parser.parse(images[i])) {
+			return;
+		}
+		ok[i] = 1;
+		const auto& entries = parser.getEntries();
+		for (size_t j = 0; j < entries.size(); ++j) {
+			const auto& entry = entries[j];
+			CatalogRecord record {};
+			record.hash = 0xCBF29CE484222325ull;
+			for (const auto& sector : parser.getSectors(j)) {
+				record.hash = fnv1a(record.hash, sector.data, sector.size);
+			}
+			record.image = static_cast<uint32_t>(i);
+			record.blocks = entry.sector_size;
+			record.type = typeByte(entry.file_type);
+			record.nameLength = static_cast<uint8_t>(std::min<size_t>(entry.pet_name.size(), 16));
+			for (int k = 0; k < record.nameLength; ++k) {
+				record.petscii[k] = static_cast<uint8_t>(entry.pet_name[k]);
+				record.ascii[k] = toAscii(record.petscii[k]);
+			}
+			found[i].push_back(record);
+		}
+	});
+	Catalog catalog;
+	failed = 0;
+	for (size_t i = 0; i < images.size(); ++i) {
+		if (!ok[i]) {
+			++failed;
+			continue;
+		}
+		// images that failed are dropped, so renumber the rest
+		for (auto record : found[i]) {
+			record.image = static_cast<uint32_t>(catalog.images.size());
+			catalog.records.push_back(record);
+		}
+		catalog.images.push_back(images[i]);
+	}
+	return catalog;
+}
+
+bool writeCatalog(const std::string& filename, const Catalog& catalog) {
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	std::vector<uint32_t> offsets {0};
+	std::string paths;
+	for (const auto& image : catalog.images) {
+		paths += image;
+		offsets.push_back(static_cast<uint32_t>(paths.size()));
+	}
+	Header header;
+	memcpy(header.magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC));
+	header.version = CATALOG_VERSION;
+	header.recordSize = sizeof(CatalogRecord);
+	header.imageCount = catalog.images.size();
+	header.recordCount = catalog.records.size();
+	header.pathBytes = paths.size();
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(catalog.records.data(), sizeof(CatalogRecord), catalog.records.size(), file) == catalog.records.size() &&
+		fwrite(offsets.data(), sizeof(uint32_t), offsets.size(), file) == offsets.size() &&
+		fwrite(paths.data(), 1, paths.size(), file) == paths.size();
+	return fclose(file) == 0 && ok;
+}
+
+CatalogReader::CatalogReader(const std::string& filename) : _data(nullptr), _size(0), _records(nullptr), _recordCount(0),
+	_imageOffsets(nullptr), _imageCount(0), _paths(nullptr) {
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header)) {
+		close(fd);
+		return;
+	}
+	size_t size = static_cast<size_t>(info.st_size);
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return;
+	}
+	auto data = static_cast<const uint8_t*>(mapping);
+	Header header;
+	memcpy(&header, data, sizeof(header));
+	// the counts must account for the whole file, without overflowing on a corrupt header
+	size_t limit = size / sizeof(uint32_t);
+	if (memcmp(header.magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0 || header.version != CATALOG_VERSION ||
+		header.recordSize != sizeof(CatalogRecord) || header.imageCount >= limit || header.recordCount >= limit ||
+		sizeof(Header) + header.recordCount * sizeof(CatalogRecord) + (header.imageCount + 1) * sizeof(uint32_t) +
+		header.pathBytes != size) {
+		munmap(mapping, size);
+		return;
+	}
+	_data = data;
+	_size = size;
+	_records = reinterpret_cast<const CatalogRecord*>(data + sizeof(Header));
+	_recordCount = header.recordCount;
+	_imageOffsets = reinterpret_cast<const uint32_t*>(_records + _recordCount);
+	_imageCount = header.imageCount;
+	_paths = reinterpret_cast<const char*>(_imageOffsets + _imageCount + 1);
+}
+
+CatalogReader::~CatalogReader() {
+	if (_data != nullptr) {
+		munmap(const_cast<uint8_t*>(_data), _size);
+	}
+}
+
+std::string CatalogReader::getImage(size_t i) const {
+	if (i >= _imageCount || _imageOffsets[i] > _imageOffsets[i + 1] || _paths + _imageOffsets[i + 1] > reinterpret_cast<const char*>(_data + _size)) {
+		return std::string();
+	}
+	return std::string(_paths + _imageOffsets[i], _paths + _imageOffsets[i + 1]);
+}
+
+std::vector<const CatalogRecord*> CatalogReader::find(const std::string& text) const {
+	std::string lower(text);
+	std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+	std::vector<const CatalogRecord*> ret;
+	for (size_t i = 0; i < _recordCount; ++i) {
+		const auto& record = _records[i];
+		auto end = record.ascii + std::min<size_t>(record.nameLength, 16);
+		if (std::search(record.ascii, end, lower.begin(), lower.end()) != end) {
+			ret.push_back(&record);
+		}
+	}
+	return ret;
+}
+
+std::vector<const CatalogRecord*> CatalogReader::findHash(uint64_t hash) const {
+	std::vector<const CatalogRecord*> ret;
+	for (size_t i = 0; i < _recordCount; ++i) {
+		if (_records[i].hash == hash) {
+			ret.push_back(&_records[i]);
+		}
+	}
+	return ret;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "workpool.h"
+
+// One directory entry of an indexed image. Records have a fixed size so that the index is
+// a header followed by an array of them, and can be searched straight from a mapping.
+struct CatalogRecord {
+	uint64_t hash;              // FNV-1a of the file contents
+	uint32_t image;             // index of the image path
+	uint16_t blocks;
+	uint8_t type;               // directory type byte, without the lock and replace flags
+	uint8_t nameLength;
+	uint8_t petscii[16];        // the name as on disk
+	char ascii[16];             // the name as printed, lowercase, for searching
+};
+
+static_assert(sizeof(CatalogRecord) == 48, "catalog records are written to file as they are");
+
+inline const char CATALOG_MAGIC[8] = {'C', '6', '4', 'C', 'A', 'T', 'L', 'G'};
+inline const uint32_t CATALOG_VERSION = 1;
+
+struct Catalog {
+	std::vector<std::string> images;
+	std::vector<CatalogRecord> records;
+};
+
+// all the .d64 files below a directory, sorted
+std::vector<std::string> findImages(const std::string& directory);
+
+// parses the images on the pool. Images that can't be read are left out and counted in failed.
+Catalog indexImages(const std::vector<std::string>& images, WorkPool& pool, size_t& failed);
+
+bool writeCatalog(const std::string& filename, const Catalog& catalog);
+
+// Maps an index written by writeCatalog.
+class CatalogReader {
+public:
+	explicit CatalogReader(const std::string& filename);
+	~CatalogReader();
+	CatalogReader(const CatalogReader&) = delete;
+	CatalogReader& operator=(const CatalogReader&) = delete;
+	bool isOpen() const;
+	size_t getImageCount() const;
+	size_t getRecordCount() const;
+	const CatalogRecord& getRecord(size_t i) const;
+	std::string getImage(size_t i) const;
+	// the records whose name contains the text, ignoring case
+	std::vector<const CatalogRecord*> find(const std::string& text) const;
+	// the records of files with the given contents
+	std::vector<const CatalogRecord*> findHash(uint64_t hash) const;
+private:
+	const uint8_t* _data;
+	size_t _size;
+	const CatalogRecord* _records;
+	size_t _recordCount;
+	const uint32_t* _imageOffsets;  // into the path strings, one more than the images
+	size_t _imageCount;
+	const char* _paths;
+};
+
+// the name of a directory type byte, "???" for unknown ones
+const char* catalogTypeName(uint8_t type);
+
+inline bool CatalogReader::isOpen() const {
+	return _data != nullptr;
+}
+
+inline size_t CatalogReader::getImageCount() const {
+	return _imageCount;
+}
+
+inline size_t CatalogReader::getRecordCount() const {
+	return _recordCount;
+}
+
+inline const CatalogRecord& CatalogReader::getRecord(size_t i) const {
+	return _records[i];
+}
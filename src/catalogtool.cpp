@@ -0,0 +1,90 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include "catalog.h"
+
+// Indexes the directories of a library of D64 images, and searches the index.
+
+namespace {
+
+	void usage() {
+		std::cerr << "usage: c64-catalog index [--threads n] directory index.cat\n"
+			"       c64-catalog find index.cat text\n"
+			"       c64-catalog find index.cat --hash hash\n";
+	}
+
+	int index(const std::string& directory, const std::string& filename, unsigned threads) {
+		auto start = std::chrono::steady_clock::now();
+		auto images = findImages(directory);
+		WorkPool pool(threads);
+		size_t failed;
+		auto catalog = indexImages(images, pool, failed);
+		if (!writeCatalog(filename, catalog)) {
+			std::cerr << "Can't write file: " << filename << "\n";
+			return 1;
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		std::cerr << catalog.images.size() << " images, " << catalog.records.size() << " files indexed in "
+			<< elapsed.count() << " s on " << pool.getThreads() << " threads";
+		if (failed > 0) {
+			std::cerr << ", " << failed << " images skipped";
+		}
+		std::cerr << "\n";
+		return 0;
+	}
+
+	int find(const std::string& filename, const std::string& text, bool hash) {
+		CatalogReader reader(filename);
+		if (!reader.isOpen()) {
+			std::cerr << "Not a catalog file: " << filename << "\n";
+			return 1;
+		}
+		std::vector<const CatalogRecord*> records;
+		if (hash) {
+			char* end;
+			auto value = std::strtoull(text.c_str(), &end, 16);
+			if (text.empty() || *end != 0) {
+				usage();
+				return 1;
+			}
+			records = reader.findHash(value);
+		} else {
+			records = reader.find(text);
+		}
+		for (const auto* record : records) {
+			std::string name(record->ascii, std::min<size_t>(record->nameLength, 16));
+			std::cout << std::setw(4) << std::setfill(' ') << std::dec << record->blocks << " \""
+				<< name << "\"" << std::string(16 - name.size(), ' ') << " " << catalogTypeName(record->type) << "  "
+				<< std::hex << std::setw(16) << std::setfill('0') << record->hash << "  " << reader.getImage(record->image) << "\n";
+		}
+		return 0;
+	}
+
+}
+
+int main(int argc, char* argv[]) {
+	std::string command(argc > 1 ? argv[1] : "");
+	if (command == "index") {
+		unsigned threads = 0;
+		int i = 2;
+		if (i + 1 < argc && std::string(argv[i]) == "--threads") {
+			threads = static_cast<unsigned>(std::stoul(argv[i + 1]));
+			i += 2;
+		}
+		if (i + 2 == argc) {
+			return index(argv[i], argv[i + 1], threads);
+		}
+	} else if (command == "find") {
+		if (argc == 4) {
+			return find(argv[2], argv[3], false);
+		}
+		if (argc == 5 && std::string(argv[3]) == "--hash") {
+			return find(argv[2], argv[4], true);
+		}
+	}
+	usage();
+	return 1;
+}
@@ -0,0 +1,305 @@
+#include "cia.h"
+#include <cstring>
+#include "snapshot.h"
+
+namespace {
+	// control register bits
+	const uint8_t START = 0x01;
+	const uint8_t ONE_SHOT = 0x08;
+	const uint8_t FORCE_LOAD = 0x10;
+	const uint8_t TOD_50HZ = 0x80;          // control register A
+	const uint8_t WRITE_ALARM = 0x80;       // control register B
+
+	// interrupt flags
+	const uint8_t ICR_TIMER_A = 0x01;
+	const uint8_t ICR_TIMER_B = 0x02;
+	const uint8_t ICR_ALARM = 0x04;
+
+	uint8_t incrementBcd(uint8_t value) {
+		return (value & 0x0F) == 9 ? (value & 0xF0) + 0x10 : value + 1;
+	}
+}
+
+CIA::CIA(Scheduler* scheduler, Event timerA, Event timerB, Event todTick, long todTickCycles) :
+	_scheduler(scheduler), _pra(0), _prb(0), _ddra(0), _ddrb(0), _inputA(0xFF), _inputB(0xFF), _sdr(0),
+	_icrFlags(0), _icrMask(0), _todLatched(false), _todStopped(false), _todDivider(0), _todEvent(todTick),
+	_todTickCycles(todTickCycles) {
+	_timer[TIMER_A] = {0xFFFF, 0xFFFF, 0, 0, timerA};
+	_timer[TIMER_B] = {0xFFFF, 0xFFFF, 0, 0, timerB};
+	// the clock powers up at 1:00:00.0 AM
+	_tod[0] = 0x00;
+	_tod[1] = 0x00;
+	_tod[2] = 0x00;
+	_tod[3] = 0x01;
+	memset(_todAlarm, 0, sizeof(_todAlarm));
+	memset(_todLatch, 0, sizeof(_todLatch));
+	_todNextTick = _todTickCycles;
+	_scheduler->schedule(_todNextTick, _todEvent);
+}
+
+bool CIA::countsCycles(const Timer& timer, TimerId id) const {
+	// timer A counts cycles or CNT transitions, timer B can also count timer A underflows.
+	// Nothing is connected to CNT.
+	uint8_t inputMode = id == TIMER_A ? timer.control & 0x20 : timer.control & 0x60;
+	return (timer.control & START) && inputMode == 0;
+}
+
+uint16_t CIA::value(const Timer& timer, TimerId id, long cycle) const {
+	if (!countsCycles(timer, id)) {
+		return timer.counter;
+	}
+	long elapsed = cycle - timer.base;
+	return elapsed >= timer.counter ? 0 : timer.counter - elapsed;
+}
+
+void CIA::freeze(Timer& timer, TimerId id, long cycle) {
+	timer.counter = value(timer, id, cycle);
+	timer.base = cycle;
+}
+
+void CIA::schedule(Timer& timer, TimerId id) {
+	if (countsCycles(timer, id)) {
+		// a timer underflows on the cycle after it reaches zero
+		_scheduler->schedule(timer.base + timer.counter + 1, timer.event);
+	} else {
+		_scheduler->cancel(timer.event);
+	}
+}
+
+void CIA::reload(Timer& timer, TimerId id) {
+	timer.counter = timer.latch;
+	_icrFlags |= id == TIMER_A ? ICR_TIMER_A : ICR_TIMER_B;
+	if (timer.control & ONE_SHOT) {
+		timer.control &= ~START;
+	}
+}
+
+void CIA::underflow(TimerId id) {
+	Timer& timer = _timer[id];
+	// rebase on the cycle the underflow was due, not the one it is handled at, so periods do not drift
+	timer.base += timer.counter + 1;
+	reload(timer, id);
+	schedule(timer, id);
+	if (id == TIMER_A) {
+		countTimerB();
+	}
+}
+
+void CIA::countTimerB() {
+	Timer& timer = _timer[TIMER_B];
+	if ((timer.control & START) == 0 || (timer.control & 0x40) == 0) {
+		return;
+	}
+	if (timer.counter == 0) {
+		reload(timer, TIMER_B);
+	} else {
+		--timer.counter;
+	}
+}
+
+void CIA::writeControl(TimerId id, uint8_t value, long cycle) {
+	Timer& timer = _timer[id];
+	freeze(timer, id, cycle);
+	if (value & FORCE_LOAD) {
+		timer.counter = timer.latch;
+	}
+	// the load strobe is not stored
+	timer.control = value & ~FORCE_LOAD;
+	schedule(timer, id);
+}
+
+void CIA::todTick() {
+	_todNextTick += _todTickCycles;
+	_scheduler->schedule(_todNextTick, _todEvent);
+	if (_todStopped) {
+		return;
+	}
+	// the power line frequency is divided by 5 or 6 to get tenths of a second
+	if (++_todDivider < ((_timer[TIMER_A].control & TOD_50HZ) ? 5 : 6)) {
+		return;
+	}
+	_todDivider = 0;
+	_tod[0] = (_tod[0] + 1) % 10;
+	if (_tod[0] == 0) {
+		_tod[1] = _tod[1] == 0x59 ? 0 : incrementBcd(_tod[1]);
+		if (_tod[1] == 0) {
+			_tod[2] = _tod[2] == 0x59 ? 0 : incrementBcd(_tod[2]);
+			if (_tod[2] == 0) {
+				// hours go 12, 1 ... 11, and AM/PM flips going from 11 to 12
+				uint8_t pm = _tod[3] & 0x80;
+				uint8_t hours = _tod[3] & 0x1F;
+				if (hours == 0x11) {
+					pm ^= 0x80;
+				}
+				hours = hours == 0x12 ? 0x01 : incrementBcd(hours);
+				_tod[3] = pm | hours;
+			}
+		}
+	}
+	if (memcmp(_tod, _todAlarm, sizeof(_tod)) == 0) {
+		_icrFlags |= ICR_ALARM;
+	}
+}
+
+uint8_t CIA::read(uint8_t reg, long cycle) {
+	switch (reg) {
+		case 0x0:
+			return getPortA();
+		case 0x1:
+			return getPortB();
+		case 0x2:
+			return _ddra;
+		case 0x3:
+			return _ddrb;
+		case 0x4:
+			return value(_timer[TIMER_A], TIMER_A, cycle) & 0xFF;
+		case 0x5:
+			return value(_timer[TIMER_A], TIMER_A, cycle) >> 8;
+		case 0x6:
+			return value(_timer[TIMER_B], TIMER_B, cycle) & 0xFF;
+		case 0x7:
+			return value(_timer[TIMER_B], TIMER_B, cycle) >> 8;
+		case 0x8: {
+			uint8_t tenths = _todLatched ? _todLatch[0] : _tod[0];
+			_todLatched = false;
+			return tenths;
+		}
+		case 0x9:
+		case 0xA:
+			return _todLatched ? _todLatch[reg - 0x8] : _tod[reg - 0x8];
+		case 0xB:
+			if (!_todLatched) {
+				memcpy(_todLatch, _tod, sizeof(_tod));
+				_todLatched = true;
+			}
+			return _todLatch[3];
+		case 0xC:
+			return _sdr;
+		case 0xD: {
+			// reading acknowledges every interrupt
+			uint8_t value = _icrFlags | (irq() ? 0x80 : 0x00);
+			_icrFlags = 0;
+			return value;
+		}
+		case 0xE:
+			return _timer[TIMER_A].control;
+		default:
+			return _timer[TIMER_B].control;
+	}
+}
+
+void CIA::write(uint8_t reg, uint8_t value, long cycle) {
+	switch (reg) {
+		case 0x0:
+			_pra = value;
+			break;
+		case 0x1:
+			_prb = value;
+			break;
+		case 0x2:
+			_ddra = value;
+			break;
+		case 0x3:
+			_ddrb = value;
+			break;
+		case 0x4:
+		case 0x6: {
+			Timer& timer = _timer[reg == 0x4 ? TIMER_A : TIMER_B];
+			timer.latch = (timer.latch & 0xFF00) | value;
+			break;
+		}
+		case 0x5:
+		case 0x7: {
+			TimerId id = reg == 0x5 ? TIMER_A : TIMER_B;
+			Timer& timer = _timer[id];
+			timer.latch = (timer.latch & 0x00FF) | (value << 8);
+			// writing the high byte of a stopped timer loads it
+			if ((timer.control & START) == 0) {
+				timer.counter = timer.latch;
+				timer.base = cycle;
+			}
+			break;
+		}
+		case 0x8:
+		case 0x9:
+		case 0xA:
+		case 0xB: {
+			int index = reg - 0x8;
+			if (index == 0) {
+				value &= 0x0F;
+			} else if (index == 3) {
+				value &= 0x9F;
+			} else {
+				value &= 0x7F;
+			}
+			if (_timer[TIMER_B].control & WRITE_ALARM) {
+				_todAlarm[index] = value;
+			} else {
+				_tod[index] = value;
+				// the clock stops while it is being set, from the hours to the tenths
+				if (index == 3) {
+					_todStopped = true;
+				} else if (index == 0) {
+					_todStopped = false;
+					_todDivider = 0;
+				}
+			}
+			break;
+		}
+		case 0xC:
+			_sdr = value;
+			break;
+		case 0xD:
+			// bit 7 tells whether the other bits set or clear mask bits
+			if (value & 0x80) {
+				_icrMask |= value & 0x1F;
+			} else {
+				_icrMask &= ~value & 0x1F;
+			}
+			break;
+		case 0xE:
+			writeControl(TIMER_A, value, cycle);
+			break;
+		default:
+			writeControl(TIMER_B, value, cycle);
+			break;
+	}
+}
+
+void CIA::save(SnapshotWriter& out) const {
+	for (const auto& timer : _timer) {
+		out.put16(timer.latch);
+		out.put16(timer.counter);
+		out.put64(timer.base);
+		out.put8(timer.control);
+	}
+	for (uint8_t value : {_pra, _prb, _ddra, _ddrb, _inputA, _inputB, _sdr, _icrFlags, _icrMask}) {
+		out.put8(value);
+	}
+	out.putBytes(_tod, sizeof(_tod));
+	out.putBytes(_todAlarm, sizeof(_todAlarm));
+	out.putBytes(_todLatch, sizeof(_todLatch));
+	out.put8(_todLatched);
+	out.put8(_todStopped);
+	out.put32(_todDivider);
+	out.put64(_todNextTick);
+}
+
+void CIA::load(SnapshotReader& in) {
+	for (auto& timer : _timer) {
+		timer.latch = in.get16();
+		timer.counter = in.get16();
+		timer.base = static_cast<long>(in.get64());
+		timer.control = in.get8();
+	}
+	for (uint8_t* value : {&_pra, &_prb, &_ddra, &_ddrb, &_inputA, &_inputB, &_sdr, &_icrFlags, &_icrMask}) {
+		*value = in.get8();
+	}
+	in.getBytes(_tod, sizeof(_tod));
+	in.getBytes(_todAlarm, sizeof(_todAlarm));
+	in.getBytes(_todLatch, sizeof(_todLatch));
+	_todLatched = in.get8();
+	_todStopped = in.get8();
+	_todDivider = static_cast<int>(in.get32());
+	_todNextTick = static_cast<long>(in.get64());
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include "scheduler.h"
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// MOS 6526 Complex Interface Adapter. Timers are not decremented every cycle: a running timer keeps
+// the value it had at a given cycle, reads work the current value out of the cycle delta and the
+// underflow is an event scheduled in advance. The time of day clock advances on power line ticks,
+// which are events too.
+class CIA {
+public:
+	enum TimerId {
+		TIMER_A, TIMER_B
+	};
+	// the chip schedules its timer underflows and power line ticks with the given events;
+	// todTickCycles is the length of a power line cycle in clock cycles
+	CIA(Scheduler* scheduler, Event timerA, Event timerB, Event todTick, long todTickCycles);
+	// registers are mirrored every 16 bytes, reg is the address modulo 16. Reads have side effects
+	// (the interrupt flags clear), so both take the clock cycle of the access.
+	uint8_t read(uint8_t reg, long cycle);
+	void write(uint8_t reg, uint8_t value, long cycle);
+	// event handlers
+	void underflow(TimerId id);
+	void todTick();
+	// state of the IRQ output: CIA 1 drives the IRQ line, CIA 2 the NMI line
+	bool irq() const;
+	// what the port pins show: outputs as programmed, inputs pulled up
+	uint8_t getPortA() const;
+	uint8_t getPortB() const;
+	// levels driven on the port pins by the outside (keyboard, joysticks...), 1 when nothing drives them
+	void setInputA(uint8_t value);
+	void setInputB(uint8_t value);
+	// registers, timers and clock; the events they have pending are saved with the scheduler
+	void save(SnapshotWriter& out) const;
+	void load(SnapshotReader& in);
+private:
+	struct Timer {
+		uint16_t latch;
+		uint16_t counter;           // the value at cycle base, when counting clock cycles
+		long base;
+		uint8_t control;
+		Event event;
+	};
+	bool countsCycles(const Timer& timer, TimerId id) const;
+	uint16_t value(const Timer& timer, TimerId id, long cycle) const;
+	// make the counter current, before the way it counts changes
+	void freeze(Timer& timer, TimerId id, long cycle);
+	void schedule(Timer& timer, TimerId id);
+	void writeControl(TimerId id, uint8_t value, long cycle);
+	// timer B counting the underflows of timer A
+	void countTimerB();
+	void reload(Timer& timer, TimerId id);
+	Scheduler* _scheduler;
+	Timer _timer[2];
+	uint8_t _pra, _prb, _ddra, _ddrb;
+	uint8_t _inputA, _inputB;
+	uint8_t _sdr;
+	uint8_t _icrFlags;
+	uint8_t _icrMask;
+	// time of day, BCD: tenths, seconds, minutes, hours with bit 7 = PM
+	uint8_t _tod[4];
+	uint8_t _todAlarm[4];
+	uint8_t _todLatch[4];
+	bool _todLatched;           // reading the hours freezes the readout until the tenths are read
+	bool _todStopped;           // writing the hours stops the clock until the tenths are written
+	int _todDivider;            // power line ticks since the last tenth
+	Event _todEvent;
+	long _todTickCycles;
+	long _todNextTick;
+};
+
+inline bool CIA::irq() const {
+	return (_icrFlags & _icrMask) != 0;
+}
+
+inline uint8_t CIA::getPortA() const {
+	return (_pra | ~_ddra) & _inputA;
+}
+
+inline uint8_t CIA::getPortB() const {
+	return (_prb | ~_ddrb) & _inputB;
+}
+
+inline void CIA::setInputA(uint8_t value) {
+	_inputA = value;
+}
+
+inline void CIA::setInputB(uint8_t value) {
+	_inputB = value;
+}
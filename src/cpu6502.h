@@ -0,0 +1,1135 @@
+#pragma once
+
+#include <cstdint>
+#include "bcd.h"
+
+enum Flag {
+    CARRY = 0,
+    ZERO = 1,
+    INTERRUPT_DISABLE = 2,
+    DECIMAL_MODE = 3,
+    BREAK = 4,
+    OVERFLOW = 6,
+    NEGATIVE = 7
+};
+
+// The registers and instructions of the 6502, shared by the 6510 of the C64 and the 6502 of the 1541.
+// The machine derives from it and supplies the bus (CRTP), so every memory access is a direct,
+// inlinable call into the machine:
+//   uint8_t readByte(uint16_t address);
+//   void writeByte(uint16_t address, uint8_t value);
+//   uint8_t readModify(uint16_t address);     the read of a read-modify-write instruction
+//   void pollInterrupt(int delay);            the I flag was cleared, delay cycles from now
+// Each machine has its own step, a switch over opcodes.inl, and counts cycles in _clockCycle.
+// Handlers take the bytes after the opcode from _operand: the machine reads them with fetchOperand
+// before calling the handler, or supplies them already decoded.
+template<class Machine>
+class Cpu6502 {
+protected:
+    Cpu6502();
+    // opcodes.inl names the addressing modes through the machine, which may take their address
+    using Self = Machine;
+    Machine& machine();
+    uint8_t readByte(uint16_t address);
+    void writeByte(uint16_t address, uint8_t value);
+    uint8_t readModify(uint16_t address);
+    void pollInterrupt(int delay);
+    uint16_t readVec(uint16_t address);
+    // read the operand of the instruction at _pc, of the given length in bytes with the opcode
+    void fetchOperand(int length);
+    // the status register with N, Z, C and V worked out of the last results, and the reverse
+    uint8_t getStatus() const;
+    void setStatus(uint8_t value);
+    // stack operations
+    void push(uint8_t);
+    void pushVec(uint16_t);
+    uint8_t pop();
+    uint16_t popVec();
+    void setNegFlag(uint8_t);
+    void setZeroFlag(uint8_t);
+    void setCarryFlag(uint16_t);
+    // shifts and rotates of a value, setting C, N and Z
+    uint8_t shiftLeft(uint8_t);
+    uint8_t shiftRight(uint8_t);
+    uint8_t rotateLeft(uint8_t);
+    uint8_t rotateRight(uint8_t);
+    // sets carry, zero and negative flag as a comparison of reg with value
+    void compare(uint8_t reg, uint8_t value);
+    // binary add of value and carry to the accumulator, sets C, V, N and Z
+    void addWithCarry(uint8_t value);
+    // ADC and SBC of value: binary, or decimal when the D flag is set
+    void add(uint8_t value);
+    void subtract(uint8_t value);
+    void branch(bool);
+    void brk();
+    void php();
+    void clc();
+    void bpl();
+    void jsr();
+    void plp();
+    void bmi();
+    void sec();
+    void rti();
+    void pha();
+    void jmp_abs();
+    void jmp_ind();
+    void bvc();
+    void cli();
+    void rts();
+    void pla();
+    void bvs();
+    void sei();
+    void txs();
+    void cld();
+    void bcc();
+    void bcs();
+    void bne();
+    void beq();
+    void clv();
+    void sed();
+    void tax();
+    void tay();
+    void txa();
+    void tya();
+    void tsx();
+    void inx();
+    void iny();
+    void dex();
+    void dey();
+    void nop();
+    void jam();
+    // undocumented stores which and the stored value with the high byte of the base address + 1
+    void sha_aby();
+    void sha_iny();
+    void shx();
+    void shy();
+    void tas();
+    void asl_acc();
+    void lsr_acc();
+    void rol_acc();
+    void ror_acc();
+
+
+
+    template<int length, uint8_t (Cpu6502::*addr)()>
+    void ora() {
+        auto value = (*this.*addr)();
+        _a |= value;
+        // The negative status flag is set if the result is negative, i.e. has its most significant bit set.
+        setNegFlag(_a);
+        // The zero flag is set if the result is zero, or cleared if it is non-zero.
+        setZeroFlag(_a);
+        _pc += length;
+    }
+
+    template<int length, uint8_t (Cpu6502::*addr)()>
+    void _and() {
+        auto value = (*this.*addr)();
+        _a &= value;
+        // The negative status flag is set if the result is negative, i.e. has its most significant bit set.
+        setNegFlag(_a);
+        // The zero flag is set if the result is zero, or cleared if it is non-zero.
+        setZeroFlag(_a);
+        _pc += length;
+    }
+
+    template<int length, uint8_t (Cpu6502::*addr)()>
+    void eor() {
+        auto value = (*this.*addr)();
+        _a ^= value;
+        // The negative status flag is set if the result is negative, i.e. has its most significant bit set.
+        setNegFlag(_a);
+        // The zero flag is set if the result is zero, or cleared if it is non-zero.
+        setZeroFlag(_a);
+        _pc += length;
+    }
+
+    // ADd with Carry
+    template<int length, uint8_t (Cpu6502::*addr)()>
+    void adc() {
+        auto value = (*this.*addr)();
+        add(value);
+        _pc += length;
+    }
+
+    // SuBtract with Carry: in binary mode this is an addition of the one's complement
+    template<int length, uint8_t (Cpu6502::*addr)()>
+    void sbc() {
+        auto value = (*this.*addr)();
+        subtract(value);
+        _pc += length;
+    }
+
+
+    template<int length, uint8_t(Cpu6502::*addr)()>
+    void bit() {
+        auto value = (*this.*addr)();
+        // N and V are bits 7 and 6 of the operand, Z is from the AND with the accumulator
+        setNegFlag(value);
+        _overflow = value & 0x40;
+        setZeroFlag(_a & value);
+        _pc += length;
+    }
+
+    // STore Accumulator
+    template<int length, uint16_t (Cpu6502::*addr)()>
+    void sta() {
+        writeByte((*this.*addr)(), _a);
+        _pc += length;
+    }
+
+    template<int length, uint16_t (Cpu6502::*addr)()>
+    void stx() {
+        writeByte((*this.*addr)(), _x);
+        _pc += length;
+    }
+
+    template<int length, uint16_t (Cpu6502::*addr)()>
+    void sty() {
+        writeByte((*this.*addr)(), _y);
+        _pc += length;
+    }
+
+    // read-modify-write instructions: the memory operand goes through shiftLeft() etc.,
+    // the accumulator versions (asl_acc...) are below
+    // arithmetic shift left
+    template<int length, uint16_t (Cpu6502::*addr)()>
+    void asl() {
+        auto address = (*this.*addr)();
+        writeByte(address, shiftLeft(readModify(address)));
+        _pc += length;
+    }
+
+    // rotate left
+    template<int length, uint16_t (Cpu6502::*addr)()>
+    void rol() {
+        auto address = (*this.*addr)();
+        writeByte(address, rotateLeft(readModify(address)));
+        _pc += length;
+    }
+
+    // rotate right
+    template<int length, uint16_t (Cpu6502::*addr)()>
+    void ror() {
+        auto address = (*this.*addr)();
+        writeByte(address, rotateRight(readModify(address)));
+        _pc += length;
+    }
+
+
+    // logic shift right
+    template<int length, uint16_t (Cpu6502::*addr)()>
+    void lsr() {
+        auto address = (*this.*addr)();
+        writeByte(address, shiftRight(readModify(address)));
+        _pc += length;
+    }
+
+    template<int length, uint16_t (Cpu6502::*addr)()>
+    void inc() {
+        auto address = (*this.*addr)();
+        uint8_t value = readModify(address) + 1;
+        setNegFlag(value);
+        setZeroFlag(value);
+        writeByte(address, value);
+        _pc += length;
+    }
+
+    template<int length, uint16_t (Cpu6502::*addr)()>
+    void dec() {
+        auto address = (*this.*addr)();
+        uint8_t value = readModify(address) - 1;
+        setNegFlag(value);
+        setZeroFlag(value);
+        writeByte(address, value);
+        _pc += length;
+    }
+
+    template<int length, uint8_t (Cpu6502::*addr)()>
+    void ldx() {
+    	auto value = (*this.*addr)();
+    	_x = value;
+    	setNegFlag(_x);
+    	setZeroFlag(_x);
+    	_pc += length;
+    }
+
+    template<int length, uint8_t (Cpu6502::*addr)()>
+    void ldy() {
+    	auto value = (*this.*addr)();
+    	_y = value;
+    	setNegFlag(_y);
+    	setZeroFlag(_y);
+    	_pc += length;
+    }
+
+	template<int length, uint8_t (Cpu6502::*addr)()>
+	void lda() {
+		auto value = (*this.*addr)();
+		_a = value;
+		_pc += length;
+
+		// The negative status flag is set if the result is negative, i.e. has it's most significant bit set.
+		setNegFlag(_a);
+
+		// The zero flag is set if the result is zero, or cleared if it is non-zero.
+		setZeroFlag(_a);
+	}
+
+	template<int length, uint8_t (Cpu6502::*addr)()>
+	void cmp() {
+		auto operand = (*this.*addr)();
+		compare(_a, operand);
+		_pc += length;
+
+	}
+
+	template<int length, uint8_t (Cpu6502::*addr)()>
+	void cpx() {
+		compare(_x, (*this.*addr)());
+		_pc += length;
+	}
+
+	template<int length, uint8_t (Cpu6502::*addr)()>
+	void cpy() {
+		compare(_y, (*this.*addr)());
+		_pc += length;
+	}
+
+	// NOPs with an operand still perform the read
+	template<int length, uint8_t (Cpu6502::*addr)()>
+	void nop() {
+		(*this.*addr)();
+		_pc += length;
+	}
+
+	// undocumented opcodes, see "No More Secrets" (NMOS 6510 Unintended Opcodes)
+
+	// ASL + ORA
+	template<int length, uint16_t (Cpu6502::*addr)()>
+	void slo() {
+		auto address = (*this.*addr)();
+		uint8_t value = shiftLeft(readModify(address));
+		writeByte(address, value);
+		_a |= value;
+		setNegFlag(_a);
+		setZeroFlag(_a);
+		_pc += length;
+	}
+
+	// ROL + AND
+	template<int length, uint16_t (Cpu6502::*addr)()>
+	void rla() {
+		auto address = (*this.*addr)();
+		uint8_t value = rotateLeft(readModify(address));
+		writeByte(address, value);
+		_a &= value;
+		setNegFlag(_a);
+		setZeroFlag(_a);
+		_pc += length;
+	}
+
+	// LSR + EOR
+	template<int length, uint16_t (Cpu6502::*addr)()>
+	void sre() {
+		auto address = (*this.*addr)();
+		uint8_t value = shiftRight(readModify(address));
+		writeByte(address, value);
+		_a ^= value;
+		setNegFlag(_a);
+		setZeroFlag(_a);
+		_pc += length;
+	}
+
+	// ROR + ADC
+	template<int length, uint16_t (Cpu6502::*addr)()>
+	void rra() {
+		auto address = (*this.*addr)();
+		uint8_t value = rotateRight(readModify(address));
+		writeByte(address, value);
+		add(value);
+		_pc += length;
+	}
+
+	// DEC + CMP
+	template<int length, uint16_t (Cpu6502::*addr)()>
+	void dcp() {
+		auto address = (*this.*addr)();
+		uint8_t value = readModify(address) - 1;
+		writeByte(address, value);
+		compare(_a, value);
+		_pc += length;
+	}
+
+	// INC + SBC
+	template<int length, uint16_t (Cpu6502::*addr)()>
+	void isc() {
+		auto address = (*this.*addr)();
+		uint8_t value = readModify(address) + 1;
+		writeByte(address, value);
+		subtract(value);
+		_pc += length;
+	}
+
+	// store A AND X
+	template<int length, uint16_t (Cpu6502::*addr)()>
+	void sax() {
+		writeByte((*this.*addr)(), _a & _x);
+		_pc += length;
+	}
+
+	// LDA + LDX
+	template<int length, uint8_t (Cpu6502::*addr)()>
+	void lax() {
+		_a = _x = (*this.*addr)();
+		setNegFlag(_a);
+		setZeroFlag(_a);
+		_pc += length;
+	}
+
+	// AND, then copy the negative flag into carry
+	template<int length, uint8_t (Cpu6502::*addr)()>
+	void anc() {
+		_a &= (*this.*addr)();
+		setNegFlag(_a);
+		setZeroFlag(_a);
+		_carry = _a >> 7;
+		_pc += length;
+	}
+
+	// AND + LSR A
+	template<int length, uint8_t (Cpu6502::*addr)()>
+	void alr() {
+		_a &= (*this.*addr)();
+		_carry = _a & 0x01;
+		_a >>= 1;
+		setNegFlag(_a);
+		setZeroFlag(_a);
+		_pc += length;
+	}
+
+	// AND + ROR A, with carry and overflow taken from bits 6 and 5 of the result
+	template<int length, uint8_t (Cpu6502::*addr)()>
+	void arr() {
+		_a &= (*this.*addr)();
+		_a = (_a >> 1) | (_carry << 7);
+		setNegFlag(_a);
+		setZeroFlag(_a);
+		_carry = (_a >> 6) & 0x01;
+		_overflow = (_a ^ (_a << 1)) & 0x40;
+		_pc += length;
+	}
+
+	// unstable: A = (A | magic) & X & operand. The magic constant depends on the chip, $EE is the usual value
+	template<int length, uint8_t (Cpu6502::*addr)()>
+	void ane() {
+		_a = (_a | 0xEE) & _x & (*this.*addr)();
+		setNegFlag(_a);
+		setZeroFlag(_a);
+		_pc += length;
+	}
+
+	// unstable: A = X = (A | magic) & operand
+	template<int length, uint8_t (Cpu6502::*addr)()>
+	void lxa() {
+		_a = _x = (_a | 0xEE) & (*this.*addr)();
+		setNegFlag(_a);
+		setZeroFlag(_a);
+		_pc += length;
+	}
+
+	// X = (A & X) - operand, flags as CMP
+	template<int length, uint8_t (Cpu6502::*addr)()>
+	void sbx() {
+		auto value = (*this.*addr)();
+		auto ax = _a & _x;
+		compare(ax, value);
+		_x = ax - value;
+		_pc += length;
+	}
+
+	// A = X = SP = operand & SP
+	template<int length, uint8_t (Cpu6502::*addr)()>
+	void las() {
+		_a = _x = _sp = (*this.*addr)() & _sp;
+		setNegFlag(_a);
+		setZeroFlag(_a);
+		_pc += length;
+	}
+
+
+    // effective address of the operand
+    uint16_t getAddrAbs();
+    uint16_t getAddrAbx();
+    uint16_t getAddrAby();
+    uint16_t getAddrZP();
+    uint16_t getAddrZPx();
+    uint16_t getAddrZPy();
+    uint16_t getAddrInx();
+    uint16_t getAddrIny();
+    uint8_t getOperandImm();
+    uint8_t getOperandAbs();
+    uint8_t getOperandAbx();
+    uint8_t getOperandAby();
+    uint8_t getOperandInx();
+    uint8_t getOperandIny();
+    uint8_t getOperandZP();
+    uint8_t getOperandZPx();
+    uint8_t getOperandZPy();
+    // the 16 bit pointer at a zero page address, wrapping around within the zero page
+    uint16_t readVecZP(uint8_t address);
+    // indexed reads take one more cycle when the index carries into the high byte
+    void pageCrossPenalty(uint16_t base, uint16_t address);
+
+    long _clockCycle;
+    uint16_t _operand;          // of the instruction being executed, the high byte is 0 for one byte operands
+    uint8_t* _stack;            // page 1 of the machine's RAM
+    uint16_t _pc;               // program counter (16 bits)
+    uint8_t _a, _x, _y;
+    uint8_t _sp;
+
+    // Bit  Flag
+    // 0    Carry
+    // 1    Zero
+    // 2    Interrupt disable
+    // 3    Decimal mode
+    // 4    Break
+    // 5    Unused
+    // 6    Overflow
+    // 7    Negative
+    // Only I and D are kept here. N, Z, C and V are set by most instructions and read by few, so
+    // each instruction just stores what they come from, and getStatus() puts them together.
+    uint8_t _status;
+    uint8_t _negative;          // N is bit 7
+    uint8_t _zero;              // Z is set when this is 0
+    uint8_t _carry;             // 0 or 1
+    uint8_t _overflow;          // V is set when this isn't 0
+};
+
+template<class Machine>
+Cpu6502<Machine>::Cpu6502() : _clockCycle(0), _operand(0), _stack(nullptr), _pc(0), _a(0), _x(0), _y(0), _sp(0xFF), _status(0x24),
+	_negative(0), _zero(1), _carry(0), _overflow(0) {
+}
+
+template<class Machine>
+inline Machine& Cpu6502<Machine>::machine() {
+    return static_cast<Machine&>(*this);
+}
+
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::readByte(uint16_t address) {
+    return machine().readByte(address);
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::writeByte(uint16_t address, uint8_t value) {
+    machine().writeByte(address, value);
+}
+
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::readModify(uint16_t address) {
+    return machine().readModify(address);
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::pollInterrupt(int delay) {
+    machine().pollInterrupt(delay);
+}
+
+template<class Machine>
+inline uint16_t Cpu6502<Machine>::readVec(uint16_t address) {
+    return readByte(address) | (readByte(address + 1) << 8);
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::fetchOperand(int length) {
+    if (length == 2) {
+        _operand = readByte(_pc + 1);
+    } else if (length == 3) {
+        _operand = readVec(_pc + 1);
+    }
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::pageCrossPenalty(uint16_t base, uint16_t address) {
+	_clockCycle += ((base ^ address) & 0xFF00) != 0;
+}
+
+// the carry out of an 8 bit sum
+template<class Machine>
+inline void Cpu6502<Machine>::setCarryFlag(uint16_t value) {
+	_carry = value >> 8;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::compare(uint8_t reg, uint8_t value) {
+	_carry = reg >= value;
+	setNegFlag(reg - value);
+	setZeroFlag(reg - value);
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::addWithCarry(uint8_t value) {
+	uint16_t result = _a + value + _carry;
+	setCarryFlag(result);
+	// The overflow flag is set when the most significant bit (here considered the sign bit) is changed by
+	// adding two numbers with the same sign (or subtracting two numbers with opposite signs).
+	_overflow = (_a ^ result) & (value ^ result) & 0x80;
+	_a = result & 0xFF;
+	setNegFlag(_a);
+	setZeroFlag(_a);
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::add(uint8_t value) {
+	if ((_status & 0x08) == 0) {
+		addWithCarry(value);
+		return;
+	}
+	uint16_t entry = decimalTables().adc[(_carry << 16) | (_a << 8) | value];
+	_a = entry & 0xFF;
+	setStatus((_status & 0x3C) | (entry >> 8));
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::subtract(uint8_t value) {
+	if ((_status & 0x08) == 0) {
+		addWithCarry(~value);
+		return;
+	}
+	uint16_t entry = decimalTables().sbc[(_carry << 16) | (_a << 8) | value];
+	_a = entry & 0xFF;
+	setStatus((_status & 0x3C) | (entry >> 8));
+}
+
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::shiftLeft(uint8_t value) {
+	_carry = value >> 7;
+	value <<= 1;
+	setNegFlag(value);
+	setZeroFlag(value);
+	return value;
+}
+
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::shiftRight(uint8_t value) {
+	_carry = value & 0x01;
+	value >>= 1;
+	setNegFlag(value);
+	setZeroFlag(value);
+	return value;
+}
+
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::rotateLeft(uint8_t value) {
+	uint8_t carry = _carry;
+	_carry = value >> 7;
+	value = (value << 1) | carry;
+	setNegFlag(value);
+	setZeroFlag(value);
+	return value;
+}
+
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::rotateRight(uint8_t value) {
+	uint8_t carry = _carry;
+	_carry = value & 0x01;
+	value = (value >> 1) | (carry << 7);
+	setNegFlag(value);
+	setZeroFlag(value);
+	return value;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::asl_acc() {
+	_a = shiftLeft(_a);
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::lsr_acc() {
+	_a = shiftRight(_a);
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::rol_acc() {
+	_a = rotateLeft(_a);
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::ror_acc() {
+	_a = rotateRight(_a);
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::setNegFlag(uint8_t value) {
+    _negative = value;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::setZeroFlag(uint8_t value) {
+    _zero = value;
+}
+
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::getStatus() const {
+    return (_status & 0x3C) | (_negative & 0x80) | (_overflow != 0 ? 0x40 : 0) | (_zero == 0 ? 0x02 : 0) | _carry;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::setStatus(uint8_t value) {
+    _status = value;
+    _negative = value;
+    _zero = ~value & 0x02;
+    _carry = value & 0x01;
+    _overflow = value & 0x40;
+}
+
+
+
+template<class Machine>
+inline void Cpu6502<Machine>::push(uint8_t byte) {
+    _stack[_sp] = byte;
+    _sp--;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::pushVec(uint16_t value) {
+    auto hiByte = static_cast<uint8_t>((value & 0xFF00) >> 8);
+    auto loByte = static_cast<uint8_t>(value & 0x00FF);
+    push(hiByte);
+    push(loByte);
+}
+
+
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::pop() {
+    _sp++;
+    auto byte = _stack[_sp];
+    return byte;
+}
+
+template<class Machine>
+inline uint16_t Cpu6502<Machine>::popVec() {
+    uint16_t loByte = pop();
+    uint16_t hiByte = pop();
+    return (hiByte << 8) | loByte;
+
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::brk() {
+    // the byte after BRK is skipped; the pushed status has the break flag set
+    _pc += 2;
+    pushVec(_pc);
+    push(getStatus() | 0x30);
+    _status |= 0x04;
+    // raise interrupt event
+    _pc = readVec(0xFFFE);
+}
+
+// the break flag only exists on the stack: it is set when the status is pushed by PHP or BRK
+template<class Machine>
+inline void Cpu6502<Machine>::php() {
+    push(getStatus() | 0x30);
+    _pc += 1;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::pha() {
+    push(_a);
+    _pc += 1;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::clc() {
+    _carry = 0;
+    _pc += 1;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::jmp_abs() {
+    _pc = _operand;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::jmp_ind() {
+    // the high byte of the target is fetched without carrying into the page: JMP ($10FF) reads $10FF and $1000
+    uint16_t pointer = _operand;
+    _pc = readByte(pointer) | (readByte((pointer & 0xFF00) | ((pointer + 1) & 0x00FF)) << 8);
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::sec() {
+    _carry = 1;
+    _pc += 1;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::plp() {
+    setStatus((pop() & 0xEF) | 0x20);
+    _pc += 1;
+    pollInterrupt(5);
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::branch(bool value) {
+    if (value) {
+        uint8_t offset = _operand;
+        int8_t signedOffset = offset;
+        uint16_t next = _pc + 2;
+        _pc = next + signedOffset;
+        // a taken branch costs one more cycle, two if it lands in another page
+        _clockCycle += ((next ^ _pc) & 0xFF00) ? 2 : 1;
+    } else {
+        _pc += 2;
+    }
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::bpl() {
+    branch((_negative & 0x80) == 0);
+}
+
+
+template<class Machine>
+inline void Cpu6502<Machine>::bmi() {
+    branch((_negative & 0x80) != 0);
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::bvc() {
+    branch(_overflow == 0);
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::bvs() {
+    branch(_overflow != 0);
+}
+
+// an interrupt pending when CLI or PLP clears the flag is taken after the following instruction
+template<class Machine>
+inline void Cpu6502<Machine>::cli() {
+    _status &= 0xFB;
+    _pc += 1;
+    pollInterrupt(3);
+}
+
+// JSR (short for "Jump to SubRoutine") is the mnemonic for a machine language instruction which calls a subroutine;
+template<class Machine>
+inline void Cpu6502<Machine>::jsr() {
+    uint16_t jmpAddress = _operand;
+    pushVec(_pc + 2);
+    _pc = jmpAddress;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::rti() {
+    setStatus((pop() & 0xEF) | 0x20);
+    _pc = popVec();
+    pollInterrupt(0);
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::rts() {
+    _pc = popVec();
+    _pc += 1;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::pla() {
+    // pull accumulator
+    _a = pop();
+    setNegFlag(_a);
+    setZeroFlag(_a);
+    _pc += 1;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::sei() {
+    _status |= 0x04;
+    _pc ++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::txs() {
+	// TXS (short for "Transfer X to Stack pointer") is the mnemonic for a machine language instruction which transfers
+	// ("copies") the contents of the X index register into the stack pointer.
+	_sp = _x;
+	_pc ++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::cld() {
+	_status &= 0xF7;
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::sed() {
+	_status |= 0x08;
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::clv() {
+	_overflow = 0;
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::bcc() {
+	branch(_carry == 0);
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::bcs() {
+	branch(_carry != 0);
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::bne() {
+	branch(_zero != 0);
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::beq() {
+	branch(_zero == 0);
+}
+
+// register transfers set the negative and zero flag, except TXS
+template<class Machine>
+inline void Cpu6502<Machine>::tax() {
+	_x = _a;
+	setNegFlag(_x);
+	setZeroFlag(_x);
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::tay() {
+	_y = _a;
+	setNegFlag(_y);
+	setZeroFlag(_y);
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::txa() {
+	_a = _x;
+	setNegFlag(_a);
+	setZeroFlag(_a);
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::tya() {
+	_a = _y;
+	setNegFlag(_a);
+	setZeroFlag(_a);
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::tsx() {
+	_x = _sp;
+	setNegFlag(_x);
+	setZeroFlag(_x);
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::inx() {
+	_x++;
+	setNegFlag(_x);
+	setZeroFlag(_x);
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::iny() {
+	_y++;
+	setNegFlag(_y);
+	setZeroFlag(_y);
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::dex() {
+	_x--;
+	setNegFlag(_x);
+	setZeroFlag(_x);
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::dey() {
+	_y--;
+	setNegFlag(_y);
+	setZeroFlag(_y);
+	_pc++;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::nop() {
+	_pc++;
+}
+
+// JAM halts the processor until reset: the program counter never moves past it
+template<class Machine>
+inline void Cpu6502<Machine>::jam() {
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::sha_aby() {
+	uint16_t base = _operand;
+	uint16_t address = base + _y;
+	uint8_t value = _a & _x & ((base >> 8) + 1);
+	// when the index crosses a page the stored value also replaces the high byte of the address
+	if ((base ^ address) & 0xFF00) {
+		address = (value << 8) | (address & 0xFF);
+	}
+	writeByte(address, value);
+	_pc += 3;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::sha_iny() {
+	uint16_t base = readVecZP(_operand);
+	uint16_t address = base + _y;
+	uint8_t value = _a & _x & ((base >> 8) + 1);
+	if ((base ^ address) & 0xFF00) {
+		address = (value << 8) | (address & 0xFF);
+	}
+	writeByte(address, value);
+	_pc += 2;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::shx() {
+	uint16_t base = _operand;
+	uint16_t address = base + _y;
+	uint8_t value = _x & ((base >> 8) + 1);
+	if ((base ^ address) & 0xFF00) {
+		address = (value << 8) | (address & 0xFF);
+	}
+	writeByte(address, value);
+	_pc += 3;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::shy() {
+	uint16_t base = _operand;
+	uint16_t address = base + _x;
+	uint8_t value = _y & ((base >> 8) + 1);
+	if ((base ^ address) & 0xFF00) {
+		address = (value << 8) | (address & 0xFF);
+	}
+	writeByte(address, value);
+	_pc += 3;
+}
+
+template<class Machine>
+inline void Cpu6502<Machine>::tas() {
+	uint16_t base = _operand;
+	uint16_t address = base + _y;
+	_sp = _a & _x;
+	uint8_t value = _sp & ((base >> 8) + 1);
+	if ((base ^ address) & 0xFF00) {
+		address = (value << 8) | (address & 0xFF);
+	}
+	writeByte(address, value);
+	_pc += 3;
+}
+
+template<class Machine>
+inline uint16_t Cpu6502<Machine>::getAddrAbs() {
+    return _operand;
+}
+template<class Machine>
+inline uint16_t Cpu6502<Machine>::getAddrAbx() {
+    return _operand + _x;
+}
+template<class Machine>
+inline uint16_t Cpu6502<Machine>::getAddrAby() {
+    return _operand + _y;
+}
+
+template<class Machine>
+inline uint16_t Cpu6502<Machine>::getAddrZP() {
+    return _operand;
+}
+// indexed zero page addressing never leaves the zero page
+template<class Machine>
+inline uint16_t Cpu6502<Machine>::getAddrZPx() {
+    return (_operand + _x) & 0xFF;
+}
+template<class Machine>
+inline uint16_t Cpu6502<Machine>::getAddrZPy() {
+    return (_operand + _y) & 0xFF;
+}
+
+// ($nn,X): the pointer is read from the zero page at $nn + X
+template<class Machine>
+inline uint16_t Cpu6502<Machine>::getAddrInx() {
+    return readVecZP(_operand + _x);
+}
+// ($nn),Y: Y is added to the pointer read from the zero page at $nn
+template<class Machine>
+inline uint16_t Cpu6502<Machine>::getAddrIny() {
+    return readVecZP(_operand) + _y;
+}
+
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::getOperandImm() {
+    return _operand;
+}
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::getOperandAbs() {
+    return readByte(getAddrAbs());
+}
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::getOperandAbx() {
+    uint16_t base = _operand;
+    uint16_t address = base + _x;
+    pageCrossPenalty(base, address);
+    return readByte(address);
+}
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::getOperandAby() {
+    uint16_t base = _operand;
+    uint16_t address = base + _y;
+    pageCrossPenalty(base, address);
+    return readByte(address);
+}
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::getOperandZP() {
+    return readByte(getAddrZP());
+}
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::getOperandZPx() {
+    return readByte(getAddrZPx());
+}
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::getOperandZPy() {
+    return readByte(getAddrZPy());
+}
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::getOperandInx() {
+    return readByte(getAddrInx());
+}
+template<class Machine>
+inline uint8_t Cpu6502<Machine>::getOperandIny() {
+    uint16_t base = readVecZP(_operand);
+    uint16_t address = base + _y;
+    pageCrossPenalty(base, address);
+    return readByte(address);
+}
+
+template<class Machine>
+inline uint16_t Cpu6502<Machine>::readVecZP(uint8_t address) {
+    return readByte(address) | (readByte((address + 1) & 0xFF) << 8);
+}
@@ -0,0 +1,181 @@
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "d64parse.h"
+
+namespace {
+    // a chain longer than the number of sectors on a disk is a loop
+    const int MAX_SECTORS = 802;
+
+    int sectorsPerTrack(uint8_t track) {
+        if (track <= 17) return 21;
+        if (track <= 24) return 19;
+        if (track <= 30) return 18;
+        return 17;
+    }
+
+    // the image formats: sectors, and their size without and with error codes
+    struct Format {
+        int tracks;
+        size_t sectors;
+    };
+    const Format FORMATS[] = {{35, 683}, {40, 768}};
+}
+
+
+D64Parser::D64Parser() : data(nullptr), size(0), tracks(0), errors(nullptr) {
+
+    FILE_TYPE[0x80] = "DEL";
+    FILE_TYPE[0x81] = "SEQ";
+    FILE_TYPE[0x82] = "PRG";
+    FILE_TYPE[0x83] = "USR";
+    FILE_TYPE[0x84] = "REL";
+}
+
+D64Parser::~D64Parser() {
+    unmap();
+}
+
+void D64Parser::unmap() {
+    if (data != nullptr) {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+    data = nullptr;
+    errors = nullptr;
+    size = 0;
+    tracks = 0;
+}
+
+long D64Parser::sectorOffset(uint8_t track, uint8_t sector) const {
+    if (track < 1 || track > tracks || sector >= sectorsPerTrack(track)) {
+        return -1;
+    }
+    return STARTS[track] + sector * 256;
+}
+
+ByteView D64Parser::getSector(uint8_t track, uint8_t sector) const {
+    long offset = sectorOffset(track, sector);
+    if (offset < 0) {
+        return {nullptr, 0};
+    }
+    return {data + offset, 256};
+}
+
+uint8_t D64Parser::getErrorCode(uint8_t track, uint8_t sector) const {
+    long offset = sectorOffset(track, sector);
+    if (errors == nullptr || offset < 0) {
+        return 1;
+    }
+    return errors[offset / 256];
+}
+
+std::vector<ByteView> D64Parser::getSectors(size_t row_id) const {
+    const auto& entry = entries.at(row_id);
+    std::vector<ByteView> ret;
+    // each sector starts with the track and sector of the next one. The last one has track 0,
+    // and the position of its last byte in place of the sector.
+    uint8_t track = entry.start_track;
+    uint8_t sector = entry.start_sector;
+    for (int count = 0; count < MAX_SECTORS; ++count) {
+        long offset = sectorOffset(track, sector);
+        if (offset < 0) {
+            break;
+        }
+        const uint8_t* block = data + offset;
+        if (block[0] == 0) {
+            if (block[1] >= 2) {
+                ret.push_back({block + 2, static_cast<size_t>(block[1] - 1)});
+            }
+            break;
+        }
+        ret.push_back({block + 2, 254});
+        track = block[0];
+        sector = block[1];
+    }
+    return ret;
+}
+
+std::vector<uint8_t> D64Parser::getData(size_t row_id) const {
+    std::vector<uint8_t> ret;
+    for (const auto& sector : getSectors(row_id)) {
+        ret.insert(ret.end(), sector.begin(), sector.end());
+    }
+    return ret;
+}
+
+bool D64Parser::parse(const std::string &filename) {
+    unmap();
+    entries.clear();
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Can't find file: " << filename << "\n";
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        std::cerr << "Can't read file: " << filename << "\n";
+        return false;
+    }
+    // the size tells the format
+    size_t fileSize = static_cast<size_t>(info.st_size);
+    for (const auto& format : FORMATS) {
+        if (fileSize == format.sectors * 256 || fileSize == format.sectors * 257) {
+            tracks = format.tracks;
+        }
+    }
+    if (tracks == 0) {
+        close(fd);
+        std::cerr << "Not a D64 image: " << filename << "\n";
+        return false;
+    }
+    void* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        tracks = 0;
+        std::cerr << "Can't read file: " << filename << "\n";
+        return false;
+    }
+    data = static_cast<const uint8_t*>(mapping);
+    size = fileSize;
+    size_t sectors = STARTS[tracks] / 256 + sectorsPerTrack(tracks);
+    if (size > sectors * 256) {
+        errors = data + sectors * 256;
+    }
+
+    // the directory is a chain of sectors starting at 18/1, with 8 entries of 32 bytes each
+    uint8_t track = 18;
+    uint8_t sector = 1;
+    for (int count = 0; track != 0 && count < MAX_SECTORS; ++count) {
+        long base_dir = sectorOffset(track, sector);
+        if (base_dir < 0) {
+            break;
+        }
+        for (int i = 0; i < 0x100; i += 0x20) {
+            // a zero file type is an unused entry
+            if (data[base_dir + i + 2] == 0) {
+                continue;
+            }
+            Entry entry;
+            entry.next_track = data[base_dir + i];
+            entry.next_sector = data[base_dir + i + 1];
+            // bits 4-6 of the type are the lock and replace flags
+            entry.file_type = FILE_TYPE[data[base_dir + i + 2] & 0x8F];
+            entry.start_track = data[base_dir + i + 3];
+            entry.start_sector = data[base_dir + i + 4];
+            entry.sector_size = data[base_dir + i + 0x1e] + (data[base_dir + i + 0x1f] * 256);
+            // names are padded with shifted spaces
+            for (int j = 5; j < 0x15 && data[base_dir + i + j] != 0xA0; j++) {
+                entry.pet_name += data[base_dir + i + j];
+            }
+            entry.adress_start = STARTS[entry.start_track % 41] + entry.start_sector * 256;
+            entry.adress_end = entry.adress_start + entry.sector_size * 256;
+            entries.push_back(entry);
+        }
+        track = data[base_dir];
+        sector = data[base_dir + 1];
+    }
+    return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Entry {
+    uint8_t next_track;
+    uint8_t next_sector;
+    std::string file_type;
+    uint8_t start_track;
+    uint8_t start_sector;
+    std::string pet_name;
+    uint16_t sector_size;
+    uint32_t adress_start;
+    uint32_t adress_end;
+};
+
+// bytes inside the mapped image, valid as long as the parser that returned them
+struct ByteView {
+    const uint8_t* data;
+    size_t size;
+    const uint8_t* begin() const { return data; }
+    const uint8_t* end() const { return data + size; }
+};
+
+// Reads D64 disk images: 35 or 40 tracks, optionally followed by one error code per sector.
+// The image is memory mapped read-only, so only the sectors actually looked at are read from disk,
+// and file contents are handed out as views into the mapping.
+class D64Parser {
+
+public:
+    D64Parser();
+    ~D64Parser();
+    D64Parser(const D64Parser&) = delete;
+    D64Parser& operator=(const D64Parser&) = delete;
+    // map the image and read its directory, false (with a message on stderr) if it can't be read
+    bool parse(const std::string& file);
+    const std::vector<Entry>& getEntries() const;
+    int getTracks() const;
+    bool hasErrorInfo() const;
+    // the 256 bytes of a sector, empty if there is no such sector
+    ByteView getSector(uint8_t track, uint8_t sector) const;
+    // the error code recorded for a sector, 1 (no error) when the image has none
+    uint8_t getErrorCode(uint8_t track, uint8_t sector) const;
+    // the data of a file, one view per sector in chain order, without copying.
+    // For a PRG the first two bytes are the load address.
+    std::vector<ByteView> getSectors(size_t row_id) const;
+    // the same, copied into a single buffer
+    std::vector<uint8_t> getData(size_t row_id) const;
+private:
+    // offset of a sector in the image, or -1 if there is no such sector
+    long sectorOffset(uint8_t track, uint8_t sector) const;
+    void unmap();
+    std::string FILE_TYPE[0x100];
+    const uint32_t STARTS[41] = {
+            0,
+            0x00000, 0x01500, 0x02a00, 0x03f00, 0x05400, 0x06900, 0x07e00, 0x09300,
+            0x0a800, 0x0bd00, 0x0d200, 0x0e700, 0x0fc00, 0x11100, 0x12600, 0x13b00,
+            0x15000, 0x16500, 0x17800, 0x18b00, 0x19e00, 0x1b100, 0x1c400, 0x1d700,
+            0x1ea00, 0x1fc00, 0x20e00, 0x22000, 0x23200, 0x24400, 0x25600, 0x26700,
+            0x27800, 0x28900, 0x29a00, 0x2ab00, 0x2bc00, 0x2cd00, 0x2de00, 0x2ef00
+    };
+    std::vector<Entry> entries;
+    const uint8_t* data;        // the mapped image
+    size_t size;
+    int tracks;
+    const uint8_t* errors;      // one code per sector after the last track, or nullptr
+};
+
+inline const std::vector<Entry>& D64Parser::getEntries() const {
+    return entries;
+}
+
+inline int D64Parser::getTracks() const {
+    return tracks;
+}
+
+inline bool D64Parser::hasErrorInfo() const {
+    return errors != nullptr;
+}
@@ -0,0 +1,112 @@
+#include "display.h"
+#include <cstdio>
+// Include GLEW
+#include <GL/glew.h>
+// Include GLFW
+#include <GLFW/glfw3.h>
+#include "shader.h"
+#include "shaders.h"
+
+
+void WindowResizeCallback(GLFWwindow* win, int width, int height) {
+	// notify cameras
+	if (height == 0) height = 1;
+	settings::window_width = width;
+	settings::window_height = height;
+	//glViewport(0, 0, width, height);
+}
+
+Display::Display(Mode mode) : _window(nullptr), _warpKeyDown(false), _mode(mode) {
+	settings::setMode(mode);
+	initializeGL();
+
+	// create the shader
+	_mainShader = std::make_unique<MainShader>(vshader, fshader, _mode);
+	_mainShader->init();
+
+	_blitShader = std::make_unique<BlitShader>(bvshader, bfshader);
+	_blitShader->init();
+}
+
+Display::~Display() {
+	// shaders own GL objects, so they have to go before the context does
+	_mainShader.reset();
+	_blitShader.reset();
+	glfwTerminate();
+}
+
+void Display::present(const uint8_t* frame) {
+	_mainShader->update(frame);
+
+	_blitShader->start();
+
+	_mainShader->draw();
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDisable(GL_DEPTH_TEST); // enable depth testing (is disabled for rendering screen-space quad)
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	glViewport(0, 0, settings::window_width, settings::window_height);
+	_blitShader->draw();
+
+	glfwSwapBuffers(_window);
+	glfwPollEvents();
+}
+
+bool Display::shouldClose() const {
+	return glfwGetKey(_window, GLFW_KEY_ESCAPE) == GLFW_PRESS || glfwWindowShouldClose(_window);
+}
+
+bool Display::warpToggled() {
+	bool down = glfwGetKey(_window, GLFW_KEY_F9) == GLFW_PRESS;
+	bool toggled = down && !_warpKeyDown;
+	_warpKeyDown = down;
+	return toggled;
+}
+
+void Display::setTitle(const std::string& title) {
+	glfwSetWindowTitle(_window, title.c_str());
+}
+
+void Display::initializeGL() {
+	if( !glfwInit() )
+	{
+		fprintf( stderr, "Failed to initialize GLFW\n" );
+		getchar();
+		exit(1);
+	}
+
+
+	glfwWindowHint(GLFW_SAMPLES, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+	// Open a window and create its OpenGL context
+	_window = glfwCreateWindow(settings::visible_width, settings::visible_height, "EM", NULL, NULL);
+
+	if( _window == NULL ){
+		fprintf( stderr, "Failed to open GLFW window. If you have an Intel GPU, they are not 3.3 compatible. Try the 2.1 version of the tutorials.\n" );
+		getchar();
+		glfwTerminate();
+		exit(1);
+	}
+	glfwMakeContextCurrent(_window);
+	// frames are paced by the emulator, not by the monitor refresh
+	glfwSwapInterval(0);
+	// note: we are setting a callback for the frame buffer resize event,
+	// so the dimensions we will get will be in pixels and NOT screen coordinates!
+	glfwSetFramebufferSizeCallback(_window, WindowResizeCallback);
+
+	// Initialize GLEW
+	if (glewInit() != GLEW_OK) {
+		fprintf(stderr, "Failed to initialize GLEW\n");
+		getchar();
+		glfwTerminate();
+		exit(1);
+	}
+
+	// Ensure we can capture the escape key being pressed below
+	glfwSetInputMode(_window, GLFW_STICKY_KEYS, GL_TRUE);
+	WindowResizeCallback(_window, settings::visible_width, settings::visible_height);
+}
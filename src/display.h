@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "settings.h"
+
+struct GLFWwindow;
+class Shader;
+class MainShader;
+
+// The GLFW window and the shaders used to show the VIC-II framebuffer. This is the only
+// part of the emulator that depends on OpenGL; the machine itself lives in the c64core library.
+class Display {
+public:
+	explicit Display(Mode mode);
+	~Display();
+	// upload a frame of palette indices (visible_width x visible_height) and swap buffers
+	void present(const uint8_t* frame);
+	bool shouldClose() const;
+	// true once each time the warp key (F9) is pressed
+	bool warpToggled();
+	void setTitle(const std::string& title);
+private:
+	void initializeGL();
+	GLFWwindow* _window;
+	bool _warpKeyDown;
+	std::unique_ptr<Shader> _blitShader;
+	std::unique_ptr<MainShader> _mainShader;
+	Mode _mode;
+};
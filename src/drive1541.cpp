@@ -0,0 +1,223 @@
+#include "drive1541.h"
+#include <algorithm>
+
+namespace {
+	// VIA 1 port B: the serial bus
+	const uint8_t PB_DATA_IN = 0x01;
+	const uint8_t PB_DATA_OUT = 0x02;
+	const uint8_t PB_CLK_IN = 0x04;
+	const uint8_t PB_CLK_OUT = 0x08;
+	const uint8_t PB_ATNA = 0x10;
+	const uint8_t PB_ATN_IN = 0x80;
+	// VIA 2 port B: the disk
+	const uint8_t PB_STEPPER = 0x03;
+	const uint8_t PB_MOTOR = 0x04;
+	const uint8_t PB_LED = 0x08;
+	const uint8_t PB_WRITABLE = 0x10;
+	const uint8_t PB_NO_SYNC = 0x80;
+}
+
+Drive1541::Drive1541(const std::vector<uint8_t>& rom) : _via1(&_scheduler, Event::VIA1_TIMER_1, Event::VIA1_TIMER_2),
+	_via2(&_scheduler, Event::VIA2_TIMER_1, Event::VIA2_TIMER_2), _rom(rom), _c64Lines(0), _lines(0),
+	_halfTrack(34), _phase(0), _position(0), _motor(false), _nextByte(0) {
+	_rom.resize(0x4000);
+	std::fill(std::begin(_ram), std::end(_ram), 0);
+	_stack = &_ram[0x0100];
+	// the device number jumpers are closed: device 8
+	updateBus();
+	_via2.setInputB(PB_WRITABLE | PB_NO_SYNC);
+	_pc = readVec(0xFFFC);
+}
+
+void Drive1541::insert(std::unique_ptr<GcrDisk> disk) {
+	_disk = std::move(disk);
+	_position = 0;
+}
+
+void Drive1541::setBus(uint8_t lines) {
+	_c64Lines = lines;
+	updateBus();
+}
+
+void Drive1541::updateBus() {
+	uint8_t out = _via1.getOutputB();
+	uint8_t lines = (out & PB_DATA_OUT ? IEC_DATA : 0) | (out & PB_CLK_OUT ? IEC_CLK : 0) | (out & PB_ATNA ? IEC_ATNA : 0);
+	if (lines != _lines) {
+		_lines = lines;
+		_busChanges.push_back({_clockCycle, lines});
+	}
+	// the inputs see the lines through inverters
+	uint8_t low = iecLines(_c64Lines, _lines);
+	_via1.setInputB((low & IEC_DATA ? PB_DATA_IN : 0) | (low & IEC_CLK ? PB_CLK_IN : 0) | (low & IEC_ATN ? PB_ATN_IN : 0));
+	_via1.setCA1((low & IEC_ATN) != 0);
+	pollInterrupt(0);
+}
+
+void Drive1541::updateMechanics() {
+	uint8_t out = _via2.getOutputB();
+	// the head moves half a track each time the stepper phase goes one up or one down
+	uint8_t phase = out & PB_STEPPER;
+	int halfTrack = _halfTrack;
+	if (((phase - _phase) & 0x03) == 1) {
+		halfTrack = std::min(halfTrack + 1, GcrDisk::HALF_TRACKS - 1);
+	} else if (((phase - _phase) & 0x03) == 3) {
+		halfTrack = std::max(halfTrack - 1, 0);
+	}
+	_phase = phase;
+	if (halfTrack != _halfTrack && _disk) {
+		// the disk keeps turning: the head lands at the same angle on the new track
+		auto from = _disk->getTrack(_halfTrack).size();
+		auto to = _disk->getTrack(halfTrack).size();
+		_position = from && to ? _position * to / from : 0;
+	}
+	_halfTrack = halfTrack;
+	bool motor = (out & PB_MOTOR) != 0;
+	if (motor && !_motor) {
+		_nextByte = _clockCycle + byteCycles();
+		_scheduler.schedule(_nextByte, Event::DISK_BYTE);
+	} else if (!motor) {
+		_scheduler.cancel(Event::DISK_BYTE);
+	}
+	_motor = motor;
+}
+
+int Drive1541::byteCycles() const {
+	// the DOS selects the bit rate of the track with PB5-6
+	return 32 - 2 * ((_via2.getOutputB() >> 5) & 0x03);
+}
+
+bool Drive1541::isLedOn() const {
+	return (_via2.getOutputB() & PB_LED) != 0;
+}
+
+void Drive1541::diskByte() {
+	// counted from when the byte was due, the instruction it waited for doesn't delay the next one
+	_nextByte += byteCycles();
+	_scheduler.schedule(_nextByte, Event::DISK_BYTE);
+	if (!_disk || _disk->getTrack(_halfTrack).empty()) {
+		// no flux changes, no data and no sync
+		_via2.setInputB(PB_WRITABLE | PB_NO_SYNC);
+		return;
+	}
+	auto& track = _disk->getTrack(_halfTrack);
+	_position = (_position + 1) % track.size();
+	if (_via2.getCB2()) {
+		// reading: ten or more one bits in a row are a sync mark, which produces no byte
+		uint8_t byte = track[_position];
+		bool sync = byte == 0xFF && track[(_position + track.size() - 1) % track.size()] == 0xFF;
+		_via2.setInputB(PB_WRITABLE | (sync ? 0 : PB_NO_SYNC));
+		if (sync) {
+			return;
+		}
+		_via2.setInputA(byte);
+	} else {
+		// writing, with CB2 low: the byte in port A goes to the disk
+		track[_position] = _via2.getPortA();
+		_via2.setInputB(PB_WRITABLE | PB_NO_SYNC);
+	}
+	// byte ready, on CA1 and, when CA2 enables it, on the SO pin of the CPU
+	_via2.pulseCA1();
+	if (_via2.getCA2()) {
+		_overflow = 0x40;
+	}
+	pollInterrupt(0);
+}
+
+uint8_t Drive1541::peek(uint16_t address) const {
+	if (address >= 0x8000) {
+		return _rom[address & 0x3FFF];
+	}
+	return _ram[address & 0x7FF];
+}
+
+uint8_t Drive1541::readIO(uint16_t address) {
+	address &= 0x1FFF;
+	if (address < 0x1800) {
+		return _ram[address & 0x7FF];
+	}
+	if (address < 0x1C00) {
+		return _via1.read(address & 0x0F, _clockCycle);
+	}
+	return _via2.read(address & 0x0F, _clockCycle);
+}
+
+void Drive1541::writeIO(uint16_t address, uint8_t value) {
+	address &= 0x1FFF;
+	if (address < 0x1800) {
+		_ram[address & 0x7FF] = value;
+	} else if (address < 0x1C00) {
+		_via1.write(address & 0x0F, value, _clockCycle);
+		updateBus();
+	} else {
+		_via2.write(address & 0x0F, value, _clockCycle);
+		updateMechanics();
+		pollInterrupt(0);
+	}
+}
+
+void Drive1541::pollInterrupt(int delay) {
+	if ((_via1.irq() || _via2.irq()) && (_status & 0x04) == 0) {
+		_scheduler.schedule(_clockCycle + delay, Event::INTERRUPT);
+	}
+}
+
+void Drive1541::interrupt(uint16_t vector) {
+	pushVec(_pc);
+	push((getStatus() & 0xEF) | 0x20);
+	_status |= 0x04;
+	_pc = readVec(vector);
+	_clockCycle += 7;
+}
+
+int Drive1541::step() {
+	switch (readByte(_pc)) {
+#define OPCODE(code, text, mode, bytes, cycles, ...) case code: fetchOperand(bytes); __VA_ARGS__(); return cycles;
+#include "opcodes.inl"
+#undef OPCODE
+	}
+	return 2;
+}
+
+void Drive1541::runUntil(long cycle) {
+	while (_clockCycle < cycle) {
+		// events scheduled by an instruction move next() closer
+		while (_clockCycle < cycle && _clockCycle < _scheduler.next()) {
+			_clockCycle += step();
+		}
+		dispatchEvents();
+	}
+}
+
+void Drive1541::dispatchEvents() {
+	Event event;
+	while (_scheduler.pop(_clockCycle, event)) {
+		switch (event) {
+			case Event::INTERRUPT:
+				if ((_via1.irq() || _via2.irq()) && (_status & 0x04) == 0) {
+					interrupt(0xFFFE);
+				}
+				break;
+			case Event::VIA1_TIMER_1:
+				_via1.underflow(VIA::TIMER_1);
+				pollInterrupt(0);
+				break;
+			case Event::VIA1_TIMER_2:
+				_via1.underflow(VIA::TIMER_2);
+				pollInterrupt(0);
+				break;
+			case Event::VIA2_TIMER_1:
+				_via2.underflow(VIA::TIMER_1);
+				pollInterrupt(0);
+				break;
+			case Event::VIA2_TIMER_2:
+				_via2.underflow(VIA::TIMER_2);
+				pollInterrupt(0);
+				break;
+			case Event::DISK_BYTE:
+				diskByte();
+				break;
+			default:
+				break;
+		}
+	}
+}
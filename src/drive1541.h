@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "cpu6502.h"
+#include "scheduler.h"
+#include "via.h"
+#include "gcrdisk.h"
+
+// lines of the serial bus, as bits of what one side pulls low
+enum IecLine : uint8_t {
+	IEC_ATN = 0x01,
+	IEC_CLK = 0x02,
+	IEC_DATA = 0x04,
+	// not a line: the drive's ATN acknowledge, DATA is pulled while it differs from ATN
+	IEC_ATNA = 0x08
+};
+
+// the lines that are low, given what the C64 and the drive pull
+inline uint8_t iecLines(uint8_t c64, uint8_t drive) {
+	bool atn = c64 & IEC_ATN;
+	bool ack = atn != ((drive & IEC_ATNA) != 0);
+	return (c64 | (drive & (IEC_CLK | IEC_DATA)) | (ack ? IEC_DATA : 0)) & (IEC_ATN | IEC_CLK | IEC_DATA);
+}
+
+// The 1541 disk drive: a 6502 at 1 MHz with 2 KB of RAM and the DOS in 16 KB of ROM, VIA 1 on the serial
+// bus and VIA 2 driving the disk mechanics. The disk is a ring of GCR bytes per track that passes under
+// the head at the bit rate the DOS selects; each byte sets the V flag through the SO pin, which is how
+// the DOS waits for them. The drive runs on its own clock and scheduler, see DriveThread.
+class Drive1541 : public Cpu6502<Drive1541> {
+public:
+	struct BusChange {
+		long cycle;
+		uint8_t lines;              // IecLine bits the drive pulls from this cycle on
+	};
+	explicit Drive1541(const std::vector<uint8_t>& rom);
+	void insert(std::unique_ptr<GcrDisk> disk);
+	// the lines the C64 pulls changed
+	void setBus(uint8_t lines);
+	// IecLine bits: the lines the drive pulls, and its ATN acknowledge
+	uint8_t getBus() const;
+	// changes of getBus() made by the drive since the last clearBusChanges()
+	const std::vector<BusChange>& getBusChanges() const;
+	void clearBusChanges();
+	// execute instructions as long as they start before the given cycle
+	[[gnu::flatten]] void runUntil(long cycle);
+	long getClockCycle() const;
+	uint8_t peek(uint16_t address) const;
+	int getHalfTrack() const;
+	bool isLedOn() const;
+private:
+	friend class Cpu6502<Drive1541>;
+	// the bus the CPU sees
+	uint8_t readByte(uint16_t address);
+	void writeByte(uint16_t address, uint8_t value);
+	uint8_t readModify(uint16_t address);
+	void pollInterrupt(int delay);
+	__attribute__((noinline)) uint8_t readIO(uint16_t address);
+	__attribute__((noinline)) void writeIO(uint16_t address, uint8_t value);
+	int step();
+	__attribute__((noinline)) void dispatchEvents();
+	void interrupt(uint16_t vector);
+	// react to the port outputs of the VIAs
+	void updateBus();
+	void updateMechanics();
+	void diskByte();
+	// 26 to 32 cycles for a byte to pass under the head
+	int byteCycles() const;
+	Scheduler _scheduler;
+	VIA _via1;
+	VIA _via2;
+	uint8_t _ram[0x800];
+	std::vector<uint8_t> _rom;
+	std::unique_ptr<GcrDisk> _disk;
+	uint8_t _c64Lines;          // IecLine bits pulled by the C64
+	uint8_t _lines;             // IecLine bits pulled by the drive, and ATNA
+	std::vector<BusChange> _busChanges;
+	int _halfTrack;             // 0 is track 1
+	uint8_t _phase;             // of the stepper motor, the head moves when it steps by one
+	size_t _position;           // of the head in the track, in bytes
+	bool _motor;
+	long _nextByte;             // when the next byte is under the head
+};
+
+inline long Drive1541::getClockCycle() const {
+	return _clockCycle;
+}
+
+inline uint8_t Drive1541::getBus() const {
+	return _lines;
+}
+
+inline const std::vector<Drive1541::BusChange>& Drive1541::getBusChanges() const {
+	return _busChanges;
+}
+
+inline void Drive1541::clearBusChanges() {
+	_busChanges.clear();
+}
+
+inline int Drive1541::getHalfTrack() const {
+	return _halfTrack;
+}
+
+inline uint8_t Drive1541::readByte(uint16_t address) {
+	// RAM is mirrored up to $17FF, the ROM from $8000
+	if (address < 0x1800) {
+		return _ram[address & 0x7FF];
+	}
+	if (address >= 0x8000) {
+		return _rom[address & 0x3FFF];
+	}
+	return readIO(address);
+}
+
+inline void Drive1541::writeByte(uint16_t address, uint8_t value) {
+	if (address < 0x1800) {
+		_ram[address & 0x7FF] = value;
+	} else if (address < 0x8000) {
+		writeIO(address, value);
+	}
+}
+
+inline uint8_t Drive1541::readModify(uint16_t address) {
+	uint8_t value = readByte(address);
+	// like the 6510, the unmodified value is written back first
+	if (address >= 0x1800 && address < 0x8000) {
+		writeIO(address, value);
+	}
+	return value;
+}
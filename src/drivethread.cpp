@@ -0,0 +1,149 @@
+#include "drivethread.h"
+#include <algorithm>
+
+namespace {
+	const double DRIVE_CLOCK = 1000000.0;
+	const int SPIN_YIELDS = 256;
+}
+
+DriveThread::DriveThread(const std::vector<uint8_t>& rom, double clockFrequency, long startCycle) : _drive(rom),
+	_ratio(DRIVE_CLOCK / clockFrequency), _startCycle(startCycle), _published(0), _driveLines(0), _writes(CAPACITY),
+	_writeHead(0), _writeTail(0), _changes(CAPACITY), _changeHead(0), _changeTail(0), _horizon(0), _driveCycle(0),
+	_idle(false), _stop(false) {
+	start();
+}
+
+DriveThread::~DriveThread() {
+	stop();
+}
+
+void DriveThread::start() {
+	_stop.store(false);
+	_thread = std::thread(&DriveThread::loop, this);
+}
+
+void DriveThread::stop() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop.store(true);
+	}
+	_wake.notify_one();
+	_thread.join();
+}
+
+void DriveThread::insert(std::unique_ptr<GcrDisk> disk) {
+	stop();
+	_drive.insert(std::move(disk));
+	start();
+}
+
+long DriveThread::toDrive(long cycle) const {
+	return static_cast<long>((cycle - _startCycle) * _ratio);
+}
+
+void DriveThread::advance(long driveCycle) {
+	if (driveCycle <= _published) {
+		return;
+	}
+	_published = driveCycle;
+	// sequentially consistent, paired with the store to _idle in loop(), as in SidThread
+	_horizon.store(driveCycle);
+	if (_idle.load()) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_wake.notify_one();
+	}
+}
+
+void DriveThread::drain(long driveCycle) {
+	auto tail = _changeTail.load(std::memory_order_relaxed);
+	auto head = _changeHead.load(std::memory_order_acquire);
+	while (tail != head && _changes[tail & (CAPACITY - 1)].cycle < driveCycle) {
+		_driveLines = _changes[tail & (CAPACITY - 1)].lines;
+		++tail;
+	}
+	_changeTail.store(tail, std::memory_order_release);
+}
+
+void DriveThread::write(long cycle, uint8_t lines) {
+	long driveCycle = toDrive(cycle);
+	auto head = _writeHead.load(std::memory_order_relaxed);
+	while (head - _writeTail.load(std::memory_order_acquire) == CAPACITY) {
+		// the drive consumes the writes up to the horizon, and may itself wait for its changes to be taken
+		advance(driveCycle);
+		drain(driveCycle);
+		std::this_thread::yield();
+	}
+	_writes[head & (CAPACITY - 1)] = {driveCycle, lines};
+	_writeHead.store(head + 1);
+	advance(driveCycle);
+	if (_idle.load()) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_wake.notify_one();
+	}
+}
+
+uint8_t DriveThread::read(long cycle) {
+	long driveCycle = toDrive(cycle);
+	advance(driveCycle);
+	while (_driveCycle.load(std::memory_order_acquire) < driveCycle) {
+		drain(driveCycle);
+		std::this_thread::yield();
+	}
+	drain(driveCycle);
+	return _driveLines;
+}
+
+void DriveThread::sync(long cycle) {
+	long driveCycle = toDrive(cycle);
+	advance(driveCycle);
+	drain(driveCycle);
+}
+
+void DriveThread::loop() {
+	while (true) {
+		long horizon = _horizon.load(std::memory_order_acquire);
+		// apply the C64's changes that are due: their cycle has been reached, or passed by the
+		// instruction that was running when the change happened
+		auto tail = _writeTail.load(std::memory_order_relaxed);
+		auto head = _writeHead.load(std::memory_order_acquire);
+		while (tail != head && _writes[tail & (CAPACITY - 1)].cycle <= _drive.getClockCycle()) {
+			_drive.setBus(_writes[tail & (CAPACITY - 1)].lines);
+			++tail;
+		}
+		_writeTail.store(tail, std::memory_order_release);
+		long target = tail != head ? std::min(horizon, _writes[tail & (CAPACITY - 1)].cycle) : horizon;
+		if (_drive.getClockCycle() < target) {
+			_drive.runUntil(target);
+		}
+		// hand the drive's own changes over before announcing the cycle reached
+		for (const auto& change : _drive.getBusChanges()) {
+			auto changeHead = _changeHead.load(std::memory_order_relaxed);
+			while (changeHead - _changeTail.load(std::memory_order_acquire) == CAPACITY) {
+				std::this_thread::yield();
+			}
+			_changes[changeHead & (CAPACITY - 1)] = {change.cycle, change.lines};
+			_changeHead.store(changeHead + 1, std::memory_order_release);
+		}
+		_drive.clearBusChanges();
+		_driveCycle.store(_drive.getClockCycle(), std::memory_order_release);
+		if (_drive.getClockCycle() < horizon) {
+			continue;
+		}
+		// caught up with the C64: when it polls the bus it comes back within a few yields, otherwise
+		// sleep until it publishes more, or pushes a change
+		for (int i = 0; i < SPIN_YIELDS && _horizon.load(std::memory_order_acquire) == horizon &&
+			_writeHead.load(std::memory_order_acquire) == tail; ++i) {
+			std::this_thread::yield();
+		}
+		if (_horizon.load(std::memory_order_acquire) != horizon || _writeHead.load(std::memory_order_acquire) != tail) {
+			continue;
+		}
+		_idle.store(true);
+		std::unique_lock<std::mutex> lock(_mutex);
+		_wake.wait(lock, [&] { return _stop.load() || _horizon.load() != horizon || _writeHead.load() != tail; });
+		_idle.store(false);
+		if (_stop.load()) {
+			break;
+		}
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "drive1541.h"
+
+// Runs the 1541 on its own thread, behind the C64. The C64 thread pushes the changes of the bus lines
+// it pulls into a lock-free single-producer/single-consumer ring, stamped with the cycle they happen at,
+// and publishes how far it has got: every change before that cycle is in the ring. The drive runs up to
+// there and pushes the changes of its own lines back through a second ring. Since the drive never runs
+// past what the C64 has committed to, nothing is rolled back or guessed; when the C64 reads the bus it
+// waits for the drive to reach the cycle of the read, and sees what it would see running both on one
+// thread, at instruction granularity. The C64 syncs at least every SYNC_CYCLES, which bounds how far
+// the drive can fall behind and so how long a read may wait.
+class DriveThread {
+public:
+	static constexpr long SYNC_CYCLES = 1000;
+	// drive cycle 0 is the C64 cycle startCycle, the two clocks run at their own frequencies
+	DriveThread(const std::vector<uint8_t>& rom, double clockFrequency, long startCycle);
+	~DriveThread();
+	// swaps the disk with the drive thread stopped
+	void insert(std::unique_ptr<GcrDisk> disk);
+	// the IecLine bits the C64 pulls changed at the given cycle
+	void write(long cycle, uint8_t lines);
+	// the IecLine bits the drive pulls at the given cycle, waits for the drive to get there
+	uint8_t read(long cycle);
+	// let the drive run up to the given cycle
+	void sync(long cycle);
+private:
+	struct Entry {
+		long cycle;                 // drive clock
+		uint8_t lines;
+	};
+	static constexpr size_t CAPACITY = 1 << 12;
+	void start();
+	void stop();
+	void loop();
+	long toDrive(long cycle) const;
+	// publish the horizon, waking the drive thread if it sleeps
+	void advance(long driveCycle);
+	// take the drive's changes before the given cycle
+	void drain(long driveCycle);
+	Drive1541 _drive;
+	double _ratio;              // drive cycles per C64 cycle
+	long _startCycle;
+	long _published;            // last horizon, C64 thread
+	uint8_t _driveLines;        // the drive's lines as of the last drain, C64 thread
+	std::vector<Entry> _writes;
+	alignas(64) std::atomic<size_t> _writeHead;     // next slot written by the C64 thread
+	alignas(64) std::atomic<size_t> _writeTail;     // next slot read by the drive thread
+	std::vector<Entry> _changes;
+	alignas(64) std::atomic<size_t> _changeHead;    // next slot written by the drive thread
+	alignas(64) std::atomic<size_t> _changeTail;    // next slot read by the C64 thread
+	alignas(64) std::atomic<long> _horizon;         // every C64 change before it has been pushed
+	alignas(64) std::atomic<long> _driveCycle;      // the drive has executed everything before it
+	// the drive thread sleeps on the condition variable when it has reached the horizon
+	std::atomic<bool> _idle;
+	std::atomic<bool> _stop;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::thread _thread;
+};
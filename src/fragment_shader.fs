@@ -1,17 +1,18 @@
 R"(
 #version 330 core
 
-in float color;
-
 out vec4 FragColor;
 
+// palette indices, row 0 is the top of the screen
+uniform usampler2D frame;
 uniform sampler2D palette;
+uniform int height;
 
 void main()
 {
-    //FragColor = vec4(1, 0, 0, 1);// texture(palette, float(color));
-    FragColor = texture(palette, vec2(color, 0));
-
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    uint index = texelFetch(frame, ivec2(pixel.x, height - 1 - pixel.y), 0).r & 15u;
+    FragColor = texelFetch(palette, ivec2(int(index), 0), 0);
 }
 
-)"
\ No newline at end of file
+)"
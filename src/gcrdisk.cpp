@@ -0,0 +1,103 @@
+#include "gcrdisk.h"
+
+namespace {
+	// the 5 bit code of each nibble: never more than two zeros in a row, so the drive can keep
+	// its clock in sync, and never ten ones, which would read as a sync mark
+	const uint8_t GCR[16] = {
+		0x0A, 0x0B, 0x12, 0x13, 0x0E, 0x0F, 0x16, 0x17, 0x09, 0x19, 0x1A, 0x1B, 0x0D, 0x1D, 0x1E, 0x15
+	};
+	// one revolution at the bit rate of each speed zone
+	const int TRACK_BYTES[4] = {6250, 6666, 7142, 7692};
+	const int SYNC_BYTES = 5;
+	const int HEADER_GAP = 9;
+
+	// error codes of the image error info
+	const uint8_t HEADER_NOT_FOUND = 20;
+	const uint8_t NO_SYNC = 21;
+	const uint8_t DATA_NOT_FOUND = 22;
+	const uint8_t DATA_CHECKSUM = 23;
+	const uint8_t HEADER_CHECKSUM = 27;
+	const uint8_t ID_MISMATCH = 29;
+
+	int sectorsPerTrack(int track) {
+		if (track <= 17) return 21;
+		if (track <= 24) return 19;
+		if (track <= 30) return 18;
+		return 17;
+	}
+
+	// 4 bytes become 5
+	void encode(const uint8_t* bytes, size_t count, std::vector<uint8_t>& out) {
+		for (size_t i = 0; i < count; i += 4) {
+			uint64_t bits = 0;
+			for (size_t j = 0; j < 4; ++j) {
+				bits = (bits << 10) | (GCR[bytes[i + j] >> 4] << 5) | GCR[bytes[i + j] & 0x0F];
+			}
+			for (int j = 4; j >= 0; --j) {
+				out.push_back(static_cast<uint8_t>(bits >> (8 * j)));
+			}
+		}
+	}
+}
+
+GcrDisk::GcrDisk(const D64Parser& image) {
+	// the disk ID is in the BAM
+	auto bam = image.getSector(18, 0);
+	uint8_t id1 = bam.size ? bam.data[0xA2] : 0x30;
+	uint8_t id2 = bam.size ? bam.data[0xA3] : 0x30;
+	for (int track = 1; track <= image.getTracks(); ++track) {
+		encodeTrack(image, track, id1, id2);
+	}
+}
+
+int GcrDisk::speedZone(int track) {
+	if (track <= 17) return 3;
+	if (track <= 24) return 2;
+	if (track <= 30) return 1;
+	return 0;
+}
+
+void GcrDisk::encodeTrack(const D64Parser& image, int track, uint8_t id1, uint8_t id2) {
+	auto& out = _tracks[2 * (track - 1)];
+	int length = TRACK_BYTES[speedZone(track)];
+	int sectors = sectorsPerTrack(track);
+	// what is left of the revolution is split between the gaps after each data block
+	int gap = (length - sectors * (2 * SYNC_BYTES + 10 + HEADER_GAP + 325)) / sectors;
+	for (int sector = 0; sector < sectors; ++sector) {
+		uint8_t error = image.getErrorCode(track, sector);
+		if (error == NO_SYNC) {
+			// an unformatted track
+			out.assign(length, 0x55);
+			return;
+		}
+		uint8_t header[8] = {0x08, 0, static_cast<uint8_t>(sector), static_cast<uint8_t>(track), id2, id1, 0x0F, 0x0F};
+		if (error == ID_MISMATCH) {
+			header[4] ^= 0xFF;
+		}
+		header[1] = header[2] ^ header[3] ^ header[4] ^ header[5];
+		if (error == HEADER_NOT_FOUND) {
+			header[0] = 0x00;
+		} else if (error == HEADER_CHECKSUM) {
+			header[1] ^= 0xFF;
+		}
+		out.insert(out.end(), SYNC_BYTES, 0xFF);
+		encode(header, sizeof(header), out);
+		out.insert(out.end(), HEADER_GAP, 0x55);
+
+		uint8_t data[260] = {0x07};
+		auto bytes = image.getSector(track, sector);
+		uint8_t checksum = 0;
+		for (size_t i = 0; i < bytes.size; ++i) {
+			data[i + 1] = bytes.data[i];
+			checksum ^= bytes.data[i];
+		}
+		data[257] = error == DATA_CHECKSUM ? checksum ^ 0xFF : checksum;
+		if (error == DATA_NOT_FOUND) {
+			data[0] = 0x00;
+		}
+		out.insert(out.end(), SYNC_BYTES, 0xFF);
+		encode(data, sizeof(data), out);
+		out.insert(out.end(), gap, 0x55);
+	}
+	out.resize(length, 0x55);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "d64parse.h"
+
+// A disk as the read/write head of the 1541 sees it: one revolution of GCR encoded bytes per half
+// track. Only the even half tracks, the real tracks, hold data. Writes by the drive change the
+// bytes here, they are not written back to the image.
+class GcrDisk {
+public:
+	static constexpr int HALF_TRACKS = 84;
+	// encode every sector of the image. The error codes of images that have them are reproduced the
+	// way the drive would meet them: no sync, no header or data block, bad checksums or disk ID.
+	explicit GcrDisk(const D64Parser& image);
+	// empty between tracks and past the last track
+	std::vector<uint8_t>& getTrack(int halfTrack);
+	// the bit rate the DOS selects for a track: 3 for the outer tracks, which have the most sectors
+	static int speedZone(int track);
+private:
+	void encodeTrack(const D64Parser& image, int track, uint8_t id1, uint8_t id2);
+	std::vector<uint8_t> _tracks[HALF_TRACKS];
+};
+
+inline std::vector<uint8_t>& GcrDisk::getTrack(int halfTrack) {
+	return _tracks[halfTrack];
+}
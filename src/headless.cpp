@@ -0,0 +1,238 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include "c64.h"
+#include "pacer.h"
+#include "autostart.h"
+#include "screenshot.h"
+
+// Runs the emulator without a window: the VIC-II only renders into the in-memory framebuffer,
+// which can be saved as a PPM image at the end of the run.
+
+namespace {
+
+	void usage() {
+		std::cerr << "usage: c64-headless [--ntsc] [--frames n] [--screenshot file.ppm] [--trace file] [--wav file.wav] [--sid 6581|8580]\n"
+			"                    [--rate hz] [--autostart file.prg|file.d64] [--true-drive] [--realtime]\n"
+			"                    [--load-snapshot file] [--save-snapshot file] [--roms directory] [--jit] [--check-jit]\n"
+			"                    [--bench-cpu] [--bench-sid]\n";
+	}
+
+	// A CPU-bound loop mixing loads, stores, arithmetic and branches, placed at $0800:
+	// 0800 LDX #$00; 0802 LDA $0900,X; ADC #$01; STA $0900,X; EOR $10; STA $10; INX; BNE $0802; INC $11; JMP $0800
+	const uint8_t BENCH_PROGRAM[] = {
+		0xA2, 0x00, 0xBD, 0x00, 0x09, 0x69, 0x01, 0x9D, 0x00, 0x09, 0x45, 0x10, 0x85, 0x10,
+		0xE8, 0xD0, 0xF1, 0xE6, 0x11, 0x4C, 0x00, 0x08
+	};
+
+	// instructions per microsecond
+	double benchmark(Mode mode, std::shared_ptr<const Roms> roms, Dispatch dispatch, long instructions) {
+		C64 computer(mode, std::move(roms));
+		for (size_t i = 0; i < sizeof(BENCH_PROGRAM); ++i) {
+			computer.poke(0x0800 + i, BENCH_PROGRAM[i]);
+		}
+		computer.setProgramCounter(0x0800);
+		auto t0 = std::chrono::steady_clock::now();
+		computer.runInstructions(instructions, dispatch);
+		std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - t0;
+		return instructions / elapsed.count();
+	}
+
+	// SID register settings keeping every part busy: a sawtooth, a ring modulated pulse, noise,
+	// all with gates on, and the first voice through a resonant low pass
+	const uint8_t BENCH_SID[][2] = {
+		{0x00, 0x45}, {0x01, 0x1D}, {0x05, 0x09}, {0x06, 0xF0}, {0x04, 0x21},
+		{0x07, 0x00}, {0x08, 0x2C}, {0x09, 0x00}, {0x0A, 0x08}, {0x0C, 0x22}, {0x0D, 0xA8}, {0x0B, 0x45},
+		{0x0E, 0x00}, {0x0F, 0x0A}, {0x13, 0x00}, {0x14, 0xF0}, {0x12, 0x81},
+		{0x15, 0x03}, {0x16, 0x40}, {0x17, 0xF1}, {0x18, 0x1F}
+	};
+
+	// seconds of sound synthesized per second of wall time
+	double benchmarkSid(Mode mode, SidModel model, int sampleRate, double seconds) {
+		double clock = CLOCK_FREQUENCY[static_cast<int>(mode)];
+		SID sid(model, clock, sampleRate);
+		for (const auto& write : BENCH_SID) {
+			sid.write(write[0], write[1]);
+		}
+		// run a frame at a time, as SidThread does when there are no register writes
+		auto m = static_cast<int>(mode);
+		long frame = NUMBER_OF_LINES[m] * CYCLES_PER_LINE[m];
+		long cycles = static_cast<long>(seconds * clock);
+		std::vector<int16_t> samples;
+		auto t0 = std::chrono::steady_clock::now();
+		for (long done = 0; done < cycles; done += frame) {
+			samples.clear();
+			sid.run(frame, samples);
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+		return seconds / elapsed.count();
+	}
+
+}
+
+int main(int argc, char* argv[]) {
+	Mode mode = Mode::PAL;
+	long frames = 250;
+	std::string screenshot;
+	std::string trace;
+	std::string wav;
+	std::string program;
+	std::string loadSnapshot;
+	std::string saveSnapshot;
+	std::string romDirectory = C64::DEFAULT_ROM_DIRECTORY;
+	SidModel sidModel = SidModel::MOS6581;
+	int sampleRate = SAMPLE_RATE;
+	bool benchCpu = false;
+	bool benchSid = false;
+	bool realtime = false;
+	bool trueDrive = false;
+	bool jit = false;
+	bool checkJit = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg(argv[i]);
+		if (arg == "--ntsc") {
+			mode = Mode::NTSC;
+		} else if (arg == "--frames" && i + 1 < argc) {
+			frames = std::stol(argv[++i]);
+		} else if (arg == "--screenshot" && i + 1 < argc) {
+			screenshot = argv[++i];
+		} else if (arg == "--trace" && i + 1 < argc) {
+			trace = argv[++i];
+		} else if (arg == "--wav" && i + 1 < argc) {
+			wav = argv[++i];
+		} else if (arg == "--sid" && i + 1 < argc) {
+			std::string model(argv[++i]);
+			if (model != "6581" && model != "8580") {
+				usage();
+				return 1;
+			}
+			sidModel = model == "8580" ? SidModel::MOS8580 : SidModel::MOS6581;
+		} else if (arg == "--rate" && i + 1 < argc) {
+			sampleRate = std::stoi(argv[++i]);
+			if (sampleRate < 8000) {
+				usage();
+				return 1;
+			}
+		} else if (arg == "--autostart" && i + 1 < argc) {
+			program = argv[++i];
+		} else if (arg == "--true-drive") {
+			trueDrive = true;
+		} else if (arg == "--load-snapshot" && i + 1 < argc) {
+			loadSnapshot = argv[++i];
+		} else if (arg == "--save-snapshot" && i + 1 < argc) {
+			saveSnapshot = argv[++i];
+		} else if (arg == "--roms" && i + 1 < argc) {
+			romDirectory = argv[++i];
+		} else if (arg == "--realtime") {
+			realtime = true;
+		} else if (arg == "--jit") {
+			jit = true;
+		} else if (arg == "--check-jit") {
+			checkJit = true;
+		} else if (arg == "--bench-cpu") {
+			benchCpu = true;
+		} else if (arg == "--bench-sid") {
+			benchSid = true;
+		} else {
+			usage();
+			return 1;
+		}
+	}
+
+	if (benchCpu) {
+		auto roms = C64::loadRoms(romDirectory);
+		if (!roms) {
+			return 1;
+		}
+		const long instructions = 100000000;
+		std::cerr << "table dispatch:  " << benchmark(mode, roms, Dispatch::TABLE, instructions) << " MIPS\n";
+		std::cerr << "switch dispatch: " << benchmark(mode, roms, Dispatch::SWITCH, instructions) << " MIPS\n";
+		std::cerr << "block dispatch:  " << benchmark(mode, roms, Dispatch::BLOCK, instructions) << " MIPS\n";
+		if (Jit::isAvailable()) {
+			std::cerr << "jit dispatch:    " << benchmark(mode, roms, Dispatch::JIT, instructions) << " MIPS\n";
+		}
+		return 0;
+	}
+	if (benchSid) {
+		std::cerr << "SID at " << sampleRate << " Hz: " << benchmarkSid(mode, sidModel, sampleRate, 20.0)
+			<< " s synthesized per second\n";
+		return 0;
+	}
+
+	auto roms = C64::loadRoms(romDirectory);
+	if (!roms) {
+		return 1;
+	}
+	C64 computer(mode, roms);
+	if (!trace.empty() && !computer.startTrace(trace)) {
+		std::cerr << "Can't write file: " << trace << "\n";
+		return 1;
+	}
+	computer.setSidModel(sidModel);
+	if (!wav.empty()) {
+		auto sink = std::make_unique<WavSink>(wav, sampleRate);
+		if (!sink->isOpen()) {
+			std::cerr << "Can't write file: " << wav << "\n";
+			return 1;
+		}
+		computer.setAudioSink(std::move(sink));
+	}
+	// resume where the snapshot was taken, the SID model included, instead of booting
+	if (!loadSnapshot.empty() && !computer.loadSnapshot(loadSnapshot)) {
+		return 1;
+	}
+	// the boot before the program starts is not part of the frames counted
+	// with --true-drive a D64 image is loaded by the emulated 1541 instead of copied into memory
+	if (!program.empty() && !(trueDrive ? loadFromDrive(computer, program) : autostart(computer, program))) {
+		return 1;
+	}
+	if (jit || checkJit) {
+		computer.setDispatch(Dispatch::JIT);
+	}
+	// with --check-jit a fork runs alongside on the interpreter, and the two must stay the same frame after frame
+	std::unique_ptr<C64> reference;
+	if (checkJit) {
+		reference = computer.fork();
+		if (!reference) {
+			return 1;
+		}
+		reference->setDispatch(Dispatch::SWITCH);
+	}
+	std::vector<uint8_t> state, referenceState;
+	// without --realtime the run is unthrottled, as in warp mode
+	Pacer pacer(mode);
+	pacer.setWarp(!realtime);
+	long startCycle = computer.getClockCycle();
+	auto t0 = std::chrono::steady_clock::now();
+	for (long i = 0; i < frames; ++i) {
+		computer.runFrame();
+		if (reference) {
+			reference->runFrame();
+			computer.saveSnapshot(state);
+			reference->saveSnapshot(referenceState);
+			if (state != referenceState) {
+				std::cerr << "frame " << i + 1 << ": the compiled code and the interpreter differ\n";
+				return 1;
+			}
+		}
+		pacer.waitNextFrame();
+		if (realtime && pacer.speedUpdated()) {
+			std::cerr << "speed: " << pacer.getSpeed() << "%\n";
+		}
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+	computer.stopTrace();
+
+	double emulated = (computer.getClockCycle() - startCycle) / CLOCK_FREQUENCY[static_cast<int>(mode)];
+	std::cerr << frames << " frames, " << computer.getClockCycle() << " cycles in " << elapsed.count() << " s ("
+		<< 100.0 * emulated / elapsed.count() << "% of real time)\n";
+
+	if (!screenshot.empty() && !saveScreenshot(screenshot, computer)) {
+		std::cerr << "Can't write file: " << screenshot << "\n";
+		return 1;
+	}
+	if (!saveSnapshot.empty() && !computer.saveSnapshot(saveSnapshot)) {
+		return 1;
+	}
+	return 0;
+}
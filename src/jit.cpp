@@ -0,0 +1,884 @@
+#include "jit.h"
+#include "blockcache.h"
+#include "c64.h"
+#include <cstring>
+#include <vector>
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define C64_JIT
+#endif
+
+namespace {
+	const size_t BUFFER_SIZE = 1 << 20;
+	// more than the code of the longest block
+	const size_t MAX_BLOCK_CODE = 32 << 10;
+}
+
+#ifdef C64_JIT
+
+namespace {
+	enum Reg { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+	// the 6510 in callee-saved registers, which survive the calls out. The stack pointer and the flags
+	// other than carry stay in memory, where the instructions store what the flags come from.
+	const Reg MACHINE = RBX, A = R12, X = R13, Y = R14, CARRY = R15, CYCLES = RBP;
+	// no index register in a memory operand
+	const Reg NONE = RSP;
+	enum Alu { ADD = 0, OR = 1, AND = 4, SUB = 5, XOR = 6, CMP = 7 };
+	enum Shift { SHL = 4, SHR = 5 };
+	enum Cond { BELOW = 0x2, ABOVE_EQUAL = 0x3, ZERO = 0x4, NOT_ZERO = 0x5, BELOW_EQUAL = 0x6, ABOVE = 0x7,
+		GREATER_EQUAL = 0xD };
+	// the frame below the saved registers: next at [rsp], a byte set by the calls out at [rsp + 8]
+	const int FRAME = 24;
+	const int NEXT = 0;
+	const int CALLED = 8;
+
+	// the few x86-64 instructions the compiler needs. Operations are on 32 bit registers unless
+	// named 64, memory operands are [base + index * 2^scale + disp].
+	class Assembler {
+	public:
+		std::vector<uint8_t> code;
+		size_t here() const {
+			return code.size();
+		}
+		void mov(Reg dst, Reg src) {
+			rex(false, src, 0, dst);
+			code.push_back(0x89);
+			modrm(src, dst);
+		}
+		void mov64(Reg dst, Reg src) {
+			rex(true, src, 0, dst);
+			code.push_back(0x89);
+			modrm(src, dst);
+		}
+		void movImm(Reg dst, uint32_t value) {
+			rex(false, 0, 0, dst);
+			code.push_back(0xB8 + (dst & 7));
+			dword(value);
+		}
+		void movImm64(Reg dst, uint64_t value) {
+			rex(true, 0, 0, dst);
+			code.push_back(0xB8 + (dst & 7));
+			dword(static_cast<uint32_t>(value));
+			dword(static_cast<uint32_t>(value >> 32));
+		}
+		void alu(Alu op, Reg dst, Reg src) {
+			rex(false, src, 0, dst);
+			code.push_back(op * 8 + 1);
+			modrm(src, dst);
+		}
+		void alu64(Alu op, Reg dst, Reg src) {
+			rex(true, src, 0, dst);
+			code.push_back(op * 8 + 1);
+			modrm(src, dst);
+		}
+		void aluImm(Alu op, Reg dst, uint32_t value) {
+			rex(false, 0, 0, dst);
+			code.push_back(0x81);
+			modrm(op, dst);
+			dword(value);
+		}
+		void alu64Imm(Alu op, Reg dst, uint32_t value) {
+			rex(true, 0, 0, dst);
+			code.push_back(0x81);
+			modrm(op, dst);
+			dword(value);
+		}
+		// reg op= qword [base + disp]
+		void alu64Load(Alu op, Reg reg, Reg base, int32_t disp) {
+			rex(true, reg, NONE, base);
+			code.push_back(op * 8 + 3);
+			memory(reg, base, NONE, 0, disp);
+		}
+		void cmpByteImm(Reg base, int32_t disp, uint8_t value) {
+			rex(false, 0, NONE, base);
+			code.push_back(0x80);
+			memory(CMP, base, NONE, 0, disp);
+			code.push_back(value);
+		}
+		void test(Reg dst, Reg src) {
+			rex(false, src, 0, dst);
+			code.push_back(0x85);
+			modrm(src, dst);
+		}
+		void test64(Reg dst, Reg src) {
+			rex(true, src, 0, dst);
+			code.push_back(0x85);
+			modrm(src, dst);
+		}
+		void testImm(Reg dst, uint32_t value) {
+			rex(false, 0, 0, dst);
+			code.push_back(0xF7);
+			modrm(0, dst);
+			dword(value);
+		}
+		void shift(Shift op, Reg dst, uint8_t count) {
+			rex(false, 0, 0, dst);
+			code.push_back(0xC1);
+			modrm(op, dst);
+			code.push_back(count);
+		}
+		// dst = condition, for AL, CL, DL, BL only; the rest of dst is left alone
+		void set(Cond cond, Reg dst) {
+			code.push_back(0x0F);
+			code.push_back(0x90 + cond);
+			modrm(0, dst);
+		}
+		// dst = low byte of src, src AL, CL, DL or BL
+		void movzx8(Reg dst, Reg src) {
+			rex(false, dst, 0, src);
+			code.push_back(0x0F);
+			code.push_back(0xB6);
+			modrm(dst, src);
+		}
+		void loadByte(Reg dst, Reg base, Reg index, int scale, int32_t disp) {
+			rex(false, dst, index, base);
+			code.push_back(0x0F);
+			code.push_back(0xB6);
+			memory(dst, base, index, scale, disp);
+		}
+		// src must not be SPL, BPL, SIL or DIL, which need an empty REX prefix
+		void storeByte(Reg src, Reg base, Reg index, int scale, int32_t disp) {
+			rex(false, src, index, base);
+			code.push_back(0x88);
+			memory(src, base, index, scale, disp);
+		}
+		void storeByteImm(uint8_t value, Reg base, Reg index, int32_t disp) {
+			rex(false, 0, index, base);
+			code.push_back(0xC6);
+			memory(0, base, index, 0, disp);
+			code.push_back(value);
+		}
+		void store16(Reg src, Reg base, int32_t disp) {
+			code.push_back(0x66);
+			rex(false, src, NONE, base);
+			code.push_back(0x89);
+			memory(src, base, NONE, 0, disp);
+		}
+		void store16Imm(uint16_t value, Reg base, int32_t disp) {
+			code.push_back(0x66);
+			rex(false, 0, NONE, base);
+			code.push_back(0xC7);
+			memory(0, base, NONE, 0, disp);
+			code.push_back(value & 0xFF);
+			code.push_back(value >> 8);
+		}
+		void load64(Reg dst, Reg base, Reg index, int scale, int32_t disp) {
+			rex(true, dst, index, base);
+			code.push_back(0x8B);
+			memory(dst, base, index, scale, disp);
+		}
+		void store64(Reg src, Reg base, int32_t disp) {
+			rex(true, src, NONE, base);
+			code.push_back(0x89);
+			memory(src, base, NONE, 0, disp);
+		}
+		void push(Reg reg) {
+			rex(false, 0, 0, reg);
+			code.push_back(0x50 + (reg & 7));
+		}
+		void pop(Reg reg) {
+			rex(false, 0, 0, reg);
+			code.push_back(0x58 + (reg & 7));
+		}
+		void call(const void* function) {
+			movImm64(RAX, reinterpret_cast<uint64_t>(function));
+			code.push_back(0xFF);
+			code.push_back(0xD0);
+		}
+		void ret() {
+			code.push_back(0xC3);
+		}
+		// jumps return the position of their displacement, for bind
+		size_t jump(Cond cond) {
+			code.push_back(0x0F);
+			code.push_back(0x80 + cond);
+			dword(0);
+			return here() - 4;
+		}
+		size_t jump() {
+			code.push_back(0xE9);
+			dword(0);
+			return here() - 4;
+		}
+		size_t shortJump(Cond cond) {
+			code.push_back(0x70 + cond);
+			code.push_back(0);
+			return here() - 1;
+		}
+		// make the jump land here, or at target
+		void bind(size_t jump) {
+			bind(jump, here());
+		}
+		void bind(size_t jump, size_t target) {
+			auto displacement = static_cast<int32_t>(target - (jump + 4));
+			memcpy(&code[jump], &displacement, 4);
+		}
+		void bindShort(size_t jump) {
+			code[jump] = static_cast<uint8_t>(here() - (jump + 1));
+		}
+	private:
+		void dword(uint32_t value) {
+			for (int i = 0; i < 4; ++i) {
+				code.push_back(static_cast<uint8_t>(value >> (8 * i)));
+			}
+		}
+		void rex(bool wide, int reg, int index, int base) {
+			uint8_t prefix = 0x40 | (wide ? 0x08 : 0) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+			if (prefix != 0x40) {
+				code.push_back(prefix);
+			}
+		}
+		void modrm(int reg, int rm) {
+			code.push_back(0xC0 | ((reg & 7) << 3) | (rm & 7));
+		}
+		// always with a SIB byte and a 32 bit displacement, which works for every base
+		void memory(int reg, Reg base, Reg index, int scale, int32_t disp) {
+			code.push_back(0x84 | ((reg & 7) << 3));
+			code.push_back((scale << 6) | ((index & 7) << 3) | (base & 7));
+			dword(static_cast<uint32_t>(disp));
+		}
+	};
+
+	class Compiler {
+	public:
+		explicit Compiler(const Jit::Layout& layout) : _layout(layout), _calls(false) {
+		}
+		// empty if the first instruction can't be compiled
+		std::vector<uint8_t> compile(const Block& block, uint16_t address);
+	private:
+		// where the operand is: at a constant address, or at the one computed into ESI
+		struct Address {
+			bool constant;
+			uint16_t value;
+		};
+		// out of line call to the machine for a page without a plain mapping
+		struct CallOut {
+			size_t jump;
+			size_t back;
+			bool write;
+			Address address;
+		};
+		static bool handles(const OpcodeInfo& op);
+		void compile(const OpcodeInfo& op, const DecodedInstruction& instruction, int index);
+		void compileFlow(const OpcodeInfo& op, const DecodedInstruction& instruction, int index, int count);
+		void loadState();
+		void storeState();
+		// return to the machine at pc, count instructions having run
+		void leave(uint16_t pc, int count);
+		// the same, the program counter having been stored
+		void leave(int count);
+		Address address(AddressMode mode, uint16_t operand, bool penalty);
+		// the operand into EAX
+		void read(AddressMode mode, uint16_t operand);
+		void read(Address address);
+		// EDX to memory
+		void write(Address address);
+		// the extra write of read-modify-write instructions, which only chips see
+		void writeBack(Address address);
+		void callOut(size_t jump, bool write, Address address);
+		void setNZ(Reg value);
+		// the status register into dst, as Cpu6502::getStatus. Uses ECX.
+		void status(Reg dst);
+		void addWithCarry();
+		void compare(Reg reg);
+		void shift(const std::string& text, Reg value);
+		Assembler _as;
+		const Jit::Layout& _layout;
+		std::vector<CallOut> _callOuts;
+		std::vector<std::pair<size_t, int>> _exits;
+		std::vector<uint16_t> _pcs;     // of each instruction, and after the last
+		bool _calls;                    // the instruction being compiled may call out
+	};
+
+	bool Compiler::handles(const OpcodeInfo& op) {
+		static const char* const HANDLED[] = {
+			"lda", "ldx", "ldy", "sta", "stx", "sty", "ora", "and", "eor", "adc", "sbc", "cmp", "cpx", "cpy",
+			"bit", "asl", "lsr", "rol", "ror", "inc", "dec", "inx", "iny", "dex", "dey", "tax", "tay", "txa",
+			"tya", "tsx", "txs", "clc", "sec", "cld", "sed", "clv", "pha", "pla", "php", "nop", "jsr", "rts"
+		};
+		if (op.addressMode == AddressMode::RELATIVE || (op.text == "jmp" && op.addressMode == AddressMode::ABSOLUTE)) {
+			return true;
+		}
+		for (const char* text : HANDLED) {
+			if (op.text == text) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::vector<uint8_t> Compiler::compile(const Block& block, uint16_t address) {
+		int count = 0;
+		while (count < block.count && handles(C64::getOpcodeInfo(block.instructions[count].opcode))) {
+			++count;
+		}
+		if (count == 0) {
+			return {};
+		}
+		uint16_t pc = address;
+		for (int i = 0; i < count; ++i) {
+			_pcs.push_back(pc);
+			pc += C64::getOpcodeInfo(block.instructions[i].opcode).bytes;
+		}
+		_pcs.push_back(pc);
+
+		for (Reg reg : {RBX, RBP, R12, R13, R14, R15}) {
+			_as.push(reg);
+		}
+		_as.alu64Imm(SUB, RSP, FRAME);
+		_as.mov64(MACHINE, RDI);
+		_as.store64(RSI, RSP, NEXT);
+		_as.storeByteImm(0, RSP, NONE, CALLED);
+		loadState();
+		for (int i = 0; i < count; ++i) {
+			const auto& instruction = block.instructions[i];
+			const auto& op = C64::getOpcodeInfo(instruction.opcode);
+			if (op.endsBlock) {
+				compileFlow(op, instruction, i, count);
+				continue;
+			}
+			_calls = false;
+			compile(op, instruction, i);
+			_as.alu64Imm(ADD, CYCLES, instruction.cycles);
+			if (i + 1 == count) {
+				leave(_pcs[count], count);
+				break;
+			}
+			// where the interpreter looks at the scheduler, which only a call out may have changed
+			if (_calls) {
+				_as.cmpByteImm(RSP, CALLED, 0);
+				_exits.emplace_back(_as.jump(NOT_ZERO), i + 1);
+			}
+			_as.alu64Load(CMP, CYCLES, RSP, NEXT);
+			_exits.emplace_back(_as.jump(GREATER_EQUAL), i + 1);
+		}
+
+		for (const auto& callOut : _callOuts) {
+			_as.bind(callOut.jump);
+			storeState();
+			// 16 bytes, the stack stays aligned
+			_as.push(RSI);
+			_as.push(RDX);
+			_as.mov64(RDI, MACHINE);
+			if (callOut.address.constant) {
+				_as.movImm(RSI, callOut.address.value);
+			}
+			if (callOut.write) {
+				_as.call(reinterpret_cast<const void*>(_layout.write));
+			} else {
+				_as.call(reinterpret_cast<const void*>(_layout.read));
+				// only AL is the result
+				_as.movzx8(RAX, RAX);
+			}
+			_as.pop(RDX);
+			_as.pop(RSI);
+			_as.storeByteImm(1, RSP, NONE, CALLED);
+			_as.bind(_as.jump(), callOut.back);
+		}
+		for (const auto& exit : _exits) {
+			_as.bind(exit.first);
+			leave(_pcs[exit.second], exit.second);
+		}
+		return std::move(_as.code);
+	}
+
+	void Compiler::loadState() {
+		_as.loadByte(A, MACHINE, NONE, 0, _layout.a);
+		_as.loadByte(X, MACHINE, NONE, 0, _layout.x);
+		_as.loadByte(Y, MACHINE, NONE, 0, _layout.y);
+		_as.loadByte(CARRY, MACHINE, NONE, 0, _layout.carry);
+		_as.load64(CYCLES, MACHINE, NONE, 0, _layout.clockCycle);
+	}
+
+	void Compiler::storeState() {
+		_as.storeByte(A, MACHINE, NONE, 0, _layout.a);
+		_as.storeByte(X, MACHINE, NONE, 0, _layout.x);
+		_as.storeByte(Y, MACHINE, NONE, 0, _layout.y);
+		_as.storeByte(CARRY, MACHINE, NONE, 0, _layout.carry);
+		_as.store64(CYCLES, MACHINE, _layout.clockCycle);
+	}
+
+	void Compiler::leave(uint16_t pc, int count) {
+		_as.store16Imm(pc, MACHINE, _layout.pc);
+		leave(count);
+	}
+
+	void Compiler::leave(int count) {
+		storeState();
+		_as.movImm(RAX, count);
+		_as.alu64Imm(ADD, RSP, FRAME);
+		for (Reg reg : {R15, R14, R13, R12, RBP, RBX}) {
+			_as.pop(reg);
+		}
+		_as.ret();
+	}
+
+	void Compiler::callOut(size_t jump, bool write, Address address) {
+		_callOuts.push_back({jump, _as.here(), write, address});
+		_calls = true;
+	}
+
+	Compiler::Address Compiler::address(AddressMode mode, uint16_t operand, bool penalty) {
+		Reg index = mode == AddressMode::ABSOLUTE_Y || mode == AddressMode::ZEROPAGE_Y ? Y : X;
+		switch (mode) {
+			case AddressMode::ZEROPAGE_INDEXED:
+			case AddressMode::ZEROPAGE_Y:
+				_as.mov(RSI, index);
+				_as.aluImm(ADD, RSI, operand);
+				_as.aluImm(AND, RSI, 0xFF);
+				return {false, 0};
+			case AddressMode::ABSOLUTE_X:
+			case AddressMode::ABSOLUTE_Y:
+				_as.mov(RSI, index);
+				_as.aluImm(ADD, RSI, operand);
+				if (penalty) {
+					// past the end of the page of the base
+					_as.aluImm(CMP, RSI, operand | 0xFF);
+					_as.set(ABOVE, RCX);
+					_as.movzx8(RCX, RCX);
+					_as.alu64(ADD, CYCLES, RCX);
+				}
+				_as.aluImm(AND, RSI, 0xFFFF);
+				return {false, 0};
+			case AddressMode::INDEXED_INDIRECT:
+				// the zero page is always RAM
+				_as.load64(RAX, MACHINE, NONE, 0, _layout.readPage);
+				_as.mov(RCX, X);
+				_as.aluImm(ADD, RCX, operand);
+				_as.aluImm(AND, RCX, 0xFF);
+				_as.loadByte(RSI, RAX, RCX, 0, 0);
+				_as.aluImm(ADD, RCX, 1);
+				_as.aluImm(AND, RCX, 0xFF);
+				_as.loadByte(RCX, RAX, RCX, 0, 0);
+				_as.shift(SHL, RCX, 8);
+				_as.alu(OR, RSI, RCX);
+				return {false, 0};
+			case AddressMode::INDIRECT_INDEXED:
+				_as.load64(RAX, MACHINE, NONE, 0, _layout.readPage);
+				_as.loadByte(RSI, RAX, NONE, 0, operand & 0xFF);
+				_as.loadByte(RCX, RAX, NONE, 0, (operand + 1) & 0xFF);
+				_as.shift(SHL, RCX, 8);
+				_as.alu(OR, RSI, RCX);
+				_as.mov(RCX, RSI);
+				_as.alu(ADD, RSI, Y);
+				if (penalty) {
+					_as.mov(RAX, RSI);
+					_as.alu(XOR, RAX, RCX);
+					_as.testImm(RAX, 0xFF00);
+					_as.set(NOT_ZERO, RAX);
+					_as.movzx8(RAX, RAX);
+					_as.alu64(ADD, CYCLES, RAX);
+				}
+				_as.aluImm(AND, RSI, 0xFFFF);
+				return {false, 0};
+			default:
+				return {true, operand};
+		}
+	}
+
+	void Compiler::read(AddressMode mode, uint16_t operand) {
+		if (mode == AddressMode::IMMEDIATE) {
+			_as.movImm(RAX, operand & 0xFF);
+		} else {
+			bool penalty = mode == AddressMode::ABSOLUTE_X || mode == AddressMode::ABSOLUTE_Y ||
+				mode == AddressMode::INDIRECT_INDEXED;
+			read(address(mode, operand, penalty));
+		}
+	}
+
+	void Compiler::read(Address address) {
+		size_t slow;
+		if (address.constant) {
+			int page = address.value >> 8;
+			_as.load64(RAX, MACHINE, NONE, 0, _layout.readPage + page * 8);
+			// the zero page and the stack are always RAM
+			bool plain = page < 2;
+			if (!plain) {
+				_as.test64(RAX, RAX);
+				slow = _as.jump(ZERO);
+			}
+			_as.loadByte(RAX, RAX, NONE, 0, address.value & 0xFF);
+			if (!plain) {
+				callOut(slow, false, address);
+			}
+		} else {
+			_as.mov(RCX, RSI);
+			_as.shift(SHR, RCX, 8);
+			_as.load64(RAX, MACHINE, RCX, 3, _layout.readPage);
+			_as.test64(RAX, RAX);
+			slow = _as.jump(ZERO);
+			_as.mov(RCX, RSI);
+			_as.aluImm(AND, RCX, 0xFF);
+			_as.loadByte(RAX, RAX, RCX, 0, 0);
+			callOut(slow, false, address);
+		}
+	}
+
+	void Compiler::write(Address address) {
+		if (address.constant) {
+			int page = address.value >> 8;
+			// the processor port at $0000/$0001 remaps memory
+			if (address.value < 0x0002) {
+				callOut(_as.jump(), true, address);
+				return;
+			}
+			_as.load64(RAX, MACHINE, NONE, 0, _layout.writePage + page * 8);
+			size_t slow = 0;
+			if (page >= 2) {
+				_as.test64(RAX, RAX);
+				slow = _as.jump(ZERO);
+			}
+			_as.storeByte(RDX, RAX, NONE, 0, address.value & 0xFF);
+			if (page >= 2) {
+				callOut(slow, true, address);
+			}
+		} else {
+			_as.aluImm(CMP, RSI, 0x0001);
+			size_t port = _as.jump(BELOW_EQUAL);
+			_as.mov(RCX, RSI);
+			_as.shift(SHR, RCX, 8);
+			_as.load64(RAX, MACHINE, RCX, 3, _layout.writePage);
+			_as.test64(RAX, RAX);
+			size_t slow = _as.jump(ZERO);
+			_as.mov(RCX, RSI);
+			_as.aluImm(AND, RCX, 0xFF);
+			_as.storeByte(RDX, RAX, RCX, 0, 0);
+			callOut(port, true, address);
+			callOut(slow, true, address);
+		}
+	}
+
+	void Compiler::writeBack(Address address) {
+		if (address.constant) {
+			int page = address.value >> 8;
+			if (page < 2) {
+				return;
+			}
+			_as.load64(RAX, MACHINE, NONE, 0, _layout.writePage + page * 8);
+		} else {
+			_as.mov(RCX, RSI);
+			_as.shift(SHR, RCX, 8);
+			_as.load64(RAX, MACHINE, RCX, 3, _layout.writePage);
+		}
+		_as.test64(RAX, RAX);
+		callOut(_as.jump(ZERO), true, address);
+	}
+
+	void Compiler::setNZ(Reg value) {
+		_as.storeByte(value, MACHINE, NONE, 0, _layout.negative);
+		_as.storeByte(value, MACHINE, NONE, 0, _layout.zero);
+	}
+
+	void Compiler::status(Reg dst) {
+		_as.loadByte(dst, MACHINE, NONE, 0, _layout.status);
+		_as.aluImm(AND, dst, 0x3C);
+		_as.loadByte(RCX, MACHINE, NONE, 0, _layout.negative);
+		_as.aluImm(AND, RCX, 0x80);
+		_as.alu(OR, dst, RCX);
+		_as.alu(OR, dst, CARRY);
+		_as.cmpByteImm(MACHINE, _layout.overflow, 0);
+		_as.set(NOT_ZERO, RCX);
+		_as.movzx8(RCX, RCX);
+		_as.shift(SHL, RCX, 6);
+		_as.alu(OR, dst, RCX);
+		_as.cmpByteImm(MACHINE, _layout.zero, 0);
+		_as.set(ZERO, RCX);
+		_as.movzx8(RCX, RCX);
+		_as.shift(SHL, RCX, 1);
+		_as.alu(OR, dst, RCX);
+	}
+
+	// A = A + EAX + C
+	void Compiler::addWithCarry() {
+		_as.mov(RDX, A);
+		_as.alu(ADD, RDX, RAX);
+		_as.alu(ADD, RDX, CARRY);
+		// carry from bit 8 of the sum
+		_as.mov(CARRY, RDX);
+		_as.shift(SHR, CARRY, 8);
+		// overflow when both operands have a sign other than the result's
+		_as.mov(RCX, A);
+		_as.alu(XOR, RCX, RDX);
+		_as.alu(XOR, RAX, RDX);
+		_as.alu(AND, RCX, RAX);
+		_as.aluImm(AND, RCX, 0x80);
+		_as.storeByte(RCX, MACHINE, NONE, 0, _layout.overflow);
+		_as.aluImm(AND, RDX, 0xFF);
+		_as.mov(A, RDX);
+		setNZ(A);
+	}
+
+	// flags of reg - EAX
+	void Compiler::compare(Reg reg) {
+		_as.alu(CMP, reg, RAX);
+		_as.set(ABOVE_EQUAL, RCX);
+		_as.movzx8(CARRY, RCX);
+		_as.mov(RDX, reg);
+		_as.alu(SUB, RDX, RAX);
+		_as.aluImm(AND, RDX, 0xFF);
+		setNZ(RDX);
+	}
+
+	void Compiler::shift(const std::string& text, Reg value) {
+		if (text == "asl") {
+			_as.mov(CARRY, value);
+			_as.shift(SHR, CARRY, 7);
+			_as.shift(SHL, value, 1);
+			_as.aluImm(AND, value, 0xFF);
+		} else if (text == "lsr") {
+			_as.mov(CARRY, value);
+			_as.aluImm(AND, CARRY, 0x01);
+			_as.shift(SHR, value, 1);
+		} else if (text == "rol") {
+			_as.shift(SHL, value, 1);
+			_as.alu(OR, value, CARRY);
+			_as.mov(CARRY, value);
+			_as.shift(SHR, CARRY, 8);
+			_as.aluImm(AND, value, 0xFF);
+		} else {
+			_as.mov(RCX, CARRY);
+			_as.shift(SHL, RCX, 8);
+			_as.alu(OR, value, RCX);
+			_as.mov(CARRY, value);
+			_as.aluImm(AND, CARRY, 0x01);
+			_as.shift(SHR, value, 1);
+		}
+		setNZ(value);
+	}
+
+	void Compiler::compile(const OpcodeInfo& op, const DecodedInstruction& instruction, int index) {
+		const std::string& text = op.text;
+		auto mode = op.addressMode;
+		uint16_t operand = instruction.operand;
+		auto reg = [&] (char name) {
+			return name == 'a' ? A : name == 'x' ? X : Y;
+		};
+		if (text == "lda" || text == "ldx" || text == "ldy") {
+			read(mode, operand);
+			_as.mov(reg(text[2]), RAX);
+			setNZ(reg(text[2]));
+		} else if (text == "sta" || text == "stx" || text == "sty") {
+			auto where = address(mode, operand, false);
+			_as.mov(RDX, reg(text[2]));
+			write(where);
+		} else if (text == "ora" || text == "and" || text == "eor") {
+			read(mode, operand);
+			_as.alu(text == "ora" ? OR : text == "and" ? AND : XOR, A, RAX);
+			setNZ(A);
+		} else if (text == "adc" || text == "sbc") {
+			// decimal mode is the interpreter's, before anything is read
+			_as.loadByte(RCX, MACHINE, NONE, 0, _layout.status);
+			_as.testImm(RCX, 0x08);
+			_exits.emplace_back(_as.jump(NOT_ZERO), index);
+			read(mode, operand);
+			if (text == "sbc") {
+				_as.aluImm(XOR, RAX, 0xFF);
+			}
+			addWithCarry();
+		} else if (text == "cmp" || text == "cpx" || text == "cpy") {
+			read(mode, operand);
+			compare(text == "cmp" ? A : reg(text[2]));
+		} else if (text == "bit") {
+			read(mode, operand);
+			_as.storeByte(RAX, MACHINE, NONE, 0, _layout.negative);
+			_as.mov(RCX, RAX);
+			_as.aluImm(AND, RCX, 0x40);
+			_as.storeByte(RCX, MACHINE, NONE, 0, _layout.overflow);
+			_as.alu(AND, RAX, A);
+			_as.storeByte(RAX, MACHINE, NONE, 0, _layout.zero);
+		} else if ((text == "asl" || text == "lsr" || text == "rol" || text == "ror") && mode == AddressMode::ACCUMULATOR) {
+			shift(text, A);
+		} else if (text == "asl" || text == "lsr" || text == "rol" || text == "ror" || text == "inc" || text == "dec") {
+			auto where = address(mode, operand, false);
+			read(where);
+			_as.mov(RDX, RAX);
+			writeBack(where);
+			if (text == "inc" || text == "dec") {
+				_as.aluImm(text == "inc" ? ADD : SUB, RDX, 1);
+				_as.aluImm(AND, RDX, 0xFF);
+				setNZ(RDX);
+			} else {
+				shift(text, RDX);
+			}
+			write(where);
+		} else if (text == "inx" || text == "iny" || text == "dex" || text == "dey") {
+			Reg r = reg(text[2]);
+			_as.aluImm(text[0] == 'i' ? ADD : SUB, r, 1);
+			_as.aluImm(AND, r, 0xFF);
+			setNZ(r);
+		} else if (text == "tax" || text == "tay" || text == "txa" || text == "tya") {
+			_as.mov(reg(text[2]), reg(text[1]));
+			setNZ(reg(text[2]));
+		} else if (text == "tsx") {
+			_as.loadByte(X, MACHINE, NONE, 0, _layout.sp);
+			setNZ(X);
+		} else if (text == "txs") {
+			_as.storeByte(X, MACHINE, NONE, 0, _layout.sp);
+		} else if (text == "clc" || text == "sec") {
+			_as.movImm(CARRY, text == "sec");
+		} else if (text == "clv") {
+			_as.storeByteImm(0, MACHINE, NONE, _layout.overflow);
+		} else if (text == "cld" || text == "sed") {
+			_as.loadByte(RCX, MACHINE, NONE, 0, _layout.status);
+			if (text == "cld") {
+				_as.aluImm(AND, RCX, 0xF7);
+			} else {
+				_as.aluImm(OR, RCX, 0x08);
+			}
+			_as.storeByte(RCX, MACHINE, NONE, 0, _layout.status);
+		} else if (text == "pha" || text == "php") {
+			if (text == "php") {
+				// the break flag only exists on the stack
+				status(RDX);
+				_as.aluImm(OR, RDX, 0x30);
+			}
+			_as.load64(RAX, MACHINE, NONE, 0, _layout.stack);
+			_as.loadByte(RCX, MACHINE, NONE, 0, _layout.sp);
+			_as.storeByte(text == "pha" ? A : RDX, RAX, RCX, 0, 0);
+			_as.aluImm(SUB, RCX, 1);
+			_as.storeByte(RCX, MACHINE, NONE, 0, _layout.sp);
+		} else if (text == "pla") {
+			_as.loadByte(RCX, MACHINE, NONE, 0, _layout.sp);
+			_as.aluImm(ADD, RCX, 1);
+			_as.aluImm(AND, RCX, 0xFF);
+			_as.storeByte(RCX, MACHINE, NONE, 0, _layout.sp);
+			_as.load64(RAX, MACHINE, NONE, 0, _layout.stack);
+			_as.loadByte(A, RAX, RCX, 0, 0);
+			setNZ(A);
+		} else if (text == "nop") {
+			// those with an operand still read it
+			if (mode != AddressMode::IMPLIED) {
+				read(mode, operand);
+			}
+		}
+	}
+
+	// the instructions that end a block: they set the program counter and leave
+	void Compiler::compileFlow(const OpcodeInfo& op, const DecodedInstruction& instruction, int index, int count) {
+		const std::string& text = op.text;
+		uint16_t pc = _pcs[index];
+		if (op.addressMode == AddressMode::RELATIVE) {
+			static const char* const BRANCHES[] = {"bpl", "bmi", "bvc", "bvs", "bcc", "bcs", "bne", "beq"};
+			int branch = 0;
+			while (text != BRANCHES[branch]) {
+				++branch;
+			}
+			uint16_t next = pc + 2;
+			uint16_t target = next + static_cast<int8_t>(instruction.operand & 0xFF);
+			// the condition for a set flag, from where the interpreter keeps it
+			Cond set = NOT_ZERO;
+			if (branch < 2) {
+				_as.loadByte(RCX, MACHINE, NONE, 0, _layout.negative);
+				_as.testImm(RCX, 0x80);
+			} else if (branch < 4) {
+				_as.cmpByteImm(MACHINE, _layout.overflow, 0);
+			} else if (branch < 6) {
+				_as.test(CARRY, CARRY);
+			} else {
+				_as.cmpByteImm(MACHINE, _layout.zero, 0);
+				set = ZERO;
+			}
+			// taken on a clear flag for the even ones
+			Cond flagClear = set == ZERO ? NOT_ZERO : ZERO;
+			size_t notTaken = _as.jump(branch % 2 == 0 ? set : flagClear);
+			_as.alu64Imm(ADD, CYCLES, instruction.cycles + (((next ^ target) & 0xFF00) ? 2 : 1));
+			leave(target, count);
+			_as.bind(notTaken);
+			_as.alu64Imm(ADD, CYCLES, instruction.cycles);
+			leave(next, count);
+		} else if (text == "jmp") {
+			_as.alu64Imm(ADD, CYCLES, instruction.cycles);
+			leave(instruction.operand, count);
+		} else if (text == "jsr") {
+			uint16_t back = pc + 2;
+			_as.load64(RAX, MACHINE, NONE, 0, _layout.stack);
+			_as.loadByte(RCX, MACHINE, NONE, 0, _layout.sp);
+			_as.storeByteImm(back >> 8, RAX, RCX, 0);
+			_as.aluImm(SUB, RCX, 1);
+			_as.aluImm(AND, RCX, 0xFF);
+			_as.storeByteImm(back & 0xFF, RAX, RCX, 0);
+			_as.aluImm(SUB, RCX, 1);
+			_as.storeByte(RCX, MACHINE, NONE, 0, _layout.sp);
+			_as.alu64Imm(ADD, CYCLES, instruction.cycles);
+			leave(instruction.operand, count);
+		} else {
+			// rts: the return address on the stack is that of its last byte
+			_as.load64(RAX, MACHINE, NONE, 0, _layout.stack);
+			_as.loadByte(RCX, MACHINE, NONE, 0, _layout.sp);
+			_as.aluImm(ADD, RCX, 1);
+			_as.aluImm(AND, RCX, 0xFF);
+			_as.loadByte(RDX, RAX, RCX, 0, 0);
+			_as.aluImm(ADD, RCX, 1);
+			_as.aluImm(AND, RCX, 0xFF);
+			_as.loadByte(RSI, RAX, RCX, 0, 0);
+			_as.storeByte(RCX, MACHINE, NONE, 0, _layout.sp);
+			_as.shift(SHL, RSI, 8);
+			_as.alu(OR, RDX, RSI);
+			_as.aluImm(ADD, RDX, 1);
+			_as.store16(RDX, MACHINE, _layout.pc);
+			_as.alu64Imm(ADD, CYCLES, instruction.cycles);
+			leave(count);
+		}
+	}
+}
+
+#endif
+
+Jit::Jit(const Layout& layout) : _layout(layout), _buffer(nullptr), _used(0) {
+#ifdef C64_JIT
+	void* buffer = mmap(nullptr, BUFFER_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffer != MAP_FAILED) {
+		_buffer = static_cast<uint8_t*>(buffer);
+	}
+#endif
+}
+
+Jit::~Jit() {
+#ifdef C64_JIT
+	if (_buffer != nullptr) {
+		munmap(_buffer, BUFFER_SIZE);
+	}
+#endif
+}
+
+bool Jit::isAvailable() {
+#ifdef C64_JIT
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool Jit::hasRoom() const {
+	return _buffer != nullptr && BUFFER_SIZE - _used >= MAX_BLOCK_CODE;
+}
+
+Jit::Code Jit::compile(const Block& block, uint16_t address) {
+#ifdef C64_JIT
+	if (!hasRoom()) {
+		return nullptr;
+	}
+	Compiler compiler(_layout);
+	auto code = compiler.compile(block, address);
+	if (code.empty() || code.size() > BUFFER_SIZE - _used) {
+		return nullptr;
+	}
+	// writable only while the code is copied in
+	if (mprotect(_buffer, BUFFER_SIZE, PROT_READ | PROT_WRITE) != 0) {
+		return nullptr;
+	}
+	memcpy(_buffer + _used, code.data(), code.size());
+	mprotect(_buffer, BUFFER_SIZE, PROT_READ | PROT_EXEC);
+	auto entry = reinterpret_cast<Code>(_buffer + _used);
+	_used += (code.size() + 15) & ~static_cast<size_t>(15);
+	return entry;
+#else
+	(void) block;
+	(void) address;
+	return nullptr;
+#endif
+}
+
+void Jit::clear() {
+	_used = 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+struct Block;
+
+// Compiles hot blocks of 6510 code to x86-64. Only on x86-64 Unix hosts: elsewhere isAvailable() is
+// false and blocks stay interpreted.
+//
+// The generated code keeps A, X, Y, the carry and the clock cycle in callee-saved host registers, and
+// stores what the other flags come from as the interpreter does, see Cpu6502::_status. It accesses
+// memory through the machine's page tables and calls out to the machine for the pages these map to
+// nullptr. After each instruction it adds the cycles and returns if an event is due or a call out
+// was made, which is where the interpreter looks at the scheduler, so the chips see the same cycles.
+// Compiling stops at the first instruction not handled here: those that change the interrupt flag,
+// RTI, BRK, indirect JMP and the undocumented opcodes are left to the interpreter, and ADC and SBC
+// return to it when the decimal flag is set.
+class Jit {
+public:
+	// runs the compiled instructions of a block from the start, or until an event is due at the cycle
+	// next. Returns how many ran; the machine's registers and program counter are then up to date.
+	using Code = int (*)(void* machine, long next);
+	// where the code finds the machine's state, as byte offsets from the machine pointer
+	struct Layout {
+		int32_t a, x, y, sp, status, pc, clockCycle;
+		int32_t negative, zero, carry, overflow;    // the flags kept out of status
+		int32_t stack;                  // uint8_t*, page 1
+		int32_t readPage, writePage;    // the page tables, 256 pointers each
+		// for pages mapped to nullptr, called with everything above stored
+		uint8_t (*read)(void* machine, uint16_t address);
+		void (*write)(void* machine, uint16_t address, uint8_t value);
+	};
+	// a block is compiled on its run number HOT_RUNS
+	static constexpr uint32_t HOT_RUNS = 32;
+	explicit Jit(const Layout& layout);
+	~Jit();
+	Jit(const Jit&) = delete;
+	Jit& operator=(const Jit&) = delete;
+	static bool isAvailable();
+	// native code for the instructions of the block starting at address, as many as are handled here;
+	// nullptr if the first one isn't or there is no room left
+	Code compile(const Block& block, uint16_t address);
+	// room for at least one more block
+	bool hasRoom() const;
+	// drop all the code: the caller first forgets every Code it was given
+	void clear();
+private:
+	Layout _layout;
+	uint8_t* _buffer;
+	size_t _used;
+};
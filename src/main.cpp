@@ -1,6 +1,11 @@
 #include <iostream>
 #include <memory>
+#include <cstring>
+#include <cstdio>
 #include "c64.h"
+#include "display.h"
+#include "pacer.h"
+#include "autostart.h"
 
 
 
@@ -24,9 +29,52 @@ int window_height;
 
 
 
-int main() {
-	C64 computer(Mode::PAL);
-	computer.run();
+int main(int argc, char* argv[]) {
+	bool warp = false;
+	bool trueDrive = false;
+	const char* program = nullptr;
+	const char* romDirectory = C64::DEFAULT_ROM_DIRECTORY;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--warp") == 0) {
+			warp = true;
+		} else if (strcmp(argv[i], "--autostart") == 0 && i + 1 < argc) {
+			program = argv[++i];
+		} else if (strcmp(argv[i], "--true-drive") == 0) {
+			trueDrive = true;
+		} else if (strcmp(argv[i], "--roms") == 0 && i + 1 < argc) {
+			romDirectory = argv[++i];
+		} else {
+			fprintf(stderr, "usage: c64 [--warp] [--autostart file.prg|file.d64] [--true-drive] [--roms directory]\n");
+			return 1;
+		}
+	}
+	auto roms = C64::loadRoms(romDirectory);
+	if (!roms) {
+		return 1;
+	}
+	C64 computer(Mode::PAL, roms);
+	if (program != nullptr && !(trueDrive ? loadFromDrive(computer, program) : autostart(computer, program))) {
+		return 1;
+	}
+	Display display(Mode::PAL);
+	Pacer pacer(Mode::PAL);
+	// F9 toggles warp at runtime
+	pacer.setWarp(warp);
+
+	// main loop: emulate a whole frame, present it once, then wait until the next one is due
+	while (!display.shouldClose()) {
+		computer.runFrame();
+		display.present(computer.getFrameBuffer());
+		if (display.warpToggled()) {
+			pacer.setWarp(!pacer.isWarp());
+		}
+		pacer.waitNextFrame();
+		if (pacer.speedUpdated()) {
+			char title[64];
+			snprintf(title, sizeof(title), "EM - %.0f%%%s", pacer.getSpeed(), pacer.isWarp() ? " (warp)" : "");
+			display.setTitle(title);
+		}
+	}
 
 
 
@@ -0,0 +1,262 @@
+// The 256 opcodes of the 6510, documented and undocumented.
+// OPCODE(opcode, mnemonic, address mode, length in bytes, cycles, handler)
+// This file is included twice by c64.cpp: once to fill the opcode table and once to generate
+// the cases of the switch in C64::step, so that the handlers get inlined into the dispatch loop.
+// The drive includes it for the switch in Drive1541::step. Handlers are members of Cpu6502, named through Self, the machine.
+
+OPCODE(0x00, "brk", IMPLIED, 1, 7, brk)
+OPCODE(0x01, "ora", INDEXED_INDIRECT, 2, 6, ora<2, &Self::getOperandInx>)
+OPCODE(0x02, "jam", IMPLIED, 1, 2, jam)
+OPCODE(0x03, "slo", INDEXED_INDIRECT, 2, 8, slo<2, &Self::getAddrInx>)
+OPCODE(0x04, "nop", ZEROPAGE, 2, 3, nop<2, &Self::getOperandZP>)
+OPCODE(0x05, "ora", ZEROPAGE, 2, 3, ora<2, &Self::getOperandZP>)
+OPCODE(0x06, "asl", ZEROPAGE, 2, 5, asl<2, &Self::getAddrZP>)
+OPCODE(0x07, "slo", ZEROPAGE, 2, 5, slo<2, &Self::getAddrZP>)
+OPCODE(0x08, "php", IMPLIED, 1, 3, php)
+OPCODE(0x09, "ora", IMMEDIATE, 2, 2, ora<2, &Self::getOperandImm>)
+OPCODE(0x0A, "asl", ACCUMULATOR, 1, 2, asl_acc)
+OPCODE(0x0B, "anc", IMMEDIATE, 2, 2, anc<2, &Self::getOperandImm>)
+OPCODE(0x0C, "nop", ABSOLUTE, 3, 4, nop<3, &Self::getOperandAbs>)
+OPCODE(0x0D, "ora", ABSOLUTE, 3, 4, ora<3, &Self::getOperandAbs>)
+OPCODE(0x0E, "asl", ABSOLUTE, 3, 6, asl<3, &Self::getAddrAbs>)
+OPCODE(0x0F, "slo", ABSOLUTE, 3, 6, slo<3, &Self::getAddrAbs>)
+OPCODE(0x10, "bpl", RELATIVE, 2, 2, bpl)
+OPCODE(0x11, "ora", INDIRECT_INDEXED, 2, 5, ora<2, &Self::getOperandIny>)
+OPCODE(0x12, "jam", IMPLIED, 1, 2, jam)
+OPCODE(0x13, "slo", INDIRECT_INDEXED, 2, 8, slo<2, &Self::getAddrIny>)
+OPCODE(0x14, "nop", ZEROPAGE_INDEXED, 2, 4, nop<2, &Self::getOperandZPx>)
+OPCODE(0x15, "ora", ZEROPAGE_INDEXED, 2, 4, ora<2, &Self::getOperandZPx>)
+OPCODE(0x16, "asl", ZEROPAGE_INDEXED, 2, 6, asl<2, &Self::getAddrZPx>)
+OPCODE(0x17, "slo", ZEROPAGE_INDEXED, 2, 6, slo<2, &Self::getAddrZPx>)
+OPCODE(0x18, "clc", IMPLIED, 1, 2, clc)
+OPCODE(0x19, "ora", ABSOLUTE_Y, 3, 4, ora<3, &Self::getOperandAby>)
+OPCODE(0x1A, "nop", IMPLIED, 1, 2, nop)
+OPCODE(0x1B, "slo", ABSOLUTE_Y, 3, 7, slo<3, &Self::getAddrAby>)
+OPCODE(0x1C, "nop", ABSOLUTE_X, 3, 4, nop<3, &Self::getOperandAbx>)
+OPCODE(0x1D, "ora", ABSOLUTE_X, 3, 4, ora<3, &Self::getOperandAbx>)
+OPCODE(0x1E, "asl", ABSOLUTE_X, 3, 7, asl<3, &Self::getAddrAbx>)
+OPCODE(0x1F, "slo", ABSOLUTE_X, 3, 7, slo<3, &Self::getAddrAbx>)
+OPCODE(0x20, "jsr", ABSOLUTE, 3, 6, jsr)
+OPCODE(0x21, "and", INDEXED_INDIRECT, 2, 6, _and<2, &Self::getOperandInx>)
+OPCODE(0x22, "jam", IMPLIED, 1, 2, jam)
+OPCODE(0x23, "rla", INDEXED_INDIRECT, 2, 8, rla<2, &Self::getAddrInx>)
+OPCODE(0x24, "bit", ZEROPAGE, 2, 3, bit<2, &Self::getOperandZP>)
+OPCODE(0x25, "and", ZEROPAGE, 2, 3, _and<2, &Self::getOperandZP>)
+OPCODE(0x26, "rol", ZEROPAGE, 2, 5, rol<2, &Self::getAddrZP>)
+OPCODE(0x27, "rla", ZEROPAGE, 2, 5, rla<2, &Self::getAddrZP>)
+OPCODE(0x28, "plp", IMPLIED, 1, 4, plp)
+OPCODE(0x29, "and", IMMEDIATE, 2, 2, _and<2, &Self::getOperandImm>)
+OPCODE(0x2A, "rol", ACCUMULATOR, 1, 2, rol_acc)
+OPCODE(0x2B, "anc", IMMEDIATE, 2, 2, anc<2, &Self::getOperandImm>)
+OPCODE(0x2C, "bit", ABSOLUTE, 3, 4, bit<3, &Self::getOperandAbs>)
+OPCODE(0x2D, "and", ABSOLUTE, 3, 4, _and<3, &Self::getOperandAbs>)
+OPCODE(0x2E, "rol", ABSOLUTE, 3, 6, rol<3, &Self::getAddrAbs>)
+OPCODE(0x2F, "rla", ABSOLUTE, 3, 6, rla<3, &Self::getAddrAbs>)
+OPCODE(0x30, "bmi", RELATIVE, 2, 2, bmi)
+OPCODE(0x31, "and", INDIRECT_INDEXED, 2, 5, _and<2, &Self::getOperandIny>)
+OPCODE(0x32, "jam", IMPLIED, 1, 2, jam)
+OPCODE(0x33, "rla", INDIRECT_INDEXED, 2, 8, rla<2, &Self::getAddrIny>)
+OPCODE(0x34, "nop", ZEROPAGE_INDEXED, 2, 4, nop<2, &Self::getOperandZPx>)
+OPCODE(0x35, "and", ZEROPAGE_INDEXED, 2, 4, _and<2, &Self::getOperandZPx>)
+OPCODE(0x36, "rol", ZEROPAGE_INDEXED, 2, 6, rol<2, &Self::getAddrZPx>)
+OPCODE(0x37, "rla", ZEROPAGE_INDEXED, 2, 6, rla<2, &Self::getAddrZPx>)
+OPCODE(0x38, "sec", IMPLIED, 1, 2, sec)
+OPCODE(0x39, "and", ABSOLUTE_Y, 3, 4, _and<3, &Self::getOperandAby>)
+OPCODE(0x3A, "nop", IMPLIED, 1, 2, nop)
+OPCODE(0x3B, "rla", ABSOLUTE_Y, 3, 7, rla<3, &Self::getAddrAby>)
+OPCODE(0x3C, "nop", ABSOLUTE_X, 3, 4, nop<3, &Self::getOperandAbx>)
+OPCODE(0x3D, "and", ABSOLUTE_X, 3, 4, _and<3, &Self::getOperandAbx>)
+OPCODE(0x3E, "rol", ABSOLUTE_X, 3, 7, rol<3, &Self::getAddrAbx>)
+OPCODE(0x3F, "rla", ABSOLUTE_X, 3, 7, rla<3, &Self::getAddrAbx>)
+OPCODE(0x40, "rti", IMPLIED, 1, 6, rti)
+OPCODE(0x41, "eor", INDEXED_INDIRECT, 2, 6, eor<2, &Self::getOperandInx>)
+OPCODE(0x42, "jam", IMPLIED, 1, 2, jam)
+OPCODE(0x43, "sre", INDEXED_INDIRECT, 2, 8, sre<2, &Self::getAddrInx>)
+OPCODE(0x44, "nop", ZEROPAGE, 2, 3, nop<2, &Self::getOperandZP>)
+OPCODE(0x45, "eor", ZEROPAGE, 2, 3, eor<2, &Self::getOperandZP>)
+OPCODE(0x46, "lsr", ZEROPAGE, 2, 5, lsr<2, &Self::getAddrZP>)
+OPCODE(0x47, "sre", ZEROPAGE, 2, 5, sre<2, &Self::getAddrZP>)
+OPCODE(0x48, "pha", IMPLIED, 1, 3, pha)
+OPCODE(0x49, "eor", IMMEDIATE, 2, 2, eor<2, &Self::getOperandImm>)
+OPCODE(0x4A, "lsr", ACCUMULATOR, 1, 2, lsr_acc)
+OPCODE(0x4B, "alr", IMMEDIATE, 2, 2, alr<2, &Self::getOperandImm>)
+OPCODE(0x4C, "jmp", ABSOLUTE, 3, 3, jmp_abs)
+OPCODE(0x4D, "eor", ABSOLUTE, 3, 4, eor<3, &Self::getOperandAbs>)
+OPCODE(0x4E, "lsr", ABSOLUTE, 3, 6, lsr<3, &Self::getAddrAbs>)
+OPCODE(0x4F, "sre", ABSOLUTE, 3, 6, sre<3, &Self::getAddrAbs>)
+OPCODE(0x50, "bvc", RELATIVE, 2, 2, bvc)
+OPCODE(0x51, "eor", INDIRECT_INDEXED, 2, 5, eor<2, &Self::getOperandIny>)
+OPCODE(0x52, "jam", IMPLIED, 1, 2, jam)
+OPCODE(0x53, "sre", INDIRECT_INDEXED, 2, 8, sre<2, &Self::getAddrIny>)
+OPCODE(0x54, "nop", ZEROPAGE_INDEXED, 2, 4, nop<2, &Self::getOperandZPx>)
+OPCODE(0x55, "eor", ZEROPAGE_INDEXED, 2, 4, eor<2, &Self::getOperandZPx>)
+OPCODE(0x56, "lsr", ZEROPAGE_INDEXED, 2, 6, lsr<2, &Self::getAddrZPx>)
+OPCODE(0x57, "sre", ZEROPAGE_INDEXED, 2, 6, sre<2, &Self::getAddrZPx>)
+OPCODE(0x58, "cli", IMPLIED, 1, 2, cli)
+OPCODE(0x59, "eor", ABSOLUTE_Y, 3, 4, eor<3, &Self::getOperandAby>)
+OPCODE(0x5A, "nop", IMPLIED, 1, 2, nop)
+OPCODE(0x5B, "sre", ABSOLUTE_Y, 3, 7, sre<3, &Self::getAddrAby>)
+OPCODE(0x5C, "nop", ABSOLUTE_X, 3, 4, nop<3, &Self::getOperandAbx>)
+OPCODE(0x5D, "eor", ABSOLUTE_X, 3, 4, eor<3, &Self::getOperandAbx>)
+OPCODE(0x5E, "lsr", ABSOLUTE_X, 3, 7, lsr<3, &Self::getAddrAbx>)
+OPCODE(0x5F, "sre", ABSOLUTE_X, 3, 7, sre<3, &Self::getAddrAbx>)
+OPCODE(0x60, "rts", IMPLIED, 1, 6, rts)
+OPCODE(0x61, "adc", INDEXED_INDIRECT, 2, 6, adc<2, &Self::getOperandInx>)
+OPCODE(0x62, "jam", IMPLIED, 1, 2, jam)
+OPCODE(0x63, "rra", INDEXED_INDIRECT, 2, 8, rra<2, &Self::getAddrInx>)
+OPCODE(0x64, "nop", ZEROPAGE, 2, 3, nop<2, &Self::getOperandZP>)
+OPCODE(0x65, "adc", ZEROPAGE, 2, 3, adc<2, &Self::getOperandZP>)
+OPCODE(0x66, "ror", ZEROPAGE, 2, 5, ror<2, &Self::getAddrZP>)
+OPCODE(0x67, "rra", ZEROPAGE, 2, 5, rra<2, &Self::getAddrZP>)
+OPCODE(0x68, "pla", IMPLIED, 1, 4, pla)
+OPCODE(0x69, "adc", IMMEDIATE, 2, 2, adc<2, &Self::getOperandImm>)
+OPCODE(0x6A, "ror", ACCUMULATOR, 1, 2, ror_acc)
+OPCODE(0x6B, "arr", IMMEDIATE, 2, 2, arr<2, &Self::getOperandImm>)
+OPCODE(0x6C, "jmp", INDIRECT, 3, 5, jmp_ind)
+OPCODE(0x6D, "adc", ABSOLUTE, 3, 4, adc<3, &Self::getOperandAbs>)
+OPCODE(0x6E, "ror", ABSOLUTE, 3, 6, ror<3, &Self::getAddrAbs>)
+OPCODE(0x6F, "rra", ABSOLUTE, 3, 6, rra<3, &Self::getAddrAbs>)
+OPCODE(0x70, "bvs", RELATIVE, 2, 2, bvs)
+OPCODE(0x71, "adc", INDIRECT_INDEXED, 2, 5, adc<2, &Self::getOperandIny>)
+OPCODE(0x72, "jam", IMPLIED, 1, 2, jam)
+OPCODE(0x73, "rra", INDIRECT_INDEXED, 2, 8, rra<2, &Self::getAddrIny>)
+OPCODE(0x74, "nop", ZEROPAGE_INDEXED, 2, 4, nop<2, &Self::getOperandZPx>)
+OPCODE(0x75, "adc", ZEROPAGE_INDEXED, 2, 4, adc<2, &Self::getOperandZPx>)
+OPCODE(0x76, "ror", ZEROPAGE_INDEXED, 2, 6, ror<2, &Self::getAddrZPx>)
+OPCODE(0x77, "rra", ZEROPAGE_INDEXED, 2, 6, rra<2, &Self::getAddrZPx>)
+OPCODE(0x78, "sei", IMPLIED, 1, 2, sei)
+OPCODE(0x79, "adc", ABSOLUTE_Y, 3, 4, adc<3, &Self::getOperandAby>)
+OPCODE(0x7A, "nop", IMPLIED, 1, 2, nop)
+OPCODE(0x7B, "rra", ABSOLUTE_Y, 3, 7, rra<3, &Self::getAddrAby>)
+OPCODE(0x7C, "nop", ABSOLUTE_X, 3, 4, nop<3, &Self::getOperandAbx>)
+OPCODE(0x7D, "adc", ABSOLUTE_X, 3, 4, adc<3, &Self::getOperandAbx>)
+OPCODE(0x7E, "ror", ABSOLUTE_X, 3, 7, ror<3, &Self::getAddrAbx>)
+OPCODE(0x7F, "rra", ABSOLUTE_X, 3, 7, rra<3, &Self::getAddrAbx>)
+OPCODE(0x80, "nop", IMMEDIATE, 2, 2, nop<2, &Self::getOperandImm>)
+OPCODE(0x81, "sta", INDEXED_INDIRECT, 2, 6, sta<2, &Self::getAddrInx>)
+OPCODE(0x82, "nop", IMMEDIATE, 2, 2, nop<2, &Self::getOperandImm>)
+OPCODE(0x83, "sax", INDEXED_INDIRECT, 2, 6, sax<2, &Self::getAddrInx>)
+OPCODE(0x84, "sty", ZEROPAGE, 2, 3, sty<2, &Self::getAddrZP>)
+OPCODE(0x85, "sta", ZEROPAGE, 2, 3, sta<2, &Self::getAddrZP>)
+OPCODE(0x86, "stx", ZEROPAGE, 2, 3, stx<2, &Self::getAddrZP>)
+OPCODE(0x87, "sax", ZEROPAGE, 2, 3, sax<2, &Self::getAddrZP>)
+OPCODE(0x88, "dey", IMPLIED, 1, 2, dey)
+OPCODE(0x89, "nop", IMMEDIATE, 2, 2, nop<2, &Self::getOperandImm>)
+OPCODE(0x8A, "txa", IMPLIED, 1, 2, txa)
+OPCODE(0x8B, "ane", IMMEDIATE, 2, 2, ane<2, &Self::getOperandImm>)
+OPCODE(0x8C, "sty", ABSOLUTE, 3, 4, sty<3, &Self::getAddrAbs>)
+OPCODE(0x8D, "sta", ABSOLUTE, 3, 4, sta<3, &Self::getAddrAbs>)
+OPCODE(0x8E, "stx", ABSOLUTE, 3, 4, stx<3, &Self::getAddrAbs>)
+OPCODE(0x8F, "sax", ABSOLUTE, 3, 4, sax<3, &Self::getAddrAbs>)
+OPCODE(0x90, "bcc", RELATIVE, 2, 2, bcc)
+OPCODE(0x91, "sta", INDIRECT_INDEXED, 2, 6, sta<2, &Self::getAddrIny>)
+OPCODE(0x92, "jam", IMPLIED, 1, 2, jam)
+OPCODE(0x93, "sha", INDIRECT_INDEXED, 2, 6, sha_iny)
+OPCODE(0x94, "sty", ZEROPAGE_INDEXED, 2, 4, sty<2, &Self::getAddrZPx>)
+OPCODE(0x95, "sta", ZEROPAGE_INDEXED, 2, 4, sta<2, &Self::getAddrZPx>)
+OPCODE(0x96, "stx", ZEROPAGE_Y, 2, 4, stx<2, &Self::getAddrZPy>)
+OPCODE(0x97, "sax", ZEROPAGE_Y, 2, 4, sax<2, &Self::getAddrZPy>)
+OPCODE(0x98, "tya", IMPLIED, 1, 2, tya)
+OPCODE(0x99, "sta", ABSOLUTE_Y, 3, 5, sta<3, &Self::getAddrAby>)
+OPCODE(0x9A, "txs", IMPLIED, 1, 2, txs)
+OPCODE(0x9B, "tas", ABSOLUTE_Y, 3, 5, tas)
+OPCODE(0x9C, "shy", ABSOLUTE_X, 3, 5, shy)
+OPCODE(0x9D, "sta", ABSOLUTE_X, 3, 5, sta<3, &Self::getAddrAbx>)
+OPCODE(0x9E, "shx", ABSOLUTE_Y, 3, 5, shx)
+OPCODE(0x9F, "sha", ABSOLUTE_Y, 3, 5, sha_aby)
+OPCODE(0xA0, "ldy", IMMEDIATE, 2, 2, ldy<2, &Self::getOperandImm>)
+OPCODE(0xA1, "lda", INDEXED_INDIRECT, 2, 6, lda<2, &Self::getOperandInx>)
+OPCODE(0xA2, "ldx", IMMEDIATE, 2, 2, ldx<2, &Self::getOperandImm>)
+OPCODE(0xA3, "lax", INDEXED_INDIRECT, 2, 6, lax<2, &Self::getOperandInx>)
+OPCODE(0xA4, "ldy", ZEROPAGE, 2, 3, ldy<2, &Self::getOperandZP>)
+OPCODE(0xA5, "lda", ZEROPAGE, 2, 3, lda<2, &Self::getOperandZP>)
+OPCODE(0xA6, "ldx", ZEROPAGE, 2, 3, ldx<2, &Self::getOperandZP>)
+OPCODE(0xA7, "lax", ZEROPAGE, 2, 3, lax<2, &Self::getOperandZP>)
+OPCODE(0xA8, "tay", IMPLIED, 1, 2, tay)
+OPCODE(0xA9, "lda", IMMEDIATE, 2, 2, lda<2, &Self::getOperandImm>)
+OPCODE(0xAA, "tax", IMPLIED, 1, 2, tax)
+OPCODE(0xAB, "lxa", IMMEDIATE, 2, 2, lxa<2, &Self::getOperandImm>)
+OPCODE(0xAC, "ldy", ABSOLUTE, 3, 4, ldy<3, &Self::getOperandAbs>)
+OPCODE(0xAD, "lda", ABSOLUTE, 3, 4, lda<3, &Self::getOperandAbs>)
+OPCODE(0xAE, "ldx", ABSOLUTE, 3, 4, ldx<3, &Self::getOperandAbs>)
+OPCODE(0xAF, "lax", ABSOLUTE, 3, 4, lax<3, &Self::getOperandAbs>)
+OPCODE(0xB0, "bcs", RELATIVE, 2, 2, bcs)
+OPCODE(0xB1, "lda", INDIRECT_INDEXED, 2, 5, lda<2, &Self::getOperandIny>)
+OPCODE(0xB2, "jam", IMPLIED, 1, 2, jam)
+OPCODE(0xB3, "lax", INDIRECT_INDEXED, 2, 5, lax<2, &Self::getOperandIny>)
+OPCODE(0xB4, "ldy", ZEROPAGE_INDEXED, 2, 4, ldy<2, &Self::getOperandZPx>)
+OPCODE(0xB5, "lda", ZEROPAGE_INDEXED, 2, 4, lda<2, &Self::getOperandZPx>)
+OPCODE(0xB6, "ldx", ZEROPAGE_Y, 2, 4, ldx<2, &Self::getOperandZPy>)
+OPCODE(0xB7, "lax", ZEROPAGE_Y, 2, 4, lax<2, &Self::getOperandZPy>)
+OPCODE(0xB8, "clv", IMPLIED, 1, 2, clv)
+OPCODE(0xB9, "lda", ABSOLUTE_Y, 3, 4, lda<3, &Self::getOperandAby>)
+OPCODE(0xBA, "tsx", IMPLIED, 1, 2, tsx)
+OPCODE(0xBB, "las", ABSOLUTE_Y, 3, 4, las<3, &Self::getOperandAby>)
+OPCODE(0xBC, "ldy", ABSOLUTE_X, 3, 4, ldy<3, &Self::getOperandAbx>)
+OPCODE(0xBD, "lda", ABSOLUTE_X, 3, 4, lda<3, &Self::getOperandAbx>)
+OPCODE(0xBE, "ldx", ABSOLUTE_Y, 3, 4, ldx<3, &Self::getOperandAby>)
+OPCODE(0xBF, "lax", ABSOLUTE_Y, 3, 4, lax<3, &Self::getOperandAby>)
+OPCODE(0xC0, "cpy", IMMEDIATE, 2, 2, cpy<2, &Self::getOperandImm>)
+OPCODE(0xC1, "cmp", INDEXED_INDIRECT, 2, 6, cmp<2, &Self::getOperandInx>)
+OPCODE(0xC2, "nop", IMMEDIATE, 2, 2, nop<2, &Self::getOperandImm>)
+OPCODE(0xC3, "dcp", INDEXED_INDIRECT, 2, 8, dcp<2, &Self::getAddrInx>)
+OPCODE(0xC4, "cpy", ZEROPAGE, 2, 3, cpy<2, &Self::getOperandZP>)
+OPCODE(0xC5, "cmp", ZEROPAGE, 2, 3, cmp<2, &Self::getOperandZP>)
+OPCODE(0xC6, "dec", ZEROPAGE, 2, 5, dec<2, &Self::getAddrZP>)
+OPCODE(0xC7, "dcp", ZEROPAGE, 2, 5, dcp<2, &Self::getAddrZP>)
+OPCODE(0xC8, "iny", IMPLIED, 1, 2, iny)
+OPCODE(0xC9, "cmp", IMMEDIATE, 2, 2, cmp<2, &Self::getOperandImm>)
+OPCODE(0xCA, "dex", IMPLIED, 1, 2, dex)
+OPCODE(0xCB, "sbx", IMMEDIATE, 2, 2, sbx<2, &Self::getOperandImm>)
+OPCODE(0xCC, "cpy", ABSOLUTE, 3, 4, cpy<3, &Self::getOperandAbs>)
+OPCODE(0xCD, "cmp", ABSOLUTE, 3, 4, cmp<3, &Self::getOperandAbs>)
+OPCODE(0xCE, "dec", ABSOLUTE, 3, 6, dec<3, &Self::getAddrAbs>)
+OPCODE(0xCF, "dcp", ABSOLUTE, 3, 6, dcp<3, &Self::getAddrAbs>)
+OPCODE(0xD0, "bne", RELATIVE, 2, 2, bne)
+OPCODE(0xD1, "cmp", INDIRECT_INDEXED, 2, 5, cmp<2, &Self::getOperandIny>)
+OPCODE(0xD2, "jam", IMPLIED, 1, 2, jam)
+OPCODE(0xD3, "dcp", INDIRECT_INDEXED, 2, 8, dcp<2, &Self::getAddrIny>)
+OPCODE(0xD4, "nop", ZEROPAGE_INDEXED, 2, 4, nop<2, &Self::getOperandZPx>)
+OPCODE(0xD5, "cmp", ZEROPAGE_INDEXED, 2, 4, cmp<2, &Self::getOperandZPx>)
+OPCODE(0xD6, "dec", ZEROPAGE_INDEXED, 2, 6, dec<2, &Self::getAddrZPx>)
+OPCODE(0xD7, "dcp", ZEROPAGE_INDEXED, 2, 6, dcp<2, &Self::getAddrZPx>)
+OPCODE(0xD8, "cld", IMPLIED, 1, 2, cld)
+OPCODE(0xD9, "cmp", ABSOLUTE_Y, 3, 4, cmp<3, &Self::getOperandAby>)
+OPCODE(0xDA, "nop", IMPLIED, 1, 2, nop)
+OPCODE(0xDB, "dcp", ABSOLUTE_Y, 3, 7, dcp<3, &Self::getAddrAby>)
+OPCODE(0xDC, "nop", ABSOLUTE_X, 3, 4, nop<3, &Self::getOperandAbx>)
+OPCODE(0xDD, "cmp", ABSOLUTE_X, 3, 4, cmp<3, &Self::getOperandAbx>)
+OPCODE(0xDE, "dec", ABSOLUTE_X, 3, 7, dec<3, &Self::getAddrAbx>)
+OPCODE(0xDF, "dcp", ABSOLUTE_X, 3, 7, dcp<3, &Self::getAddrAbx>)
+OPCODE(0xE0, "cpx", IMMEDIATE, 2, 2, cpx<2, &Self::getOperandImm>)
+OPCODE(0xE1, "sbc", INDEXED_INDIRECT, 2, 6, sbc<2, &Self::getOperandInx>)
+OPCODE(0xE2, "nop", IMMEDIATE, 2, 2, nop<2, &Self::getOperandImm>)
+OPCODE(0xE3, "isc", INDEXED_INDIRECT, 2, 8, isc<2, &Self::getAddrInx>)
+OPCODE(0xE4, "cpx", ZEROPAGE, 2, 3, cpx<2, &Self::getOperandZP>)
+OPCODE(0xE5, "sbc", ZEROPAGE, 2, 3, sbc<2, &Self::getOperandZP>)
+OPCODE(0xE6, "inc", ZEROPAGE, 2, 5, inc<2, &Self::getAddrZP>)
+OPCODE(0xE7, "isc", ZEROPAGE, 2, 5, isc<2, &Self::getAddrZP>)
+OPCODE(0xE8, "inx", IMPLIED, 1, 2, inx)
+OPCODE(0xE9, "sbc", IMMEDIATE, 2, 2, sbc<2, &Self::getOperandImm>)
+OPCODE(0xEA, "nop", IMPLIED, 1, 2, nop)
+OPCODE(0xEB, "sbc", IMMEDIATE, 2, 2, sbc<2, &Self::getOperandImm>)
+OPCODE(0xEC, "cpx", ABSOLUTE, 3, 4, cpx<3, &Self::getOperandAbs>)
+OPCODE(0xED, "sbc", ABSOLUTE, 3, 4, sbc<3, &Self::getOperandAbs>)
+OPCODE(0xEE, "inc", ABSOLUTE, 3, 6, inc<3, &Self::getAddrAbs>)
+OPCODE(0xEF, "isc", ABSOLUTE, 3, 6, isc<3, &Self::getAddrAbs>)
+OPCODE(0xF0, "beq", RELATIVE, 2, 2, beq)
+OPCODE(0xF1, "sbc", INDIRECT_INDEXED, 2, 5, sbc<2, &Self::getOperandIny>)
+OPCODE(0xF2, "jam", IMPLIED, 1, 2, jam)
+OPCODE(0xF3, "isc", INDIRECT_INDEXED, 2, 8, isc<2, &Self::getAddrIny>)
+OPCODE(0xF4, "nop", ZEROPAGE_INDEXED, 2, 4, nop<2, &Self::getOperandZPx>)
+OPCODE(0xF5, "sbc", ZEROPAGE_INDEXED, 2, 4, sbc<2, &Self::getOperandZPx>)
+OPCODE(0xF6, "inc", ZEROPAGE_INDEXED, 2, 6, inc<2, &Self::getAddrZPx>)
+OPCODE(0xF7, "isc", ZEROPAGE_INDEXED, 2, 6, isc<2, &Self::getAddrZPx>)
+OPCODE(0xF8, "sed", IMPLIED, 1, 2, sed)
+OPCODE(0xF9, "sbc", ABSOLUTE_Y, 3, 4, sbc<3, &Self::getOperandAby>)
+OPCODE(0xFA, "nop", IMPLIED, 1, 2, nop)
+OPCODE(0xFB, "isc", ABSOLUTE_Y, 3, 7, isc<3, &Self::getAddrAby>)
+OPCODE(0xFC, "nop", ABSOLUTE_X, 3, 4, nop<3, &Self::getOperandAbx>)
+OPCODE(0xFD, "sbc", ABSOLUTE_X, 3, 4, sbc<3, &Self::getOperandAbx>)
+OPCODE(0xFE, "inc", ABSOLUTE_X, 3, 7, inc<3, &Self::getAddrAbx>)
+OPCODE(0xFF, "isc", ABSOLUTE_X, 3, 7, isc<3, &Self::getAddrAbx>)
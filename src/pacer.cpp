@@ -0,0 +1,75 @@
+#include "pacer.h"
+#include <thread>
+#include <algorithm>
+
+namespace {
+	const auto MIN_SPIN_MARGIN = std::chrono::microseconds(200);
+	const auto MAX_SPIN_MARGIN = std::chrono::milliseconds(4);
+	// further behind than this and we give up catching up, to avoid running a burst of frames
+	const int MAX_LATE_FRAMES = 3;
+}
+
+Pacer::Pacer(Mode mode) : _spinMargin(std::chrono::milliseconds(1)), _warp(false), _measureFrames(0), _speed(0.0),
+	_speedUpdated(false) {
+	auto m = static_cast<int>(mode);
+	std::chrono::duration<double> period(NUMBER_OF_LINES[m] * CYCLES_PER_LINE[m] / CLOCK_FREQUENCY[m]);
+	_framePeriod = std::chrono::duration_cast<Clock::duration>(period);
+	_nextFrame = Clock::now() + _framePeriod;
+	_measureStart = Clock::now();
+}
+
+void Pacer::setWarp(bool warp) {
+	if (_warp && !warp) {
+		// resume pacing from now instead of trying to match the time spent in warp
+		_nextFrame = Clock::now() + _framePeriod;
+	}
+	_warp = warp;
+}
+
+void Pacer::waitNextFrame() {
+	auto now = Clock::now();
+	if (!_warp) {
+		if (now < _nextFrame) {
+			auto wakeUp = _nextFrame - _spinMargin;
+			if (now < wakeUp) {
+				std::this_thread::sleep_until(wakeUp);
+				now = Clock::now();
+				// adapt the margin to the oversleep we just observed
+				auto overslept = now - wakeUp;
+				if (overslept > _spinMargin / 2) {
+					_spinMargin = std::min<Clock::duration>(_spinMargin * 2, MAX_SPIN_MARGIN);
+				} else {
+					_spinMargin = std::max<Clock::duration>(_spinMargin - _spinMargin / 16, MIN_SPIN_MARGIN);
+				}
+			}
+			while (now < _nextFrame) {
+				std::this_thread::yield();
+				now = Clock::now();
+			}
+		}
+		_nextFrame += _framePeriod;
+		if (now - _nextFrame > _framePeriod * MAX_LATE_FRAMES) {
+			_nextFrame = now + _framePeriod;
+		}
+	}
+	++_measureFrames;
+	measure(now);
+}
+
+bool Pacer::speedUpdated() {
+	bool updated = _speedUpdated;
+	_speedUpdated = false;
+	return updated;
+}
+
+void Pacer::measure(Clock::time_point now) {
+	auto elapsed = now - _measureStart;
+	if (elapsed < std::chrono::seconds(1)) {
+		return;
+	}
+	std::chrono::duration<double> emulated = _framePeriod * _measureFrames;
+	_speed = 100.0 * emulated / elapsed;
+	_speedUpdated = true;
+	_measureStart = now;
+	_measureFrames = 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include "settings.h"
+
+// Keeps the emulation in step with the real machine: after each frame waitNextFrame() blocks until
+// the frame is due (50.125 Hz PAL, 59.826 Hz NTSC). It sleeps for most of the wait and spins for the
+// last stretch, whose length adapts to how late the OS wakes the thread up. In warp mode it does not
+// wait at all.
+class Pacer {
+public:
+	explicit Pacer(Mode mode);
+	void waitNextFrame();
+	void setWarp(bool warp);
+	bool isWarp() const;
+	// emulated time over wall time in percent, measured over the last second
+	double getSpeed() const;
+	// true once per second, when getSpeed has been updated
+	bool speedUpdated();
+private:
+	using Clock = std::chrono::steady_clock;
+	void measure(Clock::time_point now);
+	Clock::duration _framePeriod;
+	Clock::time_point _nextFrame;
+	// time left to spin after sleeping, grows when the OS oversleeps and slowly shrinks back
+	Clock::duration _spinMargin;
+	bool _warp;
+	// speed measurement
+	Clock::time_point _measureStart;
+	long _measureFrames;
+	double _speed;
+	bool _speedUpdated;
+};
+
+inline bool Pacer::isWarp() const {
+	return _warp;
+}
+
+inline double Pacer::getSpeed() const {
+	return _speed;
+}
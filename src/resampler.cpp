@@ -0,0 +1,165 @@
+#include "resampler.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+	// stopband attenuation of both stages, in dB
+	const double ATTENUATION = 80.0;
+	const double PASSBAND = 0.45;
+
+	// zeroth order modified Bessel function of the first kind, for the Kaiser window
+	double bessel0(double x) {
+		double sum = 1.0;
+		double term = 1.0;
+		for (int k = 1; k < 50; ++k) {
+			term *= (x / (2 * k)) * (x / (2 * k));
+			sum += term;
+			if (term < sum * 1e-12) {
+				break;
+			}
+		}
+		return sum;
+	}
+
+	// Kaiser window length and beta for a transition band of the given width, relative to the sampling rate
+	int kaiserLength(double transition) {
+		return static_cast<int>(std::ceil((ATTENUATION - 7.95) / (2.285 * 2 * M_PI * transition))) + 1;
+	}
+
+	double kaiserBeta() {
+		return 0.1102 * (ATTENUATION - 8.7);
+	}
+
+	// lowpass impulse response at time t (in samples, 0 at the center), cutoff relative to the sampling rate
+	double windowedSinc(double t, double cutoff, double halfLength) {
+		double x = t / halfLength;
+		if (x <= -1.0 || x >= 1.0) {
+			return 0.0;
+		}
+		double window = bessel0(kaiserBeta() * std::sqrt(1.0 - x * x)) / bessel0(kaiserBeta());
+		double phase = 2 * M_PI * cutoff * t;
+		return window * 2 * cutoff * (t == 0.0 ? 1.0 : std::sin(phase) / phase);
+	}
+
+	int roundUp4(int n) {
+		return (n + 3) & ~3;
+	}
+
+	float dot(const float* a, const float* b, int count) {
+#ifdef __SSE2__
+		__m128 sum = _mm_setzero_ps();
+		for (int i = 0; i < count; i += 4) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		}
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+		return _mm_cvtss_f32(sum);
+#else
+		float sum = 0;
+		for (int i = 0; i < count; ++i) {
+			sum += a[i] * b[i];
+		}
+		return sum;
+#endif
+	}
+}
+
+Resampler::Resampler(double inputRate, double outputRate) : _filters(design(inputRate, outputRate)), _next2(0) {
+	// start with silent history
+	_input1.assign(_filters->taps1.size() - 1, 0.0f);
+	_next1 = _input1.size();
+	_input2.assign(_filters->length2, 0.0f);
+	_next2 = _filters->length2 - 1;
+}
+
+std::shared_ptr<const Resampler::Filters> Resampler::design(double inputRate, double outputRate) {
+	// every SID of a run resamples between the same rates, and designing takes a millisecond
+	struct Design {
+		double inputRate;
+		double outputRate;
+		std::shared_ptr<const Filters> filters;
+	};
+	static std::mutex mutex;
+	static std::vector<Design> designs;
+	std::lock_guard<std::mutex> lock(mutex);
+	for (const auto& d : designs) {
+		if (d.inputRate == inputRate && d.outputRate == outputRate) {
+			return d.filters;
+		}
+	}
+	auto filters = std::make_shared<Filters>();
+	double passband = PASSBAND * outputRate;
+	// stage 1 brings the rate down to at least 2.5 times the output rate. It must remove what would
+	// alias into the passband: anything within passband of a multiple of its output rate.
+	filters->decimation = std::max(1, static_cast<int>(inputRate / (2.5 * outputRate)));
+	double midRate = inputRate / filters->decimation;
+	double stop1 = midRate - passband;
+	filters->length1 = kaiserLength((stop1 - passband) / inputRate);
+	filters->taps1.assign(roundUp4(filters->length1), 0.0f);
+	double sum = 0;
+	for (int i = 0; i < filters->length1; ++i) {
+		double t = i - (filters->length1 - 1) / 2.0;
+		filters->taps1[i] = windowedSinc(t, (passband + stop1) / 2 / inputRate, filters->length1 / 2.0);
+		sum += filters->taps1[i];
+	}
+	for (auto& tap : filters->taps1) {
+		tap /= sum;
+	}
+
+	// stage 2 leaves some aliasing above the passband, folded from below outputRate - passband
+	double stop2 = outputRate - passband;
+	double cutoff2 = (passband + stop2) / 2 / midRate;
+	int length2 = roundUp4(kaiserLength((stop2 - passband) / midRate));
+	filters->length2 = length2;
+	filters->taps2.assign((PHASES + 1) * length2, 0.0f);
+	for (int phase = 0; phase <= PHASES; ++phase) {
+		// row phase is the filter for an output between two input samples, phase / PHASES past the older one
+		float* row = &filters->taps2[phase * length2];
+		double rowSum = 0;
+		for (int i = 0; i < length2; ++i) {
+			double t = i - (length2 - 1) / 2.0 - static_cast<double>(phase) / PHASES;
+			row[i] = windowedSinc(t, cutoff2, length2 / 2.0);
+			rowSum += row[i];
+		}
+		for (int i = 0; i < length2; ++i) {
+			row[i] /= rowSum;
+		}
+	}
+	filters->step2 = midRate / outputRate;
+	designs.push_back({inputRate, outputRate, filters});
+	return filters;
+}
+
+void Resampler::process(const float* input, int count, std::vector<float>& out) {
+	const Filters& filters = *_filters;
+	_input1.insert(_input1.end(), input, input + count);
+	size_t taps1 = filters.taps1.size();
+	for (; _next1 < _input1.size(); _next1 += filters.decimation) {
+		_input2.push_back(dot(&_input1[_next1 + 1 - taps1], filters.taps1.data(), taps1));
+	}
+	// keep the history the next outputs need
+	size_t consumed1 = _next1 + 1 - taps1;
+	_input1.erase(_input1.begin(), _input1.begin() + consumed1);
+	_next1 -= consumed1;
+
+	int length2 = filters.length2;
+	while (_next2 < _input2.size() - 1) {
+		// interpolate between the phases on each side of the output time
+		size_t newest = static_cast<size_t>(_next2);
+		double position = (_next2 - newest) * PHASES;
+		int phase = static_cast<int>(position);
+		float weight = static_cast<float>(position - phase);
+		const float* window = &_input2[newest + 1 - length2];
+		float a = dot(window, &filters.taps2[phase * length2], length2);
+		float b = dot(window, &filters.taps2[(phase + 1) * length2], length2);
+		out.push_back(a + (b - a) * weight);
+		_next2 += filters.step2;
+	}
+	size_t consumed2 = static_cast<size_t>(_next2) + 1 - length2;
+	_input2.erase(_input2.begin(), _input2.begin() + consumed2);
+	_next2 -= consumed2;
+}
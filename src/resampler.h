@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Brings the SID output from the clock rate (about 1 MHz) down to the audio rate in two stages of
+// windowed sinc FIR filters. The first decimates by an integer factor to a few times the output rate,
+// only computing the samples it keeps. The second is a polyphase filter for the remaining fractional
+// ratio: the prototype filter is tabulated at PHASES sub-sample offsets and each output sample
+// interpolates between the two nearest phases. Both stages pass everything below 45% of the output rate.
+class Resampler {
+public:
+	Resampler(double inputRate, double outputRate);
+	// filter a block of input samples, appending the output samples it completes to out
+	void process(const float* input, int count, std::vector<float>& out);
+private:
+	static constexpr int PHASES = 64;
+	// the filters only depend on the two rates, resamplers between the same rates share them
+	struct Filters {
+		int decimation;
+		// taps, padded with zeros to a multiple of 4
+		std::vector<float> taps1;
+		int length1;
+		// PHASES + 1 rows of length2 taps, in reverse order so that they line up with the input
+		std::vector<float> taps2;
+		int length2;
+		double step2;               // stage 2 input samples per output sample
+	};
+	static std::shared_ptr<const Filters> design(double inputRate, double outputRate);
+	std::shared_ptr<const Filters> _filters;
+	// pending input of each stage: the filter history followed by new samples
+	std::vector<float> _input1;
+	std::vector<float> _input2;
+	size_t _next1;              // position in _input1 of the newest sample of the next stage 1 output
+	double _next2;              // position in _input2 of the next output sample
+};
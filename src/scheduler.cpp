@@ -0,0 +1,83 @@
+#include "scheduler.h"
+#include <algorithm>
+#include "snapshot.h"
+
+namespace {
+	// std heap functions build a max-heap, so the comparison is reversed
+	struct Later {
+		template<typename Entry>
+		bool operator()(const Entry& a, const Entry& b) const {
+			return a.cycle > b.cycle;
+		}
+	};
+}
+
+Scheduler::Scheduler() : _next(NEVER) {
+	std::fill(std::begin(_due), std::end(_due), NEVER);
+}
+
+void Scheduler::schedule(long cycle, Event event) {
+	_due[static_cast<int>(event)] = cycle;
+	push({cycle, event});
+	discardStale();
+}
+
+void Scheduler::cancel(Event event) {
+	_due[static_cast<int>(event)] = NEVER;
+	discardStale();
+}
+
+bool Scheduler::pop(long cycle, Event& event) {
+	if (_next > cycle) {
+		return false;
+	}
+	event = _heap.front().event;
+	_due[static_cast<int>(event)] = NEVER;
+	std::pop_heap(_heap.begin(), _heap.end(), Later());
+	_heap.pop_back();
+	discardStale();
+	return true;
+}
+
+void Scheduler::push(Entry entry) {
+	// superseded entries only leave the heap when they reach the top: rebuild it if they pile up
+	if (_heap.size() >= 4 * static_cast<int>(Event::COUNT)) {
+		_heap.clear();
+		for (int i = 0; i < static_cast<int>(Event::COUNT); ++i) {
+			if (_due[i] != NEVER && i != static_cast<int>(entry.event)) {
+				_heap.push_back({_due[i], static_cast<Event>(i)});
+			}
+		}
+		std::make_heap(_heap.begin(), _heap.end(), Later());
+	}
+	_heap.push_back(entry);
+	std::push_heap(_heap.begin(), _heap.end(), Later());
+}
+
+void Scheduler::discardStale() {
+	while (!_heap.empty() && _heap.front().cycle != _due[static_cast<int>(_heap.front().event)]) {
+		std::pop_heap(_heap.begin(), _heap.end(), Later());
+		_heap.pop_back();
+	}
+	_next = _heap.empty() ? NEVER : _heap.front().cycle;
+}
+
+void Scheduler::save(SnapshotWriter& out) const {
+	out.put32(static_cast<uint32_t>(Event::COUNT));
+	for (long due : _due) {
+		out.put64(due);
+	}
+}
+
+void Scheduler::load(SnapshotReader& in) {
+	in.get32();
+	_heap.clear();
+	for (int i = 0; i < static_cast<int>(Event::COUNT); ++i) {
+		_due[i] = static_cast<long>(in.get64());
+		if (_due[i] != NEVER) {
+			_heap.push_back({_due[i], static_cast<Event>(i)});
+		}
+	}
+	std::make_heap(_heap.begin(), _heap.end(), Later());
+	discardStale();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <climits>
+#include <vector>
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// things that happen at a given clock cycle, independently of the instruction stream
+enum class Event {
+	FRAME_END,          // runFrame has consumed a frame worth of cycles
+	INTERRUPT,          // an IRQ or NMI may have to be taken at the next instruction boundary
+	RASTER_IRQ,         // the VIC-II raster reaches the raster compare line
+	BADLINE,            // the VIC-II reads a character row and stalls the CPU
+	CIA1_TIMER_A,       // timer underflows of the two CIAs
+	CIA1_TIMER_B,
+	CIA2_TIMER_A,
+	CIA2_TIMER_B,
+	CIA1_TOD,           // a power line cycle, which clocks the time of day
+	CIA2_TOD,
+	DRIVE_SYNC,         // let the drive thread run up to the current cycle
+	VIA1_TIMER_1,       // 1541 events, on the drive's own clock: timer underflows of the two VIAs
+	VIA1_TIMER_2,
+	VIA2_TIMER_1,
+	VIA2_TIMER_2,
+	DISK_BYTE,          // a byte passes under the read/write head
+	COUNT
+};
+
+// Cycle-stamped event queue, a binary min-heap. Each kind of event is pending at most once:
+// scheduling it again moves it, and the superseded heap entry is dropped when it surfaces.
+// The CPU loop only compares the clock against next().
+class Scheduler {
+public:
+	static constexpr long NEVER = LONG_MAX;
+	Scheduler();
+	void schedule(long cycle, Event event);
+	void cancel(Event event);
+	// cycle of the earliest pending event, NEVER when there is none
+	long next() const;
+	// remove the earliest event if it is due by the given cycle
+	bool pop(long cycle, Event& event);
+	// the pending events and their cycles
+	void save(SnapshotWriter& out) const;
+	void load(SnapshotReader& in);
+private:
+	struct Entry {
+		long cycle;
+		Event event;
+	};
+	void push(Entry entry);
+	// drop superseded entries from the top and update _next
+	void discardStale();
+	std::vector<Entry> _heap;
+	long _due[static_cast<int>(Event::COUNT)];
+	long _next;
+};
+
+inline long Scheduler::next() const {
+	return _next;
+}
@@ -0,0 +1,17 @@
+#include "screenshot.h"
+#include <fstream>
+#include "c64.h"
+
+bool saveScreenshot(const std::string& filename, const C64& computer) {
+	std::ofstream os(filename, std::ios::binary);
+	if (!os) {
+		return false;
+	}
+	int pixels = computer.getFrameWidth() * computer.getFrameHeight();
+	os << "P6\n" << computer.getFrameWidth() << " " << computer.getFrameHeight() << "\n255\n";
+	const uint8_t* frame = computer.getFrameBuffer();
+	for (int i = 0; i < pixels; ++i) {
+		os.write(reinterpret_cast<const char*>(PALETTE[frame[i] & 0x0F]), 3);
+	}
+	return static_cast<bool>(os);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+class C64;
+
+// Writes the visible area of the last frame as a binary PPM image, false if the file can't be written.
+bool saveScreenshot(const std::string& filename, const C64& computer);
@@ -9,4 +9,19 @@ int settings::visible_height;
 int settings::window_width;
 int settings::window_height;
 
-Mode settings::mode;
\ No newline at end of file
+Mode settings::mode;
+
+void settings::setMode(Mode m) {
+	mode = m;
+	if (m == Mode::PAL) {
+		width = PAL_SCREEN_WIDTH;
+		height = PAL_SCREEN_HEIGHT;
+		visible_width = PAL_VISIBLE_WIDTH;
+		visible_height = PAL_VISIBLE_HEIGHT;
+	} else {
+		width = NTSC_SCREEN_WIDTH;
+		height = NTSC_SCREEN_HEIGHT;
+		visible_width = NTSC_VISIBLE_WIDTH;
+		visible_height = NTSC_VISIBLE_HEIGHT;
+	}
+}
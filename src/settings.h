@@ -4,6 +4,12 @@ enum class Mode {
 	PAL, NTSC
 };
 
+// timing of each video standard, indexed by Mode
+inline const int NUMBER_OF_LINES[2] = {312, 263};
+inline const int CYCLES_PER_LINE[2] = {63, 65};
+
+inline const double CLOCK_FREQUENCY[2] = {0.9852486e6, 1.0227273e6};
+
 
 namespace settings {
 	const int PAL_SCREEN_HEIGHT = 312;
@@ -12,6 +18,8 @@ namespace settings {
 	const int NTSC_SCREEN_WIDTH = 520;
 	const int PAL_VISIBLE_WIDTH = 384;
 	const int PAL_VISIBLE_HEIGHT = 272;
+	const int NTSC_VISIBLE_WIDTH = 384;
+	const int NTSC_VISIBLE_HEIGHT = 247;
 	extern int width;
 	extern int height;
 	extern int visible_width;
@@ -19,5 +27,7 @@ namespace settings {
 	extern int window_width;
 	extern int window_height;
 	extern Mode mode;
+	// set the screen geometry for the given video standard
+	void setMode(Mode);
 
 };
\ No newline at end of file
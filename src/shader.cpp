@@ -1,5 +1,6 @@
 #include "shader.h"
 #include <iostream>
+#include <cstring>
 #include "settings.h"
 
 
@@ -131,52 +132,97 @@ void BlitShader::init() {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void MainShader::setPixel(int x, int y, int color) {
-	if (x < _x0 || x >= _x1 || y < _y0 || y > _y1) return;
-	_data[(y - _y0) * settings::visible_width + (x - _x0)].color = color;
+MainShader::~MainShader() {
+	for (auto fence : _fence) {
+		if (fence != nullptr) {
+			glDeleteSync(fence);
+		}
+	}
+	if (_mapped != nullptr) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbo);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+	glDeleteBuffers(1, &_pbo);
+	glDeleteTextures(1, &_frameTexture);
+	glDeleteTextures(1, &_texture);
+	glDeleteBuffers(1, &_vbo);
+	glDeleteVertexArrays(1, &_vao);
+}
+
+void MainShader::update(const uint8_t* frame) {
+	// the two halves of the pixel buffer alternate, so the GPU can still be reading the previous
+	// frame while this one is written
+	_pboIndex = (_pboIndex + 1) % PBO_COUNT;
+	GLintptr offset = _pboIndex * _frameSize;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbo);
+	if (_mapped != nullptr) {
+		if (_fence[_pboIndex] != nullptr) {
+			glClientWaitSync(_fence[_pboIndex], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(_fence[_pboIndex]);
+			_fence[_pboIndex] = nullptr;
+		}
+		memcpy(_mapped + offset, frame, _frameSize);
+	} else {
+		glBufferSubData(GL_PIXEL_UNPACK_BUFFER, offset, _frameSize, frame);
+	}
+	glBindTexture(GL_TEXTURE_2D, _frameTexture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, settings::visible_width, settings::visible_height, GL_RED_INTEGER,
+		GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(offset));
+	if (_mapped != nullptr) {
+		_fence[_pboIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 }
 
 void MainShader::init() {
     glUseProgram(m_programId);
-    // initialize data
     _npixels = settings::visible_width * settings::visible_height;
-    _nColors = COLOR_COUNT;
-    _invColors = 1.0f / _nColors;
-    _data.resize(_npixels);
-    size_t i{0};
-    size_t color{0};
-    for (size_t row = 0; row < settings::visible_height; row++) {
-        for (size_t col = 0; col < settings::visible_width; col++) {
-            _data[i].pos = glm::vec2(col, row);
-            _data[i++].color = (color + 0.5f) * _invColors;
-            color = (color+1)%16 ;
-        }
+    _frameSize = _npixels;
+    _pboIndex = 0;
+    _mapped = nullptr;
+    for (auto& fence : _fence) {
+        fence = nullptr;
     }
-    _x0 = (settings::width - settings::visible_width) / 2;
-	_y0 = (settings::height - settings::visible_height) / 2;
 
+    // a quad covering the viewport, the fragment shader works out the pixel from gl_FragCoord
+    float quadVertices[] = {
+            -1.0f,  1.0f,
+            -1.0f, -1.0f,
+            1.0f, -1.0f,
+
+            -1.0f,  1.0f,
+            1.0f, -1.0f,
+            1.0f,  1.0f
+    };
     glGenVertexArrays(1, &_vao);
     glBindVertexArray(_vao);
-
-    // create buffer
     glGenBuffers(1, &_vbo);
     glBindBuffer(GL_ARRAY_BUFFER, _vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * _data.size(), &_data[0], GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glBindVertexArray(0);
 
-    auto stride = sizeof(Vertex);
+    // palette indices, one unsigned byte per pixel
+    glGenTextures(1, &_frameTexture);
+    glBindTexture(GL_TEXTURE_2D, _frameTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, settings::visible_width, settings::visible_height, 0, GL_RED_INTEGER,
+        GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, 0);
+    glGenBuffers(1, &_pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbo);
+    if (GLEW_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, PBO_COUNT * _frameSize, nullptr, flags);
+        _mapped = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, PBO_COUNT * _frameSize, flags));
+    } else {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, PBO_COUNT * _frameSize, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(Vertex, color));
-
-    // setup projection matrix for this machine
-    _projection = glm::mat4(1.f);
-    _projection[0][0] = 2.0 / settings::visible_width;
-    _projection[1][1] = -2.0 / settings::visible_height;
-    _projection[3][0] = -1.0;
-    _projection[3][1] = 1.0;
     generatePalette();
 }
 
@@ -195,48 +241,29 @@ void MainShader::draw() {
     glUseProgram(m_programId);
     glBindVertexArray(_vao);
 
-    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vertex) * _npixels, &_data[0]);
-
-    //_cam->init(s);
-
-    // set view matrix
-    //s->setMat4("view", _cam->getViewMatrix());
-
-    setMat4("projection", _projection);
-
     glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, _frameTexture);
+    setInt("frame", 0);
+    glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, _texture);
-    setInt("palette", 0);
+    setInt("palette", 1);
+    setInt("height", settings::visible_height);
 
-    glDrawArrays(GL_POINTS, 0, _npixels);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
     glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
 }
 
 void MainShader::generatePalette() {
     // every pixel has 4 components RGBA
-    unsigned char data[]{
-            0, 0, 0, 255,           // 0 = black
-            255, 255, 255, 255,     // 1 = white
-            136, 0, 0, 255,         // 2 = red
-            170, 255, 238, 255,     // 3 = cyan
-            204, 68, 204, 255,      // 4 = purple
-            0, 204, 85, 255,        // 5 = green
-            0, 0, 170, 255,         // 6 = blue
-            238, 238, 119, 255,     // 7 = yellow
-            221, 136, 85, 255,      // 8 = orange
-            102, 68, 0, 255,        // 9 = brown
-            255, 119, 119, 255,     // 10 = light red
-            51, 51, 51, 255,        // 11 = dark grey
-            119, 119, 119, 255,     // 12 = grey 2
-            170, 255, 102, 255,     // 13 = light green
-            0, 136, 255, 255,       // 14 = light blue
-            187, 187, 187, 255      // 15 = light grey
-    };
+    unsigned char data[COLOR_COUNT * 4];
+    for (int i = 0; i < COLOR_COUNT; ++i) {
+        data[4*i] = PALETTE[i][0];
+        data[4*i+1] = PALETTE[i][1];
+        data[4*i+2] = PALETTE[i][2];
+        data[4*i+3] = 255;
+    }
 
-    glGenTextures(1, &_texture);
-    //glBindTexture(GL_TEXTURE_1D, _texture);
-    //glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA, 16, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
     glGenTextures (1, &_texture);
     glBindTexture (GL_TEXTURE_2D, _texture);
     glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, 16, 1, 0,  GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
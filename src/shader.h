@@ -10,10 +10,6 @@
 
 class Node;
 
-struct Vertex {
-    glm::vec2 pos;
-    float color;
-};
 
 
 class Shader {
@@ -41,18 +37,26 @@ protected:
 	Mode _mode;
 };
 
+// Draws the VIC-II frame: the palette indices are uploaded as a single channel integer texture
+// through a pair of pixel buffers, and the fragment shader looks the colors up in the palette.
 class MainShader : public Shader {
 public:
     MainShader(const std::string& vertexCode, const std::string& fragmentCode, Mode mode) : Shader(vertexCode, fragmentCode), _mode(mode) {}
+    ~MainShader();
     void init() override;
     void draw() override;
     void generatePalette();
-	void setPixel(int x, int y, int color);
+	// upload a frame of palette indices, one byte per pixel
+	void update(const uint8_t* frame);
 private:
-    std::vector<Vertex> _data;
-    int _nColors;
-    float _invColors;
-    int _x0, _y0, _x1, _y1;
+	static const int PBO_COUNT = 2;
+	GLuint _frameTexture;
+	GLuint _pbo;
+	// with ARB_buffer_storage the buffer stays mapped, and fences tell when a half can be rewritten
+	uint8_t* _mapped;
+	GLsync _fence[PBO_COUNT];
+	int _pboIndex;
+	int _frameSize;
     Mode _mode;
 };
 
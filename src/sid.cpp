@@ -0,0 +1,530 @@
+#include "sid.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "snapshot.h"
+
+namespace {
+	// control register bits
+	const uint8_t GATE = 0x01;
+	const uint8_t SYNC = 0x02;
+	const uint8_t RING_MOD = 0x04;
+	const uint8_t TEST = 0x08;
+	const uint8_t TRIANGLE = 0x10;
+	const uint8_t SAWTOOTH = 0x20;
+	const uint8_t PULSE = 0x40;
+	const uint8_t NOISE = 0x80;
+
+	// $D418 bits
+	const uint8_t LOW_PASS = 0x10;
+	const uint8_t BAND_PASS = 0x20;
+	const uint8_t HIGH_PASS = 0x40;
+	const uint8_t VOICE3_OFF = 0x80;
+
+	// cycles between envelope steps for each of the 16 attack/decay/release settings
+	const uint16_t RATE_PERIOD[16] = {
+		9, 32, 63, 95, 149, 220, 267, 313, 392, 977, 1954, 3126, 3907, 11720, 19532, 31251
+	};
+
+	// decay and release slow down as the level falls, approximating an exponential curve
+	uint8_t exponentialPeriod(uint8_t level) {
+		if (level > 0x5D) return 1;
+		if (level > 0x36) return 2;
+		if (level > 0x1A) return 4;
+		if (level > 0x0E) return 8;
+		if (level > 0x06) return 16;
+		if (level > 0x00) return 30;
+		return 1;
+	}
+
+	const uint32_t NOISE_SEED = 0x7FFFFF;
+
+	// the waveform made from 8 bits of the noise shift register
+	uint32_t noiseOutput(uint32_t n) {
+		return ((n >> 9) & 0x800) | ((n >> 8) & 0x400) | ((n >> 5) & 0x200) | ((n >> 3) & 0x100) |
+			((n >> 2) & 0x080) | ((n << 1) & 0x040) | ((n << 3) & 0x020) | ((n << 4) & 0x010);
+	}
+
+	uint32_t clockNoise(uint32_t n) {
+		uint32_t bit = ((n >> 22) ^ (n >> 17)) & 1;
+		return ((n << 1) | bit) & 0x7FFFFF;
+	}
+
+	// a voice output of 1.0 is the full 12 bit waveform swing at the top envelope level
+	const float LEVEL_SCALE = 1.0f / (2048 * 255);
+
+	int roundUp4(int n) {
+		return (n + 3) & ~3;
+	}
+	// the sum of three full scale voices maps to a bit less than the full 16 bit range
+	const float OUTPUT_SCALE = 32767.0f * 0.3f;
+}
+
+SID::SID(SidModel model, double clockFrequency, int sampleRate) : _model(model), _filterCutoffLo(0),
+	_filterCutoffHi(0), _resonanceRouting(0), _modeVolume(0), _lowPass(0), _bandPass(0),
+	_clockFrequency(clockFrequency), _highPassIn(0), _highPassOut(0) {
+	for (auto& voice : _voice) {
+		memset(&voice, 0, sizeof(voice));
+		voice.noise = NOISE_SEED;
+		voice.state = RELEASE;
+	}
+	// the kernels read the padding of the arrays, keep it defined
+	memset(_accumulator, 0, sizeof(_accumulator));
+	memset(_noise, 0, sizeof(_noise));
+	memset(_envelope, 0, sizeof(_envelope));
+	setModel(model);
+	setSampleRate(sampleRate);
+}
+
+void SID::setSampleRate(int sampleRate) {
+	_resampler = std::make_unique<Resampler>(_clockFrequency, sampleRate);
+}
+
+void SID::setModel(SidModel model) {
+	_model = model;
+	_dcOffset = model == SidModel::MOS6581 ? 0.4f : 0.0f;
+	updateFilter();
+}
+
+uint8_t SID::getOsc3() const {
+	return waveform(_voice[2], _voice[1]) >> 4;
+}
+
+uint8_t SID::getEnv3() const {
+	return _voice[2].level;
+}
+
+void SID::write(uint8_t reg, uint8_t value) {
+	if (reg < 0x15) {
+		Voice& voice = _voice[reg / 7];
+		switch (reg % 7) {
+			case 0:
+				voice.frequency = (voice.frequency & 0xFF00) | value;
+				break;
+			case 1:
+				voice.frequency = (voice.frequency & 0x00FF) | (value << 8);
+				break;
+			case 2:
+				voice.pulseWidth = (voice.pulseWidth & 0x0F00) | value;
+				break;
+			case 3:
+				voice.pulseWidth = (voice.pulseWidth & 0x00FF) | ((value & 0x0F) << 8);
+				break;
+			case 4:
+				if ((value & GATE) && !(voice.control & GATE)) {
+					voice.state = ATTACK;
+				} else if (!(value & GATE) && (voice.control & GATE)) {
+					voice.state = RELEASE;
+				}
+				if (value & TEST) {
+					voice.accumulator = 0;
+					voice.noise = NOISE_SEED;
+				}
+				voice.control = value;
+				break;
+			case 5:
+				voice.attackDecay = value;
+				break;
+			case 6:
+				voice.sustainRelease = value;
+				break;
+		}
+		return;
+	}
+	switch (reg) {
+		case 0x15:
+			_filterCutoffLo = value & 0x07;
+			break;
+		case 0x16:
+			_filterCutoffHi = value;
+			break;
+		case 0x17:
+			_resonanceRouting = value;
+			break;
+		case 0x18:
+			_modeVolume = value;
+			break;
+		default:
+			// the readouts at $19-$1C can't be written
+			return;
+	}
+	updateFilter();
+}
+
+void SID::updateFilter() {
+	float cutoff = ((_filterCutoffHi << 3) | _filterCutoffLo) / 2047.0f;
+	// the 8580 cutoff is close to linear in the register value, the 6581 one is not
+	// and varies between chips: this is a typical curve
+	float frequency = _model == SidModel::MOS8580 ? 30.0f + 12000.0f * cutoff :
+		220.0f + 17000.0f * cutoff * cutoff;
+	_w = 2.0f * std::sin(static_cast<float>(M_PI) * frequency / static_cast<float>(_clockFrequency));
+	_damping = 1.0f / (0.707f + (_resonanceRouting >> 4) / 15.0f * 1.5f);
+
+	// The filter and the volume are linear: four cycles of them map the state (low pass, band pass) and
+	// the four inputs to the four outputs and the next state. Get the matrices by running the recursion
+	// from each unit vector.
+	double volume = (_modeVolume & 0x0F) / 15.0;
+	auto unitResponse = [&](double lowPass, double bandPass, int impulse, float* output, float* state) {
+		for (int j = 0; j < 4; ++j) {
+			double highPass = (j == impulse ? 1.0 : 0.0) - lowPass - _damping * bandPass;
+			bandPass += _w * highPass;
+			lowPass += _w * bandPass;
+			output[j] = static_cast<float>(volume * (((_modeVolume & LOW_PASS) ? lowPass : 0.0) +
+				((_modeVolume & BAND_PASS) ? bandPass : 0.0) + ((_modeVolume & HIGH_PASS) ? highPass : 0.0)));
+		}
+		state[0] = static_cast<float>(lowPass);
+		state[1] = static_cast<float>(bandPass);
+		state[2] = state[3] = 0.0f;
+	};
+	unitResponse(1.0, 0.0, -1, _outputFromState[0], _stateFromState[0]);
+	unitResponse(0.0, 1.0, -1, _outputFromState[1], _stateFromState[1]);
+	for (int m = 0; m < 4; ++m) {
+		unitResponse(0.0, 0.0, m, _outputFromInput[m], _stateFromInput[m]);
+	}
+}
+
+uint16_t SID::waveform(const Voice& voice, const Voice& source) const {
+	uint16_t output = 0xFFF;
+	uint32_t accumulator = voice.accumulator;
+	if (voice.control & TRIANGLE) {
+		// ring modulation replaces the top bit with the one of the previous voice
+		uint32_t msb = accumulator & 0x800000;
+		if (voice.control & RING_MOD) {
+			msb ^= source.accumulator & 0x800000;
+		}
+		output &= ((msb ? ~accumulator : accumulator) >> 11) & 0xFFF;
+	}
+	if (voice.control & SAWTOOTH) {
+		output &= accumulator >> 12;
+	}
+	if (voice.control & PULSE) {
+		output &= ((voice.control & TEST) || (accumulator >> 12) >= voice.pulseWidth) ? 0xFFF : 0x000;
+	}
+	if (voice.control & NOISE) {
+		output &= noiseOutput(voice.noise);
+	}
+	if ((voice.control & 0xF0) == 0) {
+		output = 0;
+	}
+	return output;
+}
+
+void SID::clockOscillators() {
+	for (auto& voice : _voice) {
+		uint32_t previous = voice.accumulator;
+		if (voice.control & TEST) {
+			voice.msbRising = false;
+			continue;
+		}
+		voice.accumulator = (previous + voice.frequency) & 0xFFFFFF;
+		voice.msbRising = !(previous & 0x800000) && (voice.accumulator & 0x800000);
+		if (!(previous & 0x080000) && (voice.accumulator & 0x080000)) {
+			voice.noise = clockNoise(voice.noise);
+		}
+	}
+	// hard sync: each voice restarts when the previous one wraps around
+	for (int i = 0; i < 3; ++i) {
+		if ((_voice[i].control & SYNC) && _voice[(i + 2) % 3].msbRising) {
+			_voice[i].accumulator = 0;
+		}
+	}
+}
+
+uint16_t SID::ratePeriod(const Voice& voice) {
+	switch (voice.state) {
+		case ATTACK:
+			return RATE_PERIOD[voice.attackDecay >> 4];
+		case DECAY_SUSTAIN:
+			return RATE_PERIOD[voice.attackDecay & 0x0F];
+		default:
+			return RATE_PERIOD[voice.sustainRelease & 0x0F];
+	}
+}
+
+void SID::clockEnvelope(Voice& voice) {
+	if (++voice.rateCounter < ratePeriod(voice)) {
+		return;
+	}
+	voice.rateCounter = 0;
+	if (voice.state == ATTACK) {
+		voice.exponentialCounter = 0;
+		if (++voice.level == 0xFF) {
+			voice.state = DECAY_SUSTAIN;
+		}
+		return;
+	}
+	if (++voice.exponentialCounter < exponentialPeriod(voice.level)) {
+		return;
+	}
+	voice.exponentialCounter = 0;
+	uint8_t floor = voice.state == DECAY_SUSTAIN ? (voice.sustainRelease >> 4) * 0x11 : 0;
+	if (voice.level > floor) {
+		--voice.level;
+	}
+}
+
+void SID::envelopeBlock(Voice& voice, int count) {
+	int k = 0;
+	while (k < count) {
+		// the level holds until the rate counter reaches its period
+		int hold = std::min(count - k, std::max(0, ratePeriod(voice) - voice.rateCounter - 1));
+		float level = voice.level * LEVEL_SCALE;
+		for (int end = k + hold; k < end; ++k) {
+			_envelope[k] = level;
+		}
+		voice.rateCounter += hold;
+		if (k < count) {
+			clockEnvelope(voice);
+			_envelope[k++] = voice.level * LEVEL_SCALE;
+		}
+	}
+}
+
+void SID::oscillatorBlock(int count) {
+	if ((_voice[0].control | _voice[1].control | _voice[2].control) & SYNC) {
+		// hard sync makes each voice depend on the previous one, cycle by cycle
+		for (int k = 0; k < count; ++k) {
+			clockOscillators();
+			for (int i = 0; i < 3; ++i) {
+				_accumulator[i][k] = _voice[i].accumulator;
+				_noise[i][k] = noiseOutput(_voice[i].noise);
+			}
+		}
+		return;
+	}
+	for (int i = 0; i < 3; ++i) {
+		Voice& voice = _voice[i];
+		uint32_t* accumulator = _accumulator[i];
+		uint32_t start = voice.accumulator;
+		uint32_t step = (voice.control & TEST) ? 0 : voice.frequency;
+		// no overflow: count * step stays below 2^24
+#ifdef __SSE2__
+		__m128i value = _mm_setr_epi32(start + step, start + 2 * step, start + 3 * step, start + 4 * step);
+#endif
+		for (int k = 0; k < roundUp4(count); k += 4) {
+#ifdef __SSE2__
+			_mm_store_si128(reinterpret_cast<__m128i*>(accumulator + k), _mm_and_si128(value, _mm_set1_epi32(0xFFFFFF)));
+			value = _mm_add_epi32(value, _mm_set1_epi32(4 * step));
+#else
+			for (int j = k; j < k + 4; ++j) {
+				accumulator[j] = (start + (j + 1) * step) & 0xFFFFFF;
+			}
+#endif
+		}
+		voice.accumulator = accumulator[count - 1];
+		if (voice.control & NOISE) {
+			// the noise waveform is needed cycle by cycle
+			uint32_t previous = start;
+			uint32_t output = noiseOutput(voice.noise);
+			for (int k = 0; k < count; ++k) {
+				if (!(previous & 0x080000) && (accumulator[k] & 0x080000)) {
+					voice.noise = clockNoise(voice.noise);
+					output = noiseOutput(voice.noise);
+				}
+				_noise[i][k] = output;
+				previous = accumulator[k];
+			}
+		} else {
+			// the shift register still runs: clock it once for each time bit 19 went up
+			long end = start + static_cast<long>(count) * step;
+			long clocks = ((end + 0x80000) >> 20) - ((start + 0x80000) >> 20);
+			for (long c = 0; c < clocks; ++c) {
+				voice.noise = clockNoise(voice.noise);
+			}
+		}
+	}
+}
+
+#ifdef __SSE2__
+
+void SID::waveformBlock(int i, int count, float* destination) {
+	const Voice& voice = _voice[i];
+	const uint32_t* accumulator = _accumulator[i];
+	const uint32_t* source = _accumulator[(i + 2) % 3];
+	const uint8_t control = voice.control;
+	const __m128i mask12 = _mm_set1_epi32(0xFFF);
+	// pulse is high when the top 12 bits reach the pulse width, and always in test mode
+	const __m128i pulseThreshold = _mm_set1_epi32((control & TEST) ? -1 : voice.pulseWidth - 1);
+	for (int k = 0; k < count; k += 4) {
+		__m128i acc = _mm_load_si128(reinterpret_cast<const __m128i*>(accumulator + k));
+		__m128i output = mask12;
+		if (control & TRIANGLE) {
+			__m128i msb = (control & RING_MOD) ?
+				_mm_xor_si128(acc, _mm_load_si128(reinterpret_cast<const __m128i*>(source + k))) : acc;
+			// all ones where bit 23 is set, to fold the ramp
+			__m128i fold = _mm_srai_epi32(_mm_slli_epi32(msb, 8), 31);
+			output = _mm_and_si128(output, _mm_srli_epi32(_mm_xor_si128(acc, fold), 11));
+		}
+		if (control & SAWTOOTH) {
+			output = _mm_and_si128(output, _mm_srli_epi32(acc, 12));
+		}
+		if (control & PULSE) {
+			output = _mm_and_si128(output, _mm_cmpgt_epi32(_mm_srli_epi32(acc, 12), pulseThreshold));
+		}
+		if (control & NOISE) {
+			output = _mm_and_si128(output, _mm_load_si128(reinterpret_cast<const __m128i*>(_noise[i] + k)));
+		}
+		__m128 sample = _mm_cvtepi32_ps(_mm_sub_epi32(output, _mm_set1_epi32(2048)));
+		sample = _mm_mul_ps(sample, _mm_load_ps(_envelope + k));
+		_mm_store_ps(destination + k, _mm_add_ps(_mm_load_ps(destination + k), sample));
+	}
+}
+
+#else
+
+void SID::waveformBlock(int i, int count, float* destination) {
+	const Voice& voice = _voice[i];
+	const uint32_t* accumulator = _accumulator[i];
+	const uint32_t* source = _accumulator[(i + 2) % 3];
+	const uint8_t control = voice.control;
+	for (int k = 0; k < count; ++k) {
+		uint32_t acc = accumulator[k];
+		uint32_t output = 0xFFF;
+		if (control & TRIANGLE) {
+			uint32_t msb = ((control & RING_MOD) ? acc ^ source[k] : acc) & 0x800000;
+			output &= (msb ? ~acc : acc) >> 11;
+		}
+		if (control & SAWTOOTH) {
+			output &= acc >> 12;
+		}
+		if (control & PULSE) {
+			output &= ((control & TEST) || (acc >> 12) >= voice.pulseWidth) ? 0xFFF : 0x000;
+		}
+		if (control & NOISE) {
+			output &= _noise[i][k];
+		}
+		destination[k] += (static_cast<int>(output) - 2048) * _envelope[k];
+	}
+}
+
+#endif
+
+void SID::synthesizeBlock(int count) {
+	oscillatorBlock(count);
+	for (int k = 0; k < roundUp4(count); ++k) {
+		_filterInput[k] = 0;
+		_direct[k] = _dcOffset;
+	}
+	for (int i = 0; i < 3; ++i) {
+		Voice& voice = _voice[i];
+		envelopeBlock(voice, count);
+		bool filtered = _resonanceRouting & (1 << i);
+		// no waveform selected: the output is held at zero
+		if ((voice.control & 0xF0) == 0 || (!filtered && i == 2 && (_modeVolume & VOICE3_OFF))) {
+			continue;
+		}
+		waveformBlock(i, count, filtered ? _filterInput : _direct);
+	}
+	float volume = (_modeVolume & 0x0F) / 15.0f;
+	int k = 0;
+#ifdef __SSE2__
+	// four cycles at a time with the matrices from updateFilter, the state is kept broadcast in all lanes
+	__m128 lowPassState = _mm_set1_ps(_lowPass);
+	__m128 bandPassState = _mm_set1_ps(_bandPass);
+	const __m128 outputFromLowPass = _mm_load_ps(_outputFromState[0]);
+	const __m128 outputFromBandPass = _mm_load_ps(_outputFromState[1]);
+	const __m128 stateFromLowPass = _mm_load_ps(_stateFromState[0]);
+	const __m128 stateFromBandPass = _mm_load_ps(_stateFromState[1]);
+	const __m128 volumes = _mm_set1_ps(volume);
+	for (; k + 4 <= count; k += 4) {
+		__m128 input = _mm_load_ps(_filterInput + k);
+		__m128 output = _mm_add_ps(_mm_mul_ps(outputFromLowPass, lowPassState), _mm_mul_ps(outputFromBandPass, bandPassState));
+		__m128 state = _mm_add_ps(_mm_mul_ps(stateFromLowPass, lowPassState), _mm_mul_ps(stateFromBandPass, bandPassState));
+		__m128 in[4] = {_mm_shuffle_ps(input, input, 0x00), _mm_shuffle_ps(input, input, 0x55),
+			_mm_shuffle_ps(input, input, 0xAA), _mm_shuffle_ps(input, input, 0xFF)};
+		for (int m = 0; m < 4; ++m) {
+			output = _mm_add_ps(output, _mm_mul_ps(_mm_load_ps(_outputFromInput[m]), in[m]));
+			state = _mm_add_ps(state, _mm_mul_ps(_mm_load_ps(_stateFromInput[m]), in[m]));
+		}
+		_mm_store_ps(_mix + k, _mm_add_ps(_mm_mul_ps(_mm_load_ps(_direct + k), volumes), output));
+		lowPassState = _mm_shuffle_ps(state, state, 0x00);
+		bandPassState = _mm_shuffle_ps(state, state, 0x55);
+	}
+	_lowPass = _mm_cvtss_f32(lowPassState);
+	_bandPass = _mm_cvtss_f32(bandPassState);
+#endif
+	// the plain recursion, for what is left
+	float lowPassGain = (_modeVolume & LOW_PASS) ? 1.0f : 0.0f;
+	float bandPassGain = (_modeVolume & BAND_PASS) ? 1.0f : 0.0f;
+	float highPassGain = (_modeVolume & HIGH_PASS) ? 1.0f : 0.0f;
+	float lowPass = _lowPass;
+	float bandPass = _bandPass;
+	for (; k < count; ++k) {
+		float highPass = _filterInput[k] - lowPass - _damping * bandPass;
+		bandPass += _w * highPass;
+		lowPass += _w * bandPass;
+		_mix[k] = (_direct[k] + lowPassGain * lowPass + bandPassGain * bandPass + highPassGain * highPass) * volume;
+	}
+	_lowPass = lowPass;
+	_bandPass = bandPass;
+}
+
+void SID::run(long cycles, std::vector<int16_t>& out) {
+	while (cycles > 0) {
+		int count = static_cast<int>(std::min<long>(cycles, BLOCK));
+		synthesizeBlock(count);
+		_resampler->process(_mix, count, _resampled);
+		cycles -= count;
+	}
+	for (float sample : _resampled) {
+		// the output capacitor removes the DC
+		_highPassOut = 0.999f * (_highPassOut + sample - _highPassIn);
+		_highPassIn = sample;
+		out.push_back(static_cast<int16_t>(std::clamp(_highPassOut * OUTPUT_SCALE, -32768.0f, 32767.0f)));
+	}
+	_resampled.clear();
+}
+
+void SID::save(SnapshotWriter& out) const {
+	out.put8(static_cast<uint8_t>(_model));
+	for (const auto& voice : _voice) {
+		out.put32(voice.accumulator);
+		out.put32(voice.noise);
+		out.put16(voice.frequency);
+		out.put16(voice.pulseWidth);
+		out.put8(voice.control);
+		out.put8(voice.attackDecay);
+		out.put8(voice.sustainRelease);
+		out.put8(voice.msbRising);
+		out.put8(voice.state);
+		out.put8(voice.level);
+		out.put16(voice.rateCounter);
+		out.put8(voice.exponentialCounter);
+	}
+	for (uint8_t value : {_filterCutoffLo, _filterCutoffHi, _resonanceRouting, _modeVolume}) {
+		out.put8(value);
+	}
+	for (float value : {_lowPass, _bandPass, _highPassIn, _highPassOut}) {
+		out.putFloat(value);
+	}
+}
+
+void SID::load(SnapshotReader& in) {
+	_model = in.get8() == static_cast<uint8_t>(SidModel::MOS8580) ? SidModel::MOS8580 : SidModel::MOS6581;
+	for (auto& voice : _voice) {
+		voice.accumulator = in.get32() & 0xFFFFFF;
+		voice.noise = in.get32() & 0x7FFFFF;
+		voice.frequency = in.get16();
+		voice.pulseWidth = in.get16() & 0x0FFF;
+		voice.control = in.get8();
+		voice.attackDecay = in.get8();
+		voice.sustainRelease = in.get8();
+		voice.msbRising = in.get8();
+		uint8_t state = in.get8();
+		voice.state = state == ATTACK ? ATTACK : state == DECAY_SUSTAIN ? DECAY_SUSTAIN : RELEASE;
+		voice.level = in.get8();
+		voice.rateCounter = in.get16();
+		voice.exponentialCounter = in.get8();
+	}
+	for (uint8_t* value : {&_filterCutoffLo, &_filterCutoffHi, &_resonanceRouting, &_modeVolume}) {
+		*value = in.get8();
+	}
+	for (float* value : {&_lowPass, &_bandPass, &_highPassIn, &_highPassOut}) {
+		*value = in.getFloat();
+	}
+	// the filter coefficients follow from the registers and the model
+	setModel(_model);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "resampler.h"
+
+class SnapshotWriter;
+class SnapshotReader;
+
+enum class SidModel {
+	MOS6581, MOS8580
+};
+
+// MOS 6581/8580 Sound Interface Device: three voices (oscillator, waveform generator and envelope),
+// a multimode filter and the master volume, at one output value per CPU cycle, resampled to the
+// audio rate. Cycles are synthesized in blocks: each stage fills an array for the whole block
+// (accumulators, envelope levels, voice outputs) so that the waveform and mixing kernels can run
+// four cycles at a time. This class is not thread safe, SidThread runs it away from the CPU.
+class SID {
+public:
+	SID(SidModel model, double clockFrequency, int sampleRate);
+	void setModel(SidModel model);
+	void setSampleRate(int sampleRate);
+	void write(uint8_t reg, uint8_t value);
+	// the voice 3 readouts at $D41B and $D41C
+	uint8_t getOsc3() const;
+	uint8_t getEnv3() const;
+	// run for the given number of cycles, appending the samples produced to out
+	void run(long cycles, std::vector<int16_t>& out);
+	// registers, voices and filter. The resampler keeps its history: a load is at most a click.
+	void save(SnapshotWriter& out) const;
+	void load(SnapshotReader& in);
+private:
+	enum EnvelopeState {
+		ATTACK, DECAY_SUSTAIN, RELEASE
+	};
+	struct Voice {
+		uint32_t accumulator;       // 24 bits, the waveforms are made from its top 12
+		uint32_t noise;             // 23 bit shift register, clocked by bit 19 of the accumulator
+		uint16_t frequency;
+		uint16_t pulseWidth;
+		uint8_t control;
+		uint8_t attackDecay;
+		uint8_t sustainRelease;
+		bool msbRising;             // drives hard sync of the next voice
+		EnvelopeState state;
+		uint8_t level;
+		uint16_t rateCounter;
+		uint8_t exponentialCounter;
+	};
+	static constexpr int BLOCK = 256;
+	// synthesize count <= BLOCK cycles into _mix
+	void synthesizeBlock(int count);
+	// the accumulators (and noise outputs) of each voice, one value per cycle
+	void oscillatorBlock(int count);
+	// the envelope level of a voice into _envelope, one value per cycle, scaled for waveformBlock
+	void envelopeBlock(Voice& voice, int count);
+	// add the output of voice i to the filter input or to the direct output
+	void waveformBlock(int i, int count, float* destination);
+	// a single cycle, for the oscillators when hard sync ties them together
+	void clockOscillators();
+	void clockEnvelope(Voice& voice);
+	// cycles between envelope steps in the current state
+	static uint16_t ratePeriod(const Voice& voice);
+	// the 12 bit waveform output, the selected waveforms are combined with an AND
+	uint16_t waveform(const Voice& voice, const Voice& source) const;
+	void updateFilter();
+	SidModel _model;
+	Voice _voice[3];
+	uint8_t _filterCutoffLo;
+	uint8_t _filterCutoffHi;
+	uint8_t _resonanceRouting;  // $D417: resonance in the high nibble, the voices routed to the filter in the low
+	uint8_t _modeVolume;        // $D418: filter mode in the high nibble, volume in the low
+	// state variable filter, run at the clock rate
+	float _w;
+	float _damping;
+	float _lowPass, _bandPass;
+	// four cycles of filter and volume as matrices: the columns are what the state (low pass, band pass)
+	// and each of the four inputs contribute to the four outputs and to the next state
+	alignas(16) float _outputFromState[2][4];
+	alignas(16) float _outputFromInput[4][4];
+	alignas(16) float _stateFromState[2][4];
+	alignas(16) float _stateFromInput[4][4];
+	float _dcOffset;            // the 6581 mixer offset that makes volume writes audible
+	double _clockFrequency;
+	// the current block, padded to a multiple of 4 cycles
+	alignas(16) uint32_t _accumulator[3][BLOCK];
+	alignas(16) uint32_t _noise[3][BLOCK];          // only filled for voices playing noise
+	alignas(16) float _envelope[BLOCK];
+	alignas(16) float _filterInput[BLOCK];
+	alignas(16) float _direct[BLOCK];
+	alignas(16) float _mix[BLOCK];
+	std::unique_ptr<Resampler> _resampler;
+	std::vector<float> _resampled;
+	// the output coupling capacitor
+	float _highPassIn, _highPassOut;
+};
@@ -0,0 +1,176 @@
+#include "sidthread.h"
+#include <algorithm>
+#include <chrono>
+#include "snapshot.h"
+
+SidThread::SidThread(SidModel model, double clockFrequency, int sampleRate) : _sid(model, clockFrequency, sampleRate),
+	_sidCycle(0), _head(0), _tail(0), _osc3(0), _env3(0), _idle(false), _stop(false) {
+}
+
+SidThread::~SidThread() {
+	stop();
+}
+
+void SidThread::start() {
+	if (_thread.joinable()) {
+		return;
+	}
+	if (_buffer.empty()) {
+		_buffer.resize(CAPACITY);
+	}
+	_stop.store(false);
+	_thread = std::thread(&SidThread::loop, this);
+}
+
+void SidThread::stop() {
+	if (!_thread.joinable()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop.store(true);
+	}
+	_wake.notify_one();
+	_thread.join();
+	if (_sink && !_samples.empty()) {
+		_sink->write(_samples.data(), _samples.size());
+	}
+	_samples.clear();
+}
+
+void SidThread::setSink(std::unique_ptr<AudioSink> sink) {
+	stop();
+	_sink = std::move(sink);
+	if (_sink) {
+		_sid.setSampleRate(_sink->getSampleRate());
+	}
+	start();
+}
+
+void SidThread::push(const Entry& entry) {
+	auto head = _head.load(std::memory_order_relaxed);
+	while (head - _tail.load(std::memory_order_acquire) == CAPACITY) {
+		std::this_thread::yield();
+	}
+	_buffer[head & (CAPACITY - 1)] = entry;
+	// sequentially consistent, paired with the store to _idle in loop(): either the audio thread
+	// sees the new entry before going to sleep, or this thread sees it idle and wakes it up
+	_head.store(head + 1);
+	if (_idle.load()) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_wake.notify_one();
+	}
+}
+
+void SidThread::write(long cycle, uint8_t reg, uint8_t value) {
+	start();
+	push({cycle, Command::WRITE, reg, value});
+}
+
+void SidThread::setModel(long cycle, SidModel model) {
+	start();
+	push({cycle, Command::MODEL, 0, static_cast<uint8_t>(model)});
+}
+
+void SidThread::sync(long cycle) {
+	// without the thread the SID catches up with the first command
+	if (!_thread.joinable()) {
+		return;
+	}
+	push({cycle, Command::SYNC, 0, 0});
+}
+
+uint8_t SidThread::read(long cycle, uint8_t reg) {
+	start();
+	// wait for the audio thread to consume the sync, and everything pushed before it
+	auto entry = _head.load(std::memory_order_relaxed);
+	sync(cycle);
+	while (_tail.load(std::memory_order_acquire) <= entry) {
+		std::this_thread::yield();
+	}
+	return reg == 0x1B ? _osc3.load(std::memory_order_relaxed) : _env3.load(std::memory_order_relaxed);
+}
+
+void SidThread::save(long cycle, SnapshotWriter& out) {
+	if (!_thread.joinable()) {
+		// nobody listens: the SID is brought up to the cycle here and the samples dropped
+		catchUp(cycle);
+		_samples.clear();
+		_sid.save(out);
+		return;
+	}
+	auto entry = _head.load(std::memory_order_relaxed);
+	sync(cycle);
+	while (_tail.load(std::memory_order_acquire) <= entry) {
+		std::this_thread::yield();
+	}
+	// the audio thread doesn't touch the SID again until something is pushed
+	_sid.save(out);
+}
+
+void SidThread::load(long cycle, SnapshotReader& in) {
+	bool running = _thread.joinable();
+	stop();
+	_sid.load(in);
+	_sidCycle = cycle;
+	_osc3.store(_sid.getOsc3(), std::memory_order_relaxed);
+	_env3.store(_sid.getEnv3(), std::memory_order_relaxed);
+	if (running) {
+		start();
+	}
+}
+
+void SidThread::catchUp(long cycle) {
+	// in pieces, so that the samples of a long stretch without commands don't pile up
+	while (cycle > _sidCycle) {
+		long cycles = std::min(cycle - _sidCycle, CATCH_UP_CYCLES);
+		_sid.run(cycles, _samples);
+		_sidCycle += cycles;
+		deliver();
+	}
+}
+
+void SidThread::deliver() {
+	if (_samples.size() >= SINK_BLOCK) {
+		if (_sink) {
+			_sink->write(_samples.data(), _samples.size());
+		}
+		_samples.clear();
+	}
+}
+
+void SidThread::execute(const Entry& entry) {
+	catchUp(entry.cycle);
+	switch (entry.command) {
+		case Command::WRITE:
+			_sid.write(entry.reg, entry.value);
+			break;
+		case Command::MODEL:
+			_sid.setModel(static_cast<SidModel>(entry.value));
+			break;
+		case Command::SYNC:
+			break;
+	}
+	deliver();
+}
+
+void SidThread::loop() {
+	while (true) {
+		auto tail = _tail.load(std::memory_order_relaxed);
+		if (_head.load(std::memory_order_acquire) == tail) {
+			// nothing to do: announce it, look again, then sleep until push() wakes us
+			_idle.store(true);
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [&] { return _stop.load() || _head.load() != tail; });
+			_idle.store(false);
+			if (_stop.load() && _head.load() == tail) {
+				break;
+			}
+			continue;
+		}
+		execute(_buffer[tail & (CAPACITY - 1)]);
+		_osc3.store(_sid.getOsc3(), std::memory_order_relaxed);
+		_env3.store(_sid.getEnv3(), std::memory_order_relaxed);
+		_tail.store(tail + 1, std::memory_order_release);
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "sid.h"
+#include "audiosink.h"
+
+// Runs the SID on its own thread. The CPU thread pushes cycle-stamped commands into a lock-free
+// single-producer/single-consumer ring buffer; the audio thread synthesizes up to the cycle of each
+// command, applies it and passes the samples to the sink. Synthesis never gets ahead of the commands,
+// so reading the voice 3 registers only needs to wait for the audio thread to catch up.
+// The thread and its ring buffer only exist once there is a sink or the SID is first written or read:
+// until then the SID stays where it was, and catches up in one go.
+class SidThread {
+public:
+	SidThread(SidModel model, double clockFrequency, int sampleRate);
+	~SidThread();
+	// the sink is replaced with the audio thread stopped, samples made before go to the old one.
+	// From then on the SID is resampled to the rate of the new sink.
+	void setSink(std::unique_ptr<AudioSink> sink);
+	void setModel(long cycle, SidModel model);
+	void write(long cycle, uint8_t reg, uint8_t value);
+	// $D41B and $D41C as they are at the given cycle
+	uint8_t read(long cycle, uint8_t reg);
+	// let the audio thread synthesize up to the given cycle
+	void sync(long cycle);
+	// the SID as it is at the given cycle, waits for the audio thread to get there
+	void save(long cycle, SnapshotWriter& out);
+	// replace the state of the SID, with the audio thread stopped. The SID is at the given cycle then.
+	void load(long cycle, SnapshotReader& in);
+private:
+	enum class Command : uint8_t {
+		WRITE, MODEL, SYNC
+	};
+	struct Entry {
+		long cycle;
+		Command command;
+		uint8_t reg;
+		uint8_t value;
+	};
+	void push(const Entry& entry);
+	void start();
+	void stop();
+	void loop();
+	// synthesize up to the cycle, on the audio thread or with it stopped
+	void catchUp(long cycle);
+	// pass the samples to the sink once there are enough
+	void deliver();
+	void execute(const Entry& entry);
+	static constexpr size_t CAPACITY = 1 << 12;
+	// samples are passed to the sink in blocks of about this size
+	static constexpr size_t SINK_BLOCK = 1024;
+	// at most this many cycles are synthesized at a time, less than a frame
+	static constexpr long CATCH_UP_CYCLES = 1 << 14;
+	SID _sid;
+	long _sidCycle;             // cycle the synthesis has reached, owned by the audio thread
+	std::vector<int16_t> _samples;
+	std::unique_ptr<AudioSink> _sink;
+	std::vector<Entry> _buffer;
+	alignas(64) std::atomic<size_t> _head;      // next slot written by the CPU thread
+	alignas(64) std::atomic<size_t> _tail;      // next slot read by the audio thread
+	// published by the audio thread before it moves _tail past a command, for reads
+	std::atomic<uint8_t> _osc3;
+	std::atomic<uint8_t> _env3;
+	// the audio thread sleeps on the condition variable when the ring is empty
+	std::atomic<bool> _idle;
+	std::atomic<bool> _stop;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::thread _thread;
+};
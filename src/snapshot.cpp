@@ -0,0 +1,162 @@
+#include "snapshot.h"
+#include <cstring>
+
+namespace {
+	const char SIGNATURE[8] = {'C', '6', '4', 'S', 'N', 'A', 'P', 0x1A};
+	const size_t HEADER_SIZE = sizeof(SIGNATURE) + 2;
+	const size_t CHUNK_HEADER = 8;
+	const char CHECKSUM[4] = {'S', 'U', 'M', ' '};
+
+	uint32_t readLength(const uint8_t* data) {
+		return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+	}
+}
+
+SnapshotWriter::SnapshotWriter() : _data(std::begin(SIGNATURE), std::end(SIGNATURE)), _chunk(0) {
+	put16(VERSION);
+}
+
+void SnapshotWriter::beginChunk(const char* tag) {
+	_data.insert(_data.end(), tag, tag + 4);
+	_chunk = _data.size();
+	put32(0);
+}
+
+void SnapshotWriter::endChunk() {
+	uint32_t length = static_cast<uint32_t>(_data.size() - _chunk - 4);
+	for (int i = 0; i < 4; ++i) {
+		_data[_chunk + i] = static_cast<uint8_t>(length >> (8 * i));
+	}
+}
+
+void SnapshotWriter::put8(uint8_t value) {
+	_data.push_back(value);
+}
+
+void SnapshotWriter::put16(uint16_t value) {
+	put8(value & 0xFF);
+	put8(value >> 8);
+}
+
+void SnapshotWriter::put32(uint32_t value) {
+	put16(value & 0xFFFF);
+	put16(value >> 16);
+}
+
+void SnapshotWriter::put64(uint64_t value) {
+	put32(value & 0xFFFFFFFF);
+	put32(value >> 32);
+}
+
+void SnapshotWriter::putFloat(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	put32(bits);
+}
+
+void SnapshotWriter::putBytes(const uint8_t* data, size_t size) {
+	_data.insert(_data.end(), data, data + size);
+}
+
+void SnapshotWriter::finish() {
+	uint64_t hash = snapshotHash(_data.data(), _data.size());
+	beginChunk(CHECKSUM);
+	put64(hash);
+	endChunk();
+}
+
+SnapshotReader::SnapshotReader(const uint8_t* data, size_t size) : _data(data), _size(size), _valid(false),
+	_position(0), _end(0), _failed(false) {
+	if (size < HEADER_SIZE || memcmp(data, SIGNATURE, sizeof(SIGNATURE)) != 0 ||
+		(data[8] | (data[9] << 8)) != SnapshotWriter::VERSION) {
+		return;
+	}
+	size_t offset = HEADER_SIZE;
+	while (offset < size) {
+		if (size - offset < CHUNK_HEADER) {
+			return;
+		}
+		Chunk chunk;
+		memcpy(chunk.tag, data + offset, 4);
+		chunk.size = readLength(data + offset + 4);
+		chunk.offset = offset + CHUNK_HEADER;
+		if (chunk.size > size - chunk.offset) {
+			return;
+		}
+		_chunks.push_back(chunk);
+		offset = chunk.offset + chunk.size;
+	}
+	if (_chunks.empty() || memcmp(_chunks.back().tag, CHECKSUM, 4) != 0 || _chunks.back().size != 8) {
+		return;
+	}
+	_position = _chunks.back().offset;
+	_end = _position + 8;
+	_valid = get64() == snapshotHash(data, _chunks.back().offset - CHUNK_HEADER);
+}
+
+const SnapshotReader::Chunk* SnapshotReader::findChunk(const char* tag) const {
+	for (const auto& chunk : _chunks) {
+		if (memcmp(chunk.tag, tag, 4) == 0) {
+			return &chunk;
+		}
+	}
+	return nullptr;
+}
+
+bool SnapshotReader::openChunk(const char* tag) {
+	auto chunk = findChunk(tag);
+	if (chunk == nullptr) {
+		return false;
+	}
+	_position = chunk->offset;
+	_end = chunk->offset + chunk->size;
+	return true;
+}
+
+uint8_t SnapshotReader::get8() {
+	if (_position >= _end) {
+		_failed = true;
+		return 0;
+	}
+	return _data[_position++];
+}
+
+uint16_t SnapshotReader::get16() {
+	uint16_t lo = get8();
+	return lo | (get8() << 8);
+}
+
+uint32_t SnapshotReader::get32() {
+	uint32_t lo = get16();
+	return lo | (static_cast<uint32_t>(get16()) << 16);
+}
+
+uint64_t SnapshotReader::get64() {
+	uint64_t lo = get32();
+	return lo | (static_cast<uint64_t>(get32()) << 32);
+}
+
+float SnapshotReader::getFloat() {
+	uint32_t bits = get32();
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+void SnapshotReader::getBytes(uint8_t* data, size_t size) {
+	if (size > _end - _position) {
+		_failed = true;
+		memset(data, 0, size);
+		return;
+	}
+	memcpy(data, _data + _position, size);
+	_position += size;
+}
+
+uint64_t snapshotHash(const uint8_t* data, size_t size) {
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (size_t i = 0; i < size; ++i) {
+		hash = (hash ^ data[i]) * 0x100000001B3ull;
+	}
+	return hash;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Machine snapshots: an 8 byte signature, the format version, then chunks. A chunk is a four character
+// tag, the length of its payload as 32 bits and the payload. Numbers are little endian. Each chip writes
+// its own chunk, and readers look chunks up by tag, so their order doesn't matter; the version changes
+// whenever the contents of a chunk do. The last chunk, "SUM ", holds a hash of everything before it:
+// a damaged snapshot could otherwise put the machine in a state it never gets out of.
+class SnapshotWriter {
+public:
+	static constexpr uint16_t VERSION = 1;
+	SnapshotWriter();
+	void beginChunk(const char* tag);
+	void endChunk();
+	void put8(uint8_t value);
+	void put16(uint16_t value);
+	void put32(uint32_t value);
+	void put64(uint64_t value);
+	void putFloat(float value);
+	void putBytes(const uint8_t* data, size_t size);
+	// appends the checksum, nothing can be written after it
+	void finish();
+	const std::vector<uint8_t>& getData() const;
+	std::vector<uint8_t>& getData();
+private:
+	std::vector<uint8_t> _data;
+	size_t _chunk;              // offset of the length of the open chunk
+};
+
+class SnapshotReader {
+public:
+	struct Chunk {
+		char tag[4];
+		size_t offset;              // of the payload
+		size_t size;
+	};
+	// the data is not copied and must outlive the reader. Check isValid() before anything else.
+	SnapshotReader(const uint8_t* data, size_t size);
+	// the signature, the version, the chunk lengths and the checksum are right
+	bool isValid() const;
+	const std::vector<Chunk>& getChunks() const;
+	// the chunk with the given tag, nullptr if there is none
+	const Chunk* findChunk(const char* tag) const;
+	// read from the start of the chunk with the given tag, false if there is none
+	bool openChunk(const char* tag);
+	// reads past the end of the open chunk return zeros and set the failed flag
+	uint8_t get8();
+	uint16_t get16();
+	uint32_t get32();
+	uint64_t get64();
+	float getFloat();
+	void getBytes(uint8_t* data, size_t size);
+	bool hasFailed() const;
+private:
+	const uint8_t* _data;
+	size_t _size;
+	bool _valid;
+	std::vector<Chunk> _chunks;
+	size_t _position;
+	size_t _end;                // of the open chunk
+	bool _failed;
+};
+
+// FNV-1a, to tell whether a snapshot was taken with the same ROMs
+uint64_t snapshotHash(const uint8_t* data, size_t size);
+
+inline const std::vector<uint8_t>& SnapshotWriter::getData() const {
+	return _data;
+}
+
+inline std::vector<uint8_t>& SnapshotWriter::getData() {
+	return _data;
+}
+
+inline bool SnapshotReader::isValid() const {
+	return _valid;
+}
+
+inline const std::vector<SnapshotReader::Chunk>& SnapshotReader::getChunks() const {
+	return _chunks;
+}
+
+inline bool SnapshotReader::hasFailed() const {
+	return _failed;
+}
@@ -0,0 +1,71 @@
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+
+TraceWriter::TraceWriter(const std::string& filename) : _buffer(CAPACITY), _head(0), _tail(0), _stop(false) {
+	_file = fopen(filename.c_str(), "wb");
+	if (_file == nullptr) {
+		return;
+	}
+	uint32_t header[2] = {TRACE_VERSION, sizeof(TraceRecord)};
+	fwrite(TRACE_MAGIC, sizeof(TRACE_MAGIC), 1, _file);
+	fwrite(header, sizeof(header), 1, _file);
+	_thread = std::thread(&TraceWriter::drain, this);
+}
+
+TraceWriter::~TraceWriter() {
+	if (_file == nullptr) {
+		return;
+	}
+	_stop.store(true, std::memory_order_release);
+	_thread.join();
+	fclose(_file);
+}
+
+void TraceWriter::drain() {
+	while (true) {
+		// read the stop flag first, so that everything pushed before it was set gets written
+		bool stop = _stop.load(std::memory_order_acquire);
+		auto tail = _tail.load(std::memory_order_relaxed);
+		auto head = _head.load(std::memory_order_acquire);
+		if (head == tail) {
+			if (stop) {
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		// write the filled part of the ring, at most up to the end of the buffer
+		auto first = tail & (CAPACITY - 1);
+		auto count = std::min(head - tail, CAPACITY - first);
+		fwrite(&_buffer[first], sizeof(TraceRecord), count, _file);
+		_tail.store(tail + count, std::memory_order_release);
+	}
+	fflush(_file);
+}
+
+TraceReader::TraceReader(const std::string& filename) {
+	_file = fopen(filename.c_str(), "rb");
+	if (_file == nullptr) {
+		return;
+	}
+	char magic[sizeof(TRACE_MAGIC)];
+	uint32_t header[2];
+	if (fread(magic, sizeof(magic), 1, _file) != 1 || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 ||
+		fread(header, sizeof(header), 1, _file) != 1 || header[0] != TRACE_VERSION || header[1] != sizeof(TraceRecord)) {
+		fclose(_file);
+		_file = nullptr;
+	}
+}
+
+TraceReader::~TraceReader() {
+	if (_file != nullptr) {
+		fclose(_file);
+	}
+}
+
+bool TraceReader::next(TraceRecord& record) {
+	return fread(&record, sizeof(TraceRecord), 1, _file) == 1;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One executed instruction, recorded before it runs. Records have a fixed size so that the
+// file is just a header followed by an array of them.
+struct TraceRecord {
+	uint64_t cycle;
+	uint16_t pc;
+	uint8_t bytes[3];           // opcode and operands, unused bytes are zero
+	uint8_t a, x, y, sp, status;
+	uint8_t reserved[6];
+};
+
+static_assert(sizeof(TraceRecord) == 24, "trace records are written to file as they are");
+
+inline const char TRACE_MAGIC[8] = {'C', '6', '4', 'T', 'R', 'A', 'C', 'E'};
+inline const uint32_t TRACE_VERSION = 1;
+
+// Writes trace records to a file. The emulation thread pushes records into a lock-free
+// single-producer/single-consumer ring buffer, a background thread drains it to disk.
+// When the buffer is full the producer waits: traces are never truncated.
+class TraceWriter {
+public:
+	explicit TraceWriter(const std::string& filename);
+	~TraceWriter();
+	bool isOpen() const;
+	void push(const TraceRecord& record);
+private:
+	void drain();
+	static constexpr size_t CAPACITY = 1 << 16;
+	std::vector<TraceRecord> _buffer;
+	alignas(64) std::atomic<size_t> _head;      // next slot written by the emulation thread
+	alignas(64) std::atomic<size_t> _tail;      // next slot read by the writer thread
+	std::atomic<bool> _stop;
+	FILE* _file;
+	std::thread _thread;
+};
+
+// Reads back a file written by TraceWriter.
+class TraceReader {
+public:
+	explicit TraceReader(const std::string& filename);
+	~TraceReader();
+	bool isOpen() const;
+	bool next(TraceRecord& record);
+private:
+	FILE* _file;
+};
+
+inline bool TraceWriter::isOpen() const {
+	return _file != nullptr;
+}
+
+inline void TraceWriter::push(const TraceRecord& record) {
+	auto head = _head.load(std::memory_order_relaxed);
+	while (head - _tail.load(std::memory_order_acquire) == CAPACITY) {
+		std::this_thread::yield();
+	}
+	_buffer[head & (CAPACITY - 1)] = record;
+	_head.store(head + 1, std::memory_order_release);
+}
+
+inline bool TraceReader::isOpen() const {
+	return _file != nullptr;
+}
@@ -0,0 +1,37 @@
+#include <iostream>
+#include <iomanip>
+#include "c64.h"
+
+// Turns a binary trace written by c64-headless --trace into text, one instruction per line.
+
+int main(int argc, char* argv[]) {
+	if (argc != 2) {
+		std::cerr << "usage: c64-tracedump file\n";
+		return 1;
+	}
+	TraceReader reader(argv[1]);
+	if (!reader.isOpen()) {
+		std::cerr << "Not a trace file: " << argv[1] << "\n";
+		return 1;
+	}
+	TraceRecord record;
+	std::cout << std::hex << std::setfill('0');
+	while (reader.next(record)) {
+		const auto& op = C64::getOpcodeInfo(record.bytes[0]);
+		std::cout << std::dec << std::setfill(' ') << std::setw(12) << record.cycle << std::hex << std::setfill('0')
+			<< "  " << std::setw(4) << (int) record.pc << "  ";
+		for (int i = 0; i < 3; ++i) {
+			if (i < op.bytes) {
+				std::cout << std::setw(2) << (int) record.bytes[i] << " ";
+			} else {
+				std::cout << "   ";
+			}
+		}
+		auto text = C64::disassemble(record.bytes, record.pc);
+		std::cout << text << std::string(text.size() < 14 ? 14 - text.size() : 1, ' ')
+			<< "A:" << std::setw(2) << (int) record.a << " X:" << std::setw(2) << (int) record.x
+			<< " Y:" << std::setw(2) << (int) record.y << " SP:" << std::setw(2) << (int) record.sp
+			<< " P:" << std::setw(2) << (int) record.status << "\n";
+	}
+	return 0;
+}
@@ -0,0 +1,203 @@
+#include "via.h"
+
+namespace {
+	// interrupt flags
+	const uint8_t IFR_CA2 = 0x01;
+	const uint8_t IFR_CA1 = 0x02;
+	const uint8_t IFR_CB2 = 0x08;
+	const uint8_t IFR_CB1 = 0x10;
+	const uint8_t IFR_TIMER_2 = 0x20;
+	const uint8_t IFR_TIMER_1 = 0x40;
+
+	// auxiliary control register bits
+	const uint8_t ACR_LATCH_A = 0x01;
+	const uint8_t ACR_FREE_RUN = 0x40;
+}
+
+VIA::VIA(Scheduler* scheduler, Event timer1, Event timer2) : _scheduler(scheduler), _ora(0), _orb(0), _ddra(0), _ddrb(0),
+	_inputA(0xFF), _inputB(0xFF), _latchA(0xFF), _sr(0), _acr(0), _pcr(0), _ifr(0), _ier(0), _ca1(false) {
+	_timer[TIMER_1] = {0xFFFF, 0xFFFF, 0, false, timer1};
+	_timer[TIMER_2] = {0xFFFF, 0xFFFF, 0, false, timer2};
+}
+
+bool VIA::freeRunning(TimerId id) const {
+	return id == TIMER_1 && (_acr & ACR_FREE_RUN);
+}
+
+uint16_t VIA::value(TimerId id, long cycle) const {
+	const Timer& timer = _timer[id];
+	long elapsed = cycle - timer.base;
+	// a free running timer shows $FFFF for the cycle between the underflow and the reload,
+	// a one shot timer keeps counting down through it
+	if (freeRunning(id)) {
+		return elapsed <= timer.counter ? timer.counter - elapsed : 0xFFFF;
+	}
+	return static_cast<uint16_t>(timer.counter - elapsed);
+}
+
+void VIA::freeze(TimerId id, long cycle) {
+	Timer& timer = _timer[id];
+	timer.counter = value(id, cycle);
+	timer.base = cycle;
+}
+
+void VIA::schedule(TimerId id) {
+	Timer& timer = _timer[id];
+	if (timer.armed || freeRunning(id)) {
+		_scheduler->schedule(timer.base + timer.counter + 1, timer.event);
+	} else {
+		_scheduler->cancel(timer.event);
+	}
+}
+
+void VIA::start(TimerId id, uint16_t counter, long cycle) {
+	Timer& timer = _timer[id];
+	timer.counter = counter;
+	timer.base = cycle;
+	timer.armed = true;
+	_ifr &= id == TIMER_1 ? ~IFR_TIMER_1 : ~IFR_TIMER_2;
+	schedule(id);
+}
+
+void VIA::underflow(TimerId id) {
+	Timer& timer = _timer[id];
+	_ifr |= id == TIMER_1 ? IFR_TIMER_1 : IFR_TIMER_2;
+	if (freeRunning(id)) {
+		// the reload takes one more cycle: the period is the latch + 2
+		timer.base += timer.counter + 2;
+		timer.counter = timer.latch;
+	} else {
+		// rebase on the underflow, the counter goes on from $FFFF
+		timer.base += timer.counter + 1;
+		timer.counter = 0xFFFF;
+		timer.armed = false;
+	}
+	schedule(id);
+}
+
+void VIA::latchA() {
+	_latchA = _inputA;
+}
+
+void VIA::setCA1(bool level) {
+	if (level == _ca1) {
+		return;
+	}
+	_ca1 = level;
+	// PCR bit 0 selects the positive edge
+	if (level == ((_pcr & 0x01) != 0)) {
+		pulseCA1();
+	}
+}
+
+void VIA::pulseCA1() {
+	_ifr |= IFR_CA1;
+	latchA();
+}
+
+uint8_t VIA::read(uint8_t reg, long cycle) {
+	switch (reg) {
+		case 0x0:
+			_ifr &= ~(IFR_CB1 | IFR_CB2);
+			return getPortB();
+		case 0x1:
+			_ifr &= ~(IFR_CA1 | IFR_CA2);
+			return (_acr & ACR_LATCH_A) ? (_ora & _ddra) | (_latchA & ~_ddra) : getPortA();
+		case 0x2:
+			return _ddrb;
+		case 0x3:
+			return _ddra;
+		case 0x4:
+			_ifr &= ~IFR_TIMER_1;
+			return value(TIMER_1, cycle) & 0xFF;
+		case 0x5:
+			return value(TIMER_1, cycle) >> 8;
+		case 0x6:
+			return _timer[TIMER_1].latch & 0xFF;
+		case 0x7:
+			return _timer[TIMER_1].latch >> 8;
+		case 0x8:
+			_ifr &= ~IFR_TIMER_2;
+			return value(TIMER_2, cycle) & 0xFF;
+		case 0x9:
+			return value(TIMER_2, cycle) >> 8;
+		case 0xA:
+			return _sr;
+		case 0xB:
+			return _acr;
+		case 0xC:
+			return _pcr;
+		case 0xD:
+			return _ifr | (irq() ? 0x80 : 0x00);
+		case 0xE:
+			return _ier | 0x80;
+		default:
+			// port A without handshake
+			return (_acr & ACR_LATCH_A) ? (_ora & _ddra) | (_latchA & ~_ddra) : getPortA();
+	}
+}
+
+void VIA::write(uint8_t reg, uint8_t value, long cycle) {
+	switch (reg) {
+		case 0x0:
+			_orb = value;
+			_ifr &= ~(IFR_CB1 | IFR_CB2);
+			break;
+		case 0x1:
+			_ora = value;
+			_ifr &= ~(IFR_CA1 | IFR_CA2);
+			break;
+		case 0x2:
+			_ddrb = value;
+			break;
+		case 0x3:
+			_ddra = value;
+			break;
+		case 0x4:
+		case 0x6:
+			_timer[TIMER_1].latch = (_timer[TIMER_1].latch & 0xFF00) | value;
+			break;
+		case 0x5:
+			// loads the counter from the latch and starts the timer
+			_timer[TIMER_1].latch = (_timer[TIMER_1].latch & 0x00FF) | (value << 8);
+			start(TIMER_1, _timer[TIMER_1].latch, cycle);
+			break;
+		case 0x7:
+			_timer[TIMER_1].latch = (_timer[TIMER_1].latch & 0x00FF) | (value << 8);
+			_ifr &= ~IFR_TIMER_1;
+			break;
+		case 0x8:
+			_timer[TIMER_2].latch = (_timer[TIMER_2].latch & 0xFF00) | value;
+			break;
+		case 0x9:
+			_timer[TIMER_2].latch = (_timer[TIMER_2].latch & 0x00FF) | (value << 8);
+			start(TIMER_2, _timer[TIMER_2].latch, cycle);
+			break;
+		case 0xA:
+			_sr = value;
+			break;
+		case 0xB:
+			freeze(TIMER_1, cycle);
+			_acr = value;
+			schedule(TIMER_1);
+			break;
+		case 0xC:
+			_pcr = value;
+			break;
+		case 0xD:
+			// writing ones clears the flags
+			_ifr &= ~value;
+			break;
+		case 0xE:
+			// bit 7 tells whether the other bits set or clear mask bits
+			if (value & 0x80) {
+				_ier |= value & 0x7F;
+			} else {
+				_ier &= ~value & 0x7F;
+			}
+			break;
+		default:
+			_ora = value;
+			break;
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include "scheduler.h"
+
+// MOS 6522 Versatile Interface Adapter, the I/O chip of the 1541. Timers are lazy like those of
+// the CIA: a running timer keeps the value it had at a given cycle and the underflow that raises
+// its interrupt flag is an event. The shift register and pulse counting are not emulated,
+// nothing in the drive uses them.
+class VIA {
+public:
+	enum TimerId {
+		TIMER_1, TIMER_2
+	};
+	VIA(Scheduler* scheduler, Event timer1, Event timer2);
+	// registers are mirrored every 16 bytes, reg is the address modulo 16
+	uint8_t read(uint8_t reg, long cycle);
+	void write(uint8_t reg, uint8_t value, long cycle);
+	// event handler
+	void underflow(TimerId id);
+	bool irq() const;
+	// what the port pins show: outputs as programmed, inputs as driven from outside
+	uint8_t getPortA() const;
+	uint8_t getPortB() const;
+	// what the port drives: outputs as programmed, 0 on input pins
+	uint8_t getOutputA() const;
+	uint8_t getOutputB() const;
+	void setInputA(uint8_t value);
+	void setInputB(uint8_t value);
+	// the CA1 input raises its interrupt flag on the edge selected by the PCR, and latches port A
+	// when latching is enabled
+	void setCA1(bool level);
+	// an active edge on CA1, whatever the edge selected
+	void pulseCA1();
+	// levels of the CA2 and CB2 pins in manual output mode, high otherwise
+	bool getCA2() const;
+	bool getCB2() const;
+private:
+	struct Timer {
+		uint16_t latch;
+		uint16_t counter;           // the value at cycle base
+		long base;
+		bool armed;                 // the next underflow raises the interrupt flag
+		Event event;
+	};
+	bool freeRunning(TimerId id) const;
+	uint16_t value(TimerId id, long cycle) const;
+	// make the counter current, before the way it counts changes
+	void freeze(TimerId id, long cycle);
+	void schedule(TimerId id);
+	void start(TimerId id, uint16_t counter, long cycle);
+	void latchA();
+	Scheduler* _scheduler;
+	Timer _timer[2];
+	uint8_t _ora, _orb, _ddra, _ddrb;
+	uint8_t _inputA, _inputB;
+	uint8_t _latchA;            // port A as it was on the last CA1 edge
+	uint8_t _sr, _acr, _pcr;
+	uint8_t _ifr, _ier;
+	bool _ca1;
+};
+
+inline bool VIA::irq() const {
+	return (_ifr & _ier & 0x7F) != 0;
+}
+
+inline uint8_t VIA::getPortA() const {
+	return (_ora & _ddra) | (_inputA & ~_ddra);
+}
+
+inline uint8_t VIA::getPortB() const {
+	return (_orb & _ddrb) | (_inputB & ~_ddrb);
+}
+
+inline uint8_t VIA::getOutputA() const {
+	return _ora & _ddra;
+}
+
+inline uint8_t VIA::getOutputB() const {
+	return _orb & _ddrb;
+}
+
+inline void VIA::setInputA(uint8_t value) {
+	_inputA = value;
+}
+
+inline void VIA::setInputB(uint8_t value) {
+	_inputB = value;
+}
+
+inline bool VIA::getCA2() const {
+	return (_pcr & 0x0E) != 0x0C;
+}
+
+inline bool VIA::getCB2() const {
+	return (_pcr & 0xE0) != 0xC0;
+}
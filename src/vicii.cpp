@@ -1,15 +1,539 @@
 #include "vicii.h"
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "snapshot.h"
 
-VICII::VICII() {
+namespace {
+	// first raster line shown in the framebuffer, and where the 320 pixel display column starts in it
+	const int FIRST_VISIBLE_LINE = 16;
+	const int BORDER_LEFT = 32;
+	// raster lines of the display window with 25 and 24 rows
+	const int WINDOW_TOP[2] = {55, 51};
+	const int WINDOW_BOTTOM[2] = {247, 251};
+	// character rows are fetched on lines $30-$F7
+	const int FIRST_TEXT_LINE = 0x30;
+	const int LAST_TEXT_LINE = 0xF7;
+	// a badline takes the bus from cycle 12 of the line for the 40 character fetches
+	const int BADLINE_CYCLE = 12;
+	const int BADLINE_STALL = 40;
 
+	// Expansion tables: a graphics byte turned into 8 pixels at once. Each entry has 0xFF in the bytes
+	// (pixels) to paint and 0x00 elsewhere, pixel 0 being bit 7.
+	struct Tables {
+		uint64_t hires[256];
+		// two pixels per bit pair, one mask per pair value
+		uint64_t multicolor[4][256];
+	};
+
+	Tables makeTables() {
+		Tables t;
+		for (int value = 0; value < 256; ++value) {
+			uint8_t hires[8];
+			uint8_t multicolor[4][8] = {};
+			for (int pixel = 0; pixel < 8; ++pixel) {
+				hires[pixel] = (value & (0x80 >> pixel)) ? 0xFF : 0x00;
+				int pair = (value >> (6 - (pixel & 6))) & 3;
+				multicolor[pair][pixel] = 0xFF;
+			}
+			memcpy(&t.hires[value], hires, 8);
+			for (int pair = 0; pair < 4; ++pair) {
+				memcpy(&t.multicolor[pair][value], multicolor[pair], 8);
+			}
+		}
+		return t;
+	}
+
+	const Tables TABLES = makeTables();
+
+	// a color in all 8 pixels
+	inline uint64_t splat(uint8_t color) {
+		return (color & 0x0F) * 0x0101010101010101ULL;
+	}
+
+	inline uint64_t hires(uint8_t bits, uint64_t foreground, uint64_t background) {
+		uint64_t mask = TABLES.hires[bits];
+		return (foreground & mask) | (background & ~mask);
+	}
+
+	// in multicolor modes pairs 00 and 01 are background for sprite priority and collisions
+	inline uint64_t multicolorForeground(uint8_t bits) {
+		return TABLES.multicolor[2][bits] | TABLES.multicolor[3][bits];
+	}
+
+	inline uint64_t multicolor(uint8_t bits, uint64_t c0, uint64_t c1, uint64_t c2, uint64_t c3) {
+		return (c0 & TABLES.multicolor[0][bits]) | (c1 & TABLES.multicolor[1][bits]) |
+			(c2 & TABLES.multicolor[2][bits]) | (c3 & TABLES.multicolor[3][bits]);
+	}
+
+	// bits that are not connected read back as 1
+	const uint8_t UNUSED_BITS[64] = {
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x01, 0x70, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+	};
+}
+
+VICII::VICII(Mode mode) : _cycle(0), _rasterLine(0), _rasterCycle(0), _rasterCompare(0), _displayEnabled(false),
+	_scheduler(nullptr), _ram(nullptr), _charRom(nullptr), _colorRam(nullptr), _bank(0) {
+	memset(_reg, 0, sizeof(_reg));
+	_numberOfLines = NUMBER_OF_LINES[static_cast<int>(mode)];
+	_cyclesPerLine = CYCLES_PER_LINE[static_cast<int>(mode)];
+	_visibleWidth = mode == Mode::PAL ? settings::PAL_VISIBLE_WIDTH : settings::NTSC_VISIBLE_WIDTH;
+	_visibleHeight = mode == Mode::PAL ? settings::PAL_VISIBLE_HEIGHT : settings::NTSC_VISIBLE_HEIGHT;
+}
+
+void VICII::setMemory(const uint8_t* const* ram, const uint8_t* charRom, const uint8_t* colorRam) {
+	_ram = ram;
+	_charRom = charRom;
+	_colorRam = colorRam;
+	updateBank();
+}
+
+void VICII::setScheduler(Scheduler* scheduler) {
+	_scheduler = scheduler;
+	scheduleRasterIrq();
+	scheduleBadline();
+}
+
+long VICII::nextCycleAt(int line, int cycleInLine) const {
+	long lineStart = _cycle - _rasterCycle;
+	int lines = (line - _rasterLine + _numberOfLines) % _numberOfLines;
+	long cycle = lineStart + static_cast<long>(lines) * _cyclesPerLine + cycleInLine;
+	if (cycle <= _cycle) {
+		cycle += static_cast<long>(_numberOfLines) * _cyclesPerLine;
+	}
+	return cycle;
+}
+
+void VICII::scheduleRasterIrq() {
+	// the comparison is made in cycle 0 of each line, cycle 1 on line 0. Lines past the bottom never match.
+	if (_rasterCompare >= _numberOfLines) {
+		_scheduler->cancel(Event::RASTER_IRQ);
+		return;
+	}
+	_scheduler->schedule(nextCycleAt(_rasterCompare, _rasterCompare == 0 ? 1 : 0), Event::RASTER_IRQ);
+}
+
+void VICII::rasterIrq() {
+	_reg[0x19] |= 0x01;
+	scheduleRasterIrq();
+}
+
+void VICII::scheduleBadline() {
+	// the next line whose low 3 bits match the vertical scroll, within the character fetch lines
+	int yscroll = _reg[0x11] & 0x07;
+	int line = _rasterLine + (_rasterCycle >= BADLINE_CYCLE ? 1 : 0);
+	if (line < FIRST_TEXT_LINE || line > LAST_TEXT_LINE) {
+		line = FIRST_TEXT_LINE;
+	}
+	line += (yscroll - line) & 7;
+	if (line > LAST_TEXT_LINE) {
+		line = FIRST_TEXT_LINE + yscroll;
+	}
+	_scheduler->schedule(nextCycleAt(line, BADLINE_CYCLE), Event::BADLINE);
 }
 
+int VICII::badline() {
+	// DEN is latched on line $30, including for the badline of that line
+	if (_rasterLine == FIRST_TEXT_LINE) {
+		_displayEnabled = _reg[0x11] & 0x10;
+	}
+	scheduleBadline();
+	return _displayEnabled ? BADLINE_STALL : 0;
+}
 
+void VICII::setBank(int bank) {
+	_bank = bank & 3;
+	updateBank();
+}
 
+void VICII::updateBank() {
+	for (int page = 0; page < 64; ++page) {
+		if ((_bank & 1) == 0 && (page >> 4) == 1) {
+			_bankPage[page] = &_charRom[(page & 0x0F) << 8];
+		} else {
+			_bankPage[page] = _ram[(_bank << 6) + page];
+		}
+	}
+}
 
-uint8_t * VICII::getPtr(int value) {
-	if (value < 47) {
-		return &_reg[value];
+uint8_t VICII::read(uint8_t reg) {
+	switch (reg) {
+		case 0x1E:
+		case 0x1F: {
+			// collision registers clear when read
+			uint8_t value = _reg[reg];
+			_reg[reg] = 0;
+			return value;
+		}
+		case 0x11:
+			// bit 7 is bit 8 of the current raster line
+			return (_reg[0x11] & 0x7F) | ((_rasterLine & 0x100) >> 1);
+		case 0x12:
+			return _rasterLine & 0xFF;
+		case 0x19:
+			// bit 7 reports whether the IRQ line is asserted
+			return _reg[0x19] | (irq() ? 0x80 : 0x00) | 0x70;
+		default:
+			return _reg[reg] | UNUSED_BITS[reg];
+	}
+}
+
+void VICII::write(uint8_t reg, uint8_t value) {
+	switch (reg) {
+		case 0x11:
+		case 0x12: {
+			_reg[reg] = value;
+			int compare = reg == 0x11 ? (_rasterCompare & 0xFF) | ((value & 0x80) << 1) : (_rasterCompare & 0x100) | value;
+			if (compare != _rasterCompare) {
+				_rasterCompare = compare;
+				// moving the compare line onto the current line triggers at once
+				if (compare == _rasterLine) {
+					_reg[0x19] |= 0x01;
+				}
+				scheduleRasterIrq();
+			}
+			if (reg == 0x11) {
+				scheduleBadline();
+			}
+			break;
+		}
+		case 0x19:
+			// writing 1 acknowledges an interrupt
+			_reg[0x19] &= ~value & 0x0F;
+			break;
+		case 0x1A:
+			_reg[0x1A] = value & 0x0F;
+			break;
+		case 0x1E:
+		case 0x1F:
+			// collision registers are read only
+			break;
+		default:
+			_reg[reg] = value;
+			break;
+	}
+}
+
+void VICII::run(long cycle) {
+	_rasterCycle += cycle - _cycle;
+	_cycle = cycle;
+	while (_rasterCycle >= _cyclesPerLine) {
+		_rasterCycle -= _cyclesPerLine;
+		renderLine(_rasterLine);
+		if (++_rasterLine == _numberOfLines) {
+			_rasterLine = 0;
+		}
+	}
+}
+
+void VICII::renderLine(int line) {
+	if (line == FIRST_TEXT_LINE) {
+		_displayEnabled = _reg[0x11] & 0x10;
+	}
+	if (line < FIRST_VISIBLE_LINE || line >= FIRST_VISIBLE_LINE + _visibleHeight) {
+		return;
+	}
+	int width = _visibleWidth;
+	uint8_t border = _reg[0x20] & 0x0F;
+	int rsel = (_reg[0x11] >> 3) & 1;
+	bool verticalBorder = !_displayEnabled || line < WINDOW_TOP[rsel] || line >= WINDOW_BOTTOM[rsel];
+	memset(_foreground, 0, sizeof(_foreground));
+	if (!verticalBorder) {
+		renderGraphics(line);
 	}
-	return nullptr;
-}
\ No newline at end of file
+	// sprites are drawn under the border, but they still collide with each other there
+	if (_reg[0x15] != 0) {
+		renderSprites(line);
+	}
+
+	uint8_t* out = frame() + (line - FIRST_VISIBLE_LINE) * width;
+	if (verticalBorder) {
+		memset(out, border, width);
+		return;
+	}
+	memset(out, border, BORDER_LEFT);
+	memcpy(out + BORDER_LEFT, _line + BORDER_LEFT, 320);
+	memset(out + BORDER_LEFT + 320, border, width - BORDER_LEFT - 320);
+	// 38 columns: the border covers 7 more pixels on the left and 9 on the right
+	if ((_reg[0x16] & 0x08) == 0) {
+		memset(out + BORDER_LEFT, border, 7);
+		memset(out + BORDER_LEFT + 311, border, 9);
+	}
+}
+
+void VICII::renderGraphics(int line) {
+	// the graphics are drawn xscroll pixels to the right, the gap showing the background color
+	int xscroll = _reg[0x16] & 0x07;
+	int yscroll = _reg[0x11] & 0x07;
+	memset(_line + BORDER_LEFT, _reg[0x21] & 0x0F, xscroll);
+	uint8_t* display = _line + BORDER_LEFT + xscroll;
+	uint8_t* foreground = _foreground + BORDER_LEFT + xscroll;
+	int ecm = (_reg[0x11] >> 6) & 1;
+	int bmm = (_reg[0x11] >> 5) & 1;
+	int mcm = (_reg[0x16] >> 4) & 1;
+	int firstRowLine = FIRST_TEXT_LINE + yscroll;
+	int row = (line - firstRowLine) >> 3;
+	if (line < firstRowLine || line > LAST_TEXT_LINE || row >= 25) {
+		// idle state: the chip shows the last byte of the bank, in black
+		uint8_t bits = fetch(ecm ? 0x39FF : 0x3FFF);
+		uint64_t pixels = hires(bits, 0, bmm ? 0 : splat(_reg[0x21]));
+		for (int col = 0; col < 40; ++col) {
+			memcpy(display + col * 8, &pixels, 8);
+			memcpy(foreground + col * 8, &TABLES.hires[bits], 8);
+		}
+		return;
+	}
+	int rowInChar = (line - firstRowLine) & 7;
+	switch ((ecm << 2) | (bmm << 1) | mcm) {
+		case 0:
+			renderText(display, foreground, row, rowInChar);
+			break;
+		case 1:
+			renderMulticolorText(display, foreground, row, rowInChar);
+			break;
+		case 2:
+			renderBitmap(display, foreground, row, rowInChar);
+			break;
+		case 3:
+			renderMulticolorBitmap(display, foreground, row, rowInChar);
+			break;
+		case 4:
+			renderExtendedText(display, foreground, row, rowInChar);
+			break;
+		default:
+			// invalid modes display black
+			memset(display, 0, 320);
+			break;
+	}
+}
+
+void VICII::renderSprites(int line) {
+	memset(_spriteOwner, 0, sizeof(_spriteOwner));
+	uint16_t pointers = ((_reg[0x18] & 0xF0) << 6) + 0x3F8;
+	uint8_t spriteCollision = 0;
+	uint8_t backgroundCollision = 0;
+	// sprite 0 has the highest priority: it goes first and later sprites only fill the pixels left free
+	for (int sprite = 0; sprite < 8; ++sprite) {
+		uint8_t bit = 1 << sprite;
+		if ((_reg[0x15] & bit) == 0) {
+			continue;
+		}
+		bool expandY = _reg[0x17] & bit;
+		int row = line - _reg[0x01 + 2 * sprite] - 1;
+		if (row < 0 || row >= (expandY ? 42 : 21)) {
+			continue;
+		}
+		if (expandY) {
+			row >>= 1;
+		}
+		uint16_t data = fetch(pointers + sprite) * 64 + row * 3;
+
+		// one row of the sprite as colors and an opaque mask, 24 pixels or 48 when expanded in X
+		alignas(16) uint8_t color[SPRITE_ROW] = {};
+		alignas(16) uint8_t opaque[SPRITE_ROW] = {};
+		uint64_t spriteColor = splat(_reg[0x27 + sprite]);
+		bool multicolorSprite = _reg[0x1C] & bit;
+		for (int i = 0; i < 3; ++i) {
+			uint8_t bits = fetch(data + i);
+			uint64_t pixels, mask;
+			if (multicolorSprite) {
+				pixels = multicolor(bits, 0, splat(_reg[0x25]), spriteColor, splat(_reg[0x26]));
+				mask = ~TABLES.multicolor[0][bits];
+			} else {
+				pixels = spriteColor;
+				mask = TABLES.hires[bits];
+			}
+			pixels &= mask;
+			memcpy(color + i * 8, &pixels, 8);
+			memcpy(opaque + i * 8, &mask, 8);
+		}
+		int width = 24;
+		if (_reg[0x1D] & bit) {
+			for (int i = 23; i >= 0; --i) {
+				color[2 * i] = color[2 * i + 1] = color[i];
+				opaque[2 * i] = opaque[2 * i + 1] = opaque[i];
+			}
+			width = 48;
+		}
+
+		int x = _reg[0x00 + 2 * sprite] | ((_reg[0x10] & bit) ? 0x100 : 0);
+		// sprite X 24 is the first pixel of the 40 column display window
+		int offset = x - 24 + BORDER_LEFT;
+		if (offset < 0 || offset >= _visibleWidth) {
+			continue;
+		}
+		bool behind = _reg[0x1B] & bit;
+		uint8_t overlap = 0, background = 0;
+		blendSprite(offset, width, color, opaque, bit, behind, overlap, background);
+		if (overlap != 0) {
+			spriteCollision |= overlap | bit;
+		}
+		if (background != 0) {
+			backgroundCollision |= bit;
+		}
+	}
+	// the interrupt latch is set when a collision register goes from zero to non zero
+	if (spriteCollision != 0 && _reg[0x1E] == 0) {
+		_reg[0x19] |= 0x04;
+	}
+	if (backgroundCollision != 0 && _reg[0x1F] == 0) {
+		_reg[0x19] |= 0x02;
+	}
+	_reg[0x1E] |= spriteCollision;
+	_reg[0x1F] |= backgroundCollision;
+}
+
+#ifdef __SSE2__
+
+void VICII::blendSprite(int offset, int width, const uint8_t* color, const uint8_t* opaque, uint8_t bit, bool behind,
+	uint8_t& overlap, uint8_t& background) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i owner = _mm_set1_epi8(static_cast<char>(bit));
+	const __m128i priority = behind ? _mm_set1_epi8(-1) : zero;
+	__m128i overlapAcc = zero;
+	__m128i backgroundAcc = zero;
+	for (int i = 0; i < width; i += 16) {
+		uint8_t* line = _line + offset + i;
+		uint8_t* foreground = _foreground + offset + i;
+		uint8_t* owners = _spriteOwner + offset + i;
+		__m128i m = _mm_load_si128(reinterpret_cast<const __m128i*>(opaque + i));
+		__m128i c = _mm_load_si128(reinterpret_cast<const __m128i*>(color + i));
+		__m128i fg = _mm_loadu_si128(reinterpret_cast<const __m128i*>(foreground));
+		__m128i own = _mm_loadu_si128(reinterpret_cast<const __m128i*>(owners));
+		__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line));
+		overlapAcc = _mm_or_si128(overlapAcc, _mm_and_si128(m, own));
+		backgroundAcc = _mm_or_si128(backgroundAcc, _mm_and_si128(m, fg));
+		// visible where opaque, not taken by a sprite with higher priority and not behind the foreground
+		__m128i free = _mm_cmpeq_epi8(own, zero);
+		__m128i visible = _mm_andnot_si128(_mm_and_si128(fg, priority), _mm_and_si128(m, free));
+		pixels = _mm_or_si128(_mm_andnot_si128(visible, pixels), _mm_and_si128(visible, c));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(line), pixels);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(owners), _mm_or_si128(own, _mm_and_si128(m, owner)));
+	}
+	alignas(16) uint8_t lanes[16];
+	_mm_store_si128(reinterpret_cast<__m128i*>(lanes), overlapAcc);
+	for (auto lane : lanes) {
+		overlap |= lane;
+	}
+	background = _mm_movemask_epi8(_mm_cmpeq_epi8(backgroundAcc, zero)) != 0xFFFF;
+}
+
+#else
+
+void VICII::blendSprite(int offset, int width, const uint8_t* color, const uint8_t* opaque, uint8_t bit, bool behind,
+	uint8_t& overlap, uint8_t& background) {
+	for (int i = 0; i < width; ++i) {
+		uint8_t& owner = _spriteOwner[offset + i];
+		bool fg = _foreground[offset + i] != 0;
+		if (opaque[i] == 0) {
+			continue;
+		}
+		overlap |= owner;
+		background |= fg;
+		if (owner == 0 && !(behind && fg)) {
+			_line[offset + i] = color[i];
+		}
+		owner |= bit;
+	}
+}
+
+#endif
+
+void VICII::renderText(uint8_t* out, uint8_t* foreground, int row, int rowInChar) {
+	uint16_t screen = (_reg[0x18] & 0xF0) << 6;
+	uint16_t chars = ((_reg[0x18] & 0x0E) << 10) + rowInChar;
+	uint64_t background = splat(_reg[0x21]);
+	for (int col = 0, cell = row * 40; col < 40; ++col, ++cell) {
+		uint8_t bits = fetch(chars + fetch(screen + cell) * 8);
+		uint64_t pixels = hires(bits, splat(_colorRam[cell]), background);
+		memcpy(out + col * 8, &pixels, 8);
+		memcpy(foreground + col * 8, &TABLES.hires[bits], 8);
+	}
+}
+
+void VICII::renderMulticolorText(uint8_t* out, uint8_t* foreground, int row, int rowInChar) {
+	uint16_t screen = (_reg[0x18] & 0xF0) << 6;
+	uint16_t chars = ((_reg[0x18] & 0x0E) << 10) + rowInChar;
+	uint64_t background0 = splat(_reg[0x21]);
+	uint64_t background1 = splat(_reg[0x22]);
+	uint64_t background2 = splat(_reg[0x23]);
+	for (int col = 0, cell = row * 40; col < 40; ++col, ++cell) {
+		uint8_t bits = fetch(chars + fetch(screen + cell) * 8);
+		uint8_t color = _colorRam[cell];
+		// bit 3 of the color selects multicolor for the character, otherwise it is hires in colors 0-7
+		uint64_t pixels, mask;
+		if (color & 0x08) {
+			pixels = multicolor(bits, background0, background1, background2, splat(color & 0x07));
+			mask = multicolorForeground(bits);
+		} else {
+			pixels = hires(bits, splat(color & 0x07), background0);
+			mask = TABLES.hires[bits];
+		}
+		memcpy(out + col * 8, &pixels, 8);
+		memcpy(foreground + col * 8, &mask, 8);
+	}
+}
+
+void VICII::renderExtendedText(uint8_t* out, uint8_t* foreground, int row, int rowInChar) {
+	uint16_t screen = (_reg[0x18] & 0xF0) << 6;
+	uint16_t chars = ((_reg[0x18] & 0x0E) << 10) + rowInChar;
+	for (int col = 0, cell = row * 40; col < 40; ++col, ++cell) {
+		// the two high bits of the code pick one of the four background colors
+		uint8_t code = fetch(screen + cell);
+		uint8_t bits = fetch(chars + (code & 0x3F) * 8);
+		uint64_t pixels = hires(bits, splat(_colorRam[cell]), splat(_reg[0x21 + (code >> 6)]));
+		memcpy(out + col * 8, &pixels, 8);
+		memcpy(foreground + col * 8, &TABLES.hires[bits], 8);
+	}
+}
+
+void VICII::renderBitmap(uint8_t* out, uint8_t* foreground, int row, int rowInChar) {
+	uint16_t screen = (_reg[0x18] & 0xF0) << 6;
+	uint16_t bitmap = ((_reg[0x18] & 0x08) << 10) + rowInChar;
+	for (int col = 0, cell = row * 40; col < 40; ++col, ++cell) {
+		uint8_t bits = fetch(bitmap + cell * 8);
+		uint8_t colors = fetch(screen + cell);
+		uint64_t pixels = hires(bits, splat(colors >> 4), splat(colors));
+		memcpy(out + col * 8, &pixels, 8);
+		memcpy(foreground + col * 8, &TABLES.hires[bits], 8);
+	}
+}
+
+void VICII::renderMulticolorBitmap(uint8_t* out, uint8_t* foreground, int row, int rowInChar) {
+	uint16_t screen = (_reg[0x18] & 0xF0) << 6;
+	uint16_t bitmap = ((_reg[0x18] & 0x08) << 10) + rowInChar;
+	uint64_t background = splat(_reg[0x21]);
+	for (int col = 0, cell = row * 40; col < 40; ++col, ++cell) {
+		uint8_t bits = fetch(bitmap + cell * 8);
+		uint8_t colors = fetch(screen + cell);
+		uint64_t pixels = multicolor(bits, background, splat(colors >> 4), splat(colors), splat(_colorRam[cell]));
+		uint64_t mask = multicolorForeground(bits);
+		memcpy(out + col * 8, &pixels, 8);
+		memcpy(foreground + col * 8, &mask, 8);
+	}
+}
+
+void VICII::save(SnapshotWriter& out) const {
+	out.putBytes(_reg, sizeof(_reg));
+	out.put64(_cycle);
+	out.put16(_rasterLine);
+	out.put16(_rasterCycle);
+	out.put16(_rasterCompare);
+	out.put8(_displayEnabled);
+	out.put8(_bank);
+}
+
+void VICII::load(SnapshotReader& in) {
+	in.getBytes(_reg, sizeof(_reg));
+	_cycle = static_cast<long>(in.get64());
+	_rasterLine = in.get16();
+	_rasterCycle = in.get16();
+	_rasterCompare = in.get16();
+	_displayEnabled = in.get8();
+	_bank = in.get8() & 3;
+	updateBank();
+}
@@ -1,12 +1,143 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
+#include "settings.h"
+#include "scheduler.h"
 
+class SnapshotWriter;
+class SnapshotReader;
 
+// RGB values of the 16 colors
+inline const uint8_t PALETTE[16][3] = {
+	{0, 0, 0},           // 0 = black
+	{255, 255, 255},     // 1 = white
+	{136, 0, 0},         // 2 = red
+	{170, 255, 238},     // 3 = cyan
+	{204, 68, 204},      // 4 = purple
+	{0, 204, 85},        // 5 = green
+	{0, 0, 170},         // 6 = blue
+	{238, 238, 119},     // 7 = yellow
+	{221, 136, 85},      // 8 = orange
+	{102, 68, 0},        // 9 = brown
+	{255, 119, 119},     // 10 = light red
+	{51, 51, 51},        // 11 = dark grey
+	{119, 119, 119},     // 12 = grey 2
+	{170, 255, 102},     // 13 = light green
+	{0, 136, 255},       // 14 = light blue
+	{187, 187, 187}      // 15 = light grey
+};
+
+// The video chip. It renders a whole raster line at a time, when the beam reaches the end of it,
+// so register changes made by the CPU take effect from the line being drawn.
 class VICII {
 public:
-	VICII();
-	uint8_t* getPtr(int);
+	explicit VICII(Mode mode);
+	// memory seen by the chip: the 256 pages of RAM, the character ROM and the 1K x 4 bit color RAM.
+	// The page table is the machine's, call again when it changes.
+	void setMemory(const uint8_t* const* ram, const uint8_t* charRom, const uint8_t* colorRam);
+	// select the 16K bank the chip reads from, 0 = $0000-$3FFF ... 3 = $C000-$FFFF
+	void setBank(int bank);
+	// registers are mirrored every 64 bytes in $D000-$D3FF, reg is the address modulo 64
+	uint8_t read(uint8_t reg);
+	void write(uint8_t reg, uint8_t value);
+	// catch up with the CPU: advance the beam to the given clock cycle
+	void run(long cycle);
+	int getRasterLine() const;
+	// the chip puts its raster interrupt and badline events in the machine's queue
+	void setScheduler(Scheduler* scheduler);
+	// state of the IRQ output
+	bool irq() const;
+	// handlers of the events scheduled by the chip, called once the chip has been run up to them.
+	// badline returns the number of cycles the CPU is stalled for.
+	void rasterIrq();
+	int badline();
+	// visible area as palette indices, one byte per pixel
+	const uint8_t* getFrameBuffer() const;
+	int getVisibleWidth() const;
+	int getVisibleHeight() const;
+	// registers and beam position; the frame buffer is output, not state, and is redrawn from there
+	void save(SnapshotWriter& out) const;
+	void load(SnapshotReader& in);
 private:
-	uint8_t* _reg;
-};
\ No newline at end of file
+	void updateBank();
+	// the next clock cycle, after the current one, at which the beam is at the given line and cycle
+	long nextCycleAt(int line, int cycleInLine) const;
+	void scheduleRasterIrq();
+	void scheduleBadline();
+	void renderLine(int line);
+	void renderGraphics(int line);
+	// graphics of the display window for one line: 320 pixels at out and 0xFF in foreground
+	// for the pixels that count as foreground for sprite priority and collisions
+	void renderText(uint8_t* out, uint8_t* foreground, int row, int rowInChar);
+	void renderMulticolorText(uint8_t* out, uint8_t* foreground, int row, int rowInChar);
+	void renderExtendedText(uint8_t* out, uint8_t* foreground, int row, int rowInChar);
+	void renderBitmap(uint8_t* out, uint8_t* foreground, int row, int rowInChar);
+	void renderMulticolorBitmap(uint8_t* out, uint8_t* foreground, int row, int rowInChar);
+	void renderSprites(int line);
+	// draw one sprite row over _line at offset, SSE2 when available. overlap gets the sprites already
+	// drawn under it, background whether it hit foreground graphics.
+	void blendSprite(int offset, int width, const uint8_t* color, const uint8_t* opaque, uint8_t bit, bool behind,
+		uint8_t& overlap, uint8_t& background);
+	// a byte in the 16K bank, as the VIC-II sees it
+	uint8_t fetch(uint16_t address) const;
+	uint8_t _reg[64];
+	long _cycle;                // clock cycle the chip has been run up to
+	int _rasterLine;
+	int _rasterCycle;           // cycle within the current raster line
+	int _rasterCompare;         // line written to $D012 and bit 7 of $D011
+	int _numberOfLines;
+	int _cyclesPerLine;
+	// the geometry is kept per chip, so that PAL and NTSC machines can run side by side
+	int _visibleWidth;
+	int _visibleHeight;
+	bool _displayEnabled;       // DEN as latched on line $30
+	Scheduler* _scheduler;
+	const uint8_t* const* _ram;
+	const uint8_t* _charRom;
+	const uint8_t* _colorRam;
+	int _bank;
+	// the 16K bank in pages: the character ROM shows up at $1000-$1FFF of banks 0 and 2
+	const uint8_t* _bankPage[64];
+	// the line being drawn, in framebuffer coordinates. It is wide enough for a sprite at any X
+	// position, so sprites are never clipped while blending.
+	static const int LINE_BUFFER = 640;
+	static const int SPRITE_ROW = 48;
+	uint8_t _line[LINE_BUFFER];
+	uint8_t _foreground[LINE_BUFFER];
+	uint8_t _spriteOwner[LINE_BUFFER];   // bit n set where sprite n has an opaque pixel
+	// allocated when first drawn into or asked for: forks that never run don't pay for it
+	mutable std::vector<uint8_t> _frame;
+	uint8_t* frame() const;
+};
+
+inline int VICII::getRasterLine() const {
+	return _rasterLine;
+}
+
+inline bool VICII::irq() const {
+	return (_reg[0x19] & _reg[0x1A] & 0x0F) != 0;
+}
+
+inline const uint8_t* VICII::getFrameBuffer() const {
+	return frame();
+}
+
+inline uint8_t* VICII::frame() const {
+	if (_frame.empty()) {
+		_frame.resize(_visibleWidth * _visibleHeight, 0);
+	}
+	return _frame.data();
+}
+
+inline int VICII::getVisibleWidth() const {
+	return _visibleWidth;
+}
+
+inline int VICII::getVisibleHeight() const {
+	return _visibleHeight;
+}
+
+inline uint8_t VICII::fetch(uint16_t address) const {
+	return _bankPage[(address >> 8) & 0x3F][address & 0xFF];
+}
@@ -0,0 +1,61 @@
+#include "workpool.h"
+#include <algorithm>
+#include <thread>
+
+
+WorkPool::WorkPool(unsigned threads) : _threads(threads) {
+	if (_threads == 0) {
+		_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	for (unsigned i = 0; i < _threads; ++i) {
+		_queues.push_back(std::make_unique<Queue>());
+	}
+}
+
+void WorkPool::run(size_t count, const std::function<void(size_t)>& job) {
+	// no job is added once the batch has started, so a worker is done when every queue is empty
+	for (unsigned i = 0; i < _threads; ++i) {
+		for (size_t index = count * i / _threads; index < count * (i + 1) / _threads; ++index) {
+			_queues[i]->jobs.push_back(index);
+		}
+	}
+	std::vector<std::thread> workers;
+	for (unsigned i = 1; i < _threads; ++i) {
+		workers.emplace_back(&WorkPool::work, this, i, std::cref(job));
+	}
+	work(0, job);
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void WorkPool::work(unsigned self, const std::function<void(size_t)>& job) {
+	size_t index;
+	while (pop(self, index) || steal(self, index)) {
+		job(index);
+	}
+}
+
+bool WorkPool::pop(unsigned self, size_t& index) {
+	auto& queue = *_queues[self];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.jobs.empty()) {
+		return false;
+	}
+	index = queue.jobs.back();
+	queue.jobs.pop_back();
+	return true;
+}
+
+bool WorkPool::steal(unsigned self, size_t& index) {
+	for (unsigned i = 1; i < _threads; ++i) {
+		auto& queue = *_queues[(self + i) % _threads];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty()) {
+			index = queue.jobs.front();
+			queue.jobs.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
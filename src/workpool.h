@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Runs a batch of independent jobs on all cores. Every worker gets a contiguous share of the jobs in its
+// own queue and takes them from the back; a worker whose queue is empty steals from the front of the
+// others, so a few slow jobs don't leave the rest of the machine idle.
+class WorkPool {
+public:
+	// 0 threads means one per core
+	explicit WorkPool(unsigned threads = 0);
+	unsigned getThreads() const;
+	// calls job(i) for i in [0, count), returns when all of them are done. Jobs must not throw.
+	void run(size_t count, const std::function<void(size_t)>& job);
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<size_t> jobs;
+	};
+	void work(unsigned self, const std::function<void(size_t)>& job);
+	bool pop(unsigned self, size_t& index);
+	bool steal(unsigned self, size_t& index);
+	unsigned _threads;
+	std::vector<std::unique_ptr<Queue>> _queues;
+};
+
+inline unsigned WorkPool::getThreads() const {
+	return _threads;
+}
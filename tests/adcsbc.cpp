@@ -0,0 +1,115 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include "c64.h"
+
+// Runs ADC and SBC for every accumulator, operand and carry, in binary and in decimal mode, with every
+// dispatch, and compares the accumulator and N, V, Z and C with a reference written independently of
+// the CPU core. Exits with 1 at the first cases that differ.
+
+namespace {
+
+	struct Result {
+		int a;
+		int flags;              // N, V, Z and C at their places in the status register
+	};
+
+	Result binaryReference(bool subtract, int a, int value, int carry) {
+		if (subtract) {
+			value ^= 0xFF;
+		}
+		int sum = a + value + carry;
+		bool overflow = ((a ^ sum) & (value ^ sum) & 0x80) != 0;
+		return {sum & 0xFF, (sum & 0x80) | (overflow ? 0x40 : 0) | ((sum & 0xFF) == 0 ? 0x02 : 0) | (sum >> 8)};
+	}
+
+	// the NMOS 6502 in decimal mode, as the decimal adjust of the whole byte described in
+	// "Decimal Mode" by Bruce Clark, appendix A
+	Result decimalReference(bool subtract, int a, int value, int carry) {
+		Result binary = binaryReference(subtract, a, value, carry);
+		if (subtract) {
+			// the flags are those of the binary subtraction
+			int low = (a & 0x0F) - (value & 0x0F) + carry - 1;
+			int result = low < 0 ? ((low - 0x06) & 0x0F) - 0x10 : low;
+			result += (a & 0xF0) - (value & 0xF0);
+			if (result < 0) {
+				result -= 0x60;
+			}
+			return {result & 0xFF, binary.flags};
+		}
+		int low = (a & 0x0F) + (value & 0x0F) + carry;
+		int result = low >= 0x0A ? ((low + 0x06) & 0x0F) + 0x10 : low;
+		result += (a & 0xF0) + (value & 0xF0);
+		// N and V before the high digit is adjusted, Z of the binary sum
+		int flags = (result & 0x80) | (binary.flags & 0x02);
+		if (((a ^ result) & (value ^ result) & 0x80) != 0) {
+			flags |= 0x40;
+		}
+		if (result >= 0xA0) {
+			result += 0x60;
+		}
+		flags |= result >= 0x100 ? 0x01 : 0;
+		return {result & 0xFF, flags};
+	}
+
+	// LDA $12; LSR A for the carry, LDA $10; ADC or SBC $11; STA $02; PHP; PLA; STA $03, between SED or
+	// CLD and CLD, then JAM. The operands stay in the zero page, so the block is decoded once and, with
+	// Dispatch::JIT, compiled.
+	std::vector<uint8_t> program(bool subtract, bool decimal) {
+		return {static_cast<uint8_t>(decimal ? 0xF8 : 0xD8), 0xA5, 0x12, 0x4A, 0xA5, 0x10,
+			static_cast<uint8_t>(subtract ? 0xE5 : 0x65), 0x11, 0x85, 0x02, 0x08, 0x68, 0x85, 0x03, 0xD8, 0x02};
+	}
+	const long PROGRAM_INSTRUCTIONS = 11;
+
+}
+
+int main() {
+	std::vector<std::pair<Dispatch, const char*>> dispatches = {
+		{Dispatch::SWITCH, "switch"}, {Dispatch::BLOCK, "block"}
+	};
+	if (Jit::isAvailable()) {
+		dispatches.push_back({Dispatch::JIT, "jit"});
+	}
+	// without ROMs: nothing but the program runs
+	C64 computer(Mode::PAL, nullptr);
+	long cases = 0;
+	int failures = 0;
+	for (const auto& dispatch : dispatches) {
+		for (int operation = 0; operation < 4; ++operation) {
+			bool subtract = operation & 1;
+			bool decimal = operation & 2;
+			uint16_t start = 0x4000 + operation * 0x100;
+			auto code = program(subtract, decimal);
+			for (size_t i = 0; i < code.size(); ++i) {
+				computer.poke(start + i, code[i]);
+			}
+			for (int carry = 0; carry < 2; ++carry) {
+				for (int a = 0; a < 256; ++a) {
+					for (int value = 0; value < 256; ++value) {
+						computer.poke(0x10, a);
+						computer.poke(0x11, value);
+						computer.poke(0x12, carry);
+						computer.setProgramCounter(start);
+						computer.runInstructions(PROGRAM_INSTRUCTIONS, dispatch.first);
+						Result expected = decimal ? decimalReference(subtract, a, value, carry) :
+							binaryReference(subtract, a, value, carry);
+						int flags = computer.peek(0x03) & 0xC3;
+						++cases;
+						if (computer.peek(0x02) != expected.a || flags != expected.flags) {
+							std::cerr << std::hex << std::setfill('0') << dispatch.second << (decimal ? " decimal " : " binary ")
+								<< (subtract ? "SBC" : "ADC") << " A=" << std::setw(2) << a << " operand=" << std::setw(2) << value
+								<< " C=" << carry << ": A=" << std::setw(2) << static_cast<int>(computer.peek(0x02))
+								<< " NV-----ZC=" << std::setw(2) << flags << ", expected A=" << std::setw(2) << expected.a
+								<< " NV-----ZC=" << std::setw(2) << expected.flags << std::dec << "\n";
+							if (++failures == 10) {
+								return 1;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	std::cerr << cases << " cases, " << failures << " failed\n";
+	return failures == 0 ? 0 : 1;
+}